@@ -0,0 +1,126 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "util.h"
+#include "JobSystem.h"
+#include "MD5Animation.h"
+#include "MD5Model.h"
+#include "Renderable.h"
+
+// animates a crowd of monsters with the job system the way Scene does
+// (interpolate, skin and fill each actor's buffers, one job per actor)
+// and reports ms/frame at 1, 2, 4, 8 and 16 threads
+// usage: animation_scaling [frames]
+
+namespace
+{
+    struct Crowd
+    {
+        const char* path;
+        const char* model;
+        const char* animation;
+        size_t actors;
+    };
+
+    const Crowd CROWDS[] = {
+        { "monsters/imp", "imp", "walk1", 64 },
+        { "monsters/imp", "imp", "walk1", 256 },
+        { "monsters/hellknight", "hellknight", "idle2", 64 },
+    };
+
+    const size_t THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+
+    // the per-actor state Actor::animate() touches
+    struct Actor
+    {
+        size_t frame;
+        double frame_percent;
+        Skeleton skeleton;
+        boost::shared_array<Vertex> vertices;
+        RenderableBuffers buffers;
+    };
+
+    class Animator
+    {
+    public:
+        Animator(const MD5Model& model, const MD5Animation& animation, size_t count)
+            : _model(model), _animation(animation)
+        {
+            for(size_t i=0; i<count; ++i) {
+                boost::shared_ptr<Actor> actor(new Actor());
+                actor->frame = i % animation.frame_count();
+                actor->frame_percent = 0.1 * (i % 10);
+                actor->vertices.reset(new Vertex[model.vertex_count()]);
+                actor->buffers.allocate_buffers(model.triangle_count() * 3);
+                _actors.push_back(actor);
+            }
+        }
+
+    public:
+        size_t size() const { return _actors.size(); }
+
+        void animate(size_t idx)
+        {
+            Actor& actor(*_actors[idx]);
+            _animation.interpolate_skeleton(actor.frame, (actor.frame + 1) % _animation.frame_count(), actor.skeleton, actor.frame_percent);
+            _model.calculate_vertices(actor.skeleton, actor.vertices, actor.buffers);
+
+            actor.frame = (actor.frame + 1) % _animation.frame_count();
+        }
+
+    private:
+        const MD5Model& _model;
+        const MD5Animation& _animation;
+        std::vector<boost::shared_ptr<Actor> > _actors;
+    };
+
+    bool run(const Crowd& crowd, int frames)
+    {
+        MD5Model model(crowd.model);
+        MD5Animation animation(crowd.animation);
+        if(!model.load(crowd.path) || !animation.load(crowd.path)) {
+            std::cerr << "Could not load " << crowd.path << std::endl;
+            return false;
+        }
+
+        Animator animator(model, animation, crowd.actors);
+        const JobSystem::Work work(boost::bind(&Animator::animate, &animator, _1));
+
+        std::cout << std::setw(12) << std::left << crowd.model << std::right << " x" << std::setw(4) << std::left << crowd.actors << std::right;
+        for(size_t i=0; i<sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); ++i) {
+            JobSystem jobs(THREAD_COUNTS[i]);
+
+            // warm up the workers and caches
+            jobs.wait(jobs.parallel_for(animator.size(), work));
+
+            const double start = get_time();
+            for(int j=0; j<frames; ++j) {
+                jobs.wait(jobs.parallel_for(animator.size(), work));
+            }
+            std::cout << std::fixed << std::setprecision(2) << std::setw(8) << ((get_time() - start) * 1000.0 / frames);
+        }
+        std::cout << std::endl;
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int frames = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 50;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+
+    std::cout << "ms/frame, " << boost::thread::hardware_concurrency() << " cores" << std::endl;
+    std::cout << std::setw(18) << "threads";
+    for(size_t i=0; i<sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); ++i) {
+        std::cout << std::setw(8) << THREAD_COUNTS[i];
+    }
+    std::cout << std::endl;
+
+    for(size_t i=0; i<sizeof(CROWDS) / sizeof(CROWDS[0]); ++i) {
+        if(!run(CROWDS[i], frames)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "common.h"
+#include "math_util.h"
+#include "util.h"
+#include "MD5Animation.h"
+#include "Model.h"
+
+// interpolates every animation in share/models with the per-joint path and
+// the batch path at a few nlerp thresholds and reports joints/sec and the
+// largest angle between the batch orientations and the per-joint slerp's
+// (and an exact double precision slerp's, which the per-joint one isn't)
+// usage: interpolation [skeletons per run]
+
+namespace
+{
+    const float THRESHOLDS[] = { 0.0f, 10.0f, 360.0f };
+
+    // the angle of the rotation between two orientations
+    float angle_between(const Quaternion& a, const Quaternion& b)
+    {
+        const Quaternion d(~a * b);
+        return 2.0f * std::atan2(d.vector().length(), std::fabs(d.scalar()));
+    }
+
+    // slerp in double precision between the normalized poses
+    Quaternion exact_slerp(const float* const a, const float* const b, double t)
+    {
+        double qa[4], qb[4], la = 0.0, lb = 0.0;
+        for(int i=0; i<4; ++i) {
+            qa[i] = a[i];
+            qb[i] = b[i];
+            la += qa[i] * qa[i];
+            lb += qb[i] * qb[i];
+        }
+
+        double dot = 0.0;
+        for(int i=0; i<4; ++i) {
+            qa[i] /= std::sqrt(la);
+            qb[i] /= std::sqrt(lb);
+            dot += qa[i] * qb[i];
+        }
+
+        // the short way around
+        if(dot < 0.0) {
+            dot = -dot;
+            for(int i=0; i<4; ++i) {
+                qb[i] = -qb[i];
+            }
+        }
+
+        double ra = 1.0 - t, rb = t;
+        if(dot < 1.0 - 1e-12) {
+            const double angle = std::acos(std::min(dot, 1.0)), s = std::sin(angle);
+            ra = std::sin((1.0 - t) * angle) / s;
+            rb = std::sin(t * angle) / s;
+        }
+
+        float r[4];
+        for(int i=0; i<4; ++i) {
+            r[i] = static_cast<float>(qa[i] * ra + qb[i] * rb);
+        }
+        return Quaternion(r);
+    }
+
+    double joints_per_second(const Animation& animation, Skeleton& skeleton, size_t skeletons)
+    {
+        const double start = get_time();
+        for(size_t i=0; i<skeletons; ++i) {
+            const size_t frame = i % animation.frame_count();
+            animation.interpolate_skeleton(frame, (frame + 1) % animation.frame_count(), skeleton, 0.1 + 0.08 * (i % 10));
+        }
+        return skeletons * animation.joint_count() / (get_time() - start);
+    }
+
+    struct Error
+    {
+        Error() : scalar(0.0f), exact(0.0f) {}
+
+        // against the per-joint path and the exact slerp
+        float scalar, exact;
+    };
+
+    // every frame at t = 0.1 to 0.9, the batch path with whatever threshold is set
+    Error measure(const Animation& animation, Skeleton& reference, Skeleton& skeleton, float threshold)
+    {
+        Error error;
+        for(size_t i=0; i<animation.frame_count(); ++i) {
+            const size_t next = (i + 1) % animation.frame_count();
+            for(int j=1; j<10; ++j) {
+                const double t = j / 10.0;
+
+                Animation::batch_interpolation(false, 0.0f);
+                animation.interpolate_skeleton(i, next, reference, t);
+
+                Animation::batch_interpolation(true, DEG_RAD(threshold));
+                animation.interpolate_skeleton(i, next, skeleton, t);
+
+                for(size_t k=0; k<animation.joint_count(); ++k) {
+                    const Quaternion exact(exact_slerp(animation.pose(i)[k].orientation, animation.pose(next)[k].orientation, t));
+                    error.scalar = std::max(error.scalar, angle_between(reference.orientation(k), skeleton.orientation(k)));
+                    error.exact = std::max(error.exact, angle_between(exact, skeleton.orientation(k)));
+                }
+            }
+        }
+        return error;
+    }
+
+    bool run(const boost::filesystem::path& filename, size_t skeletons)
+    {
+        const boost::filesystem::path path(filename.parent_path().string().substr(model_dir().string().length() + 1));
+
+        MD5Animation animation(filename.stem().string());
+        if(!animation.load(path)) {
+            std::cerr << "Could not load " << filename << std::endl;
+            return false;
+        }
+
+        const Animation& frames(animation);
+        Skeleton reference, skeleton;
+
+        Animation::batch_interpolation(false, 0.0f);
+        std::cout << path.string() << "/" << animation.name() << ": " << animation.joint_count() << " joints, "
+            << animation.frame_count() << " frames" << std::endl
+            << std::fixed << std::setprecision(1)
+            << "  per-joint slerp         " << std::setw(7) << (joints_per_second(frames, reference, skeletons) / 1e6) << " M joints/sec" << std::endl;
+
+        for(size_t i=0; i<sizeof(THRESHOLDS) / sizeof(THRESHOLDS[0]); ++i) {
+            const Error error(measure(frames, reference, skeleton, THRESHOLDS[i]));
+
+            Animation::batch_interpolation(true, DEG_RAD(THRESHOLDS[i]));
+            const double rate = joints_per_second(frames, skeleton, skeletons);
+
+            std::cout << "  batch, nlerp < " << std::setw(3) << std::setprecision(0) << THRESHOLDS[i] << " deg "
+                << std::setprecision(1) << std::setw(7) << (rate / 1e6) << " M joints/sec, max error "
+                << std::setprecision(4) << RAD_DEG(error.scalar) << " deg vs per-joint slerp, "
+                << RAD_DEG(error.exact) << " deg vs exact" << std::endl;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t skeletons = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 20000;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+
+    boost::filesystem::recursive_directory_iterator end;
+    for(boost::filesystem::recursive_directory_iterator it(model_dir()); it != end; ++it) {
+        if(MD5Animation::extension() == it->path().extension() && !run(it->path(), skeletons)) {
+            return 1;
+        }
+    }
+
+    Animation::batch_interpolation(false, 0.0f);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "util.h"
+#include "JobSystem.h"
+
+// measures the job system's scheduling overhead with empty jobs,
+// as one parallel_for and as separately submitted and waited tasks
+// usage: job_system [tasks]
+
+namespace
+{
+    const size_t THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+
+    void nothing(size_t)
+    {
+    }
+
+    void nothing_task()
+    {
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t tasks = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 200000;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+
+    std::cout << tasks << " empty tasks, " << boost::thread::hardware_concurrency() << " cores" << std::endl;
+
+    std::vector<JobSystem::Counter> counters;
+    counters.reserve(tasks);
+
+    for(size_t i=0; i<sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); ++i) {
+        JobSystem jobs(THREAD_COUNTS[i]);
+
+        double start = get_time();
+        jobs.wait(jobs.parallel_for(tasks, nothing));
+        const double parallel_for = (get_time() - start) * 1e9 / tasks;
+
+        counters.clear();
+        start = get_time();
+        for(size_t j=0; j<tasks; ++j) {
+            counters.push_back(jobs.submit(nothing_task));
+        }
+        for(size_t j=0; j<tasks; ++j) {
+            jobs.wait(counters[j]);
+        }
+        const double submit = (get_time() - start) * 1e9 / tasks;
+
+        // the counters can't outlive the system
+        counters.clear();
+
+        std::cout << std::setw(2) << THREAD_COUNTS[i] << " threads: "
+            << std::fixed << std::setprecision(0)
+            << "parallel_for " << std::setw(5) << parallel_for << " ns/task, "
+            << "submit + wait " << std::setw(5) << submit << " ns/task, "
+            << jobs.jobs_stolen() << " stolen" << std::endl;
+    }
+    return 0;
+}
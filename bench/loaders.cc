@@ -0,0 +1,150 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "common.h"
+#include "util.h"
+#include "CookedFile.h"
+#include "D3Map.h"
+#include "MD5Animation.h"
+#include "MD5Model.h"
+
+// loads every model and animation in share/models and every map in share/maps
+// and reports the throughput of the text loaders, run from the top of the tree
+// usage: loaders [repetitions]
+
+namespace
+{
+    struct Throughput
+    {
+        size_t files;
+        double mb, seconds;
+
+        Throughput() : files(0), mb(0.0), seconds(0.0) {}
+
+        void add(const boost::filesystem::path& filename, double elapsed)
+        {
+            files++;
+            mb += boost::filesystem::file_size(filename) / (1024.0 * 1024.0);
+            seconds += elapsed;
+        }
+
+        void print(const std::string& name) const
+        {
+            std::cout << std::setw(24) << std::left << name << std::right
+                << std::setw(4) << files << " loads "
+                << std::setw(8) << std::fixed << std::setprecision(2) << mb << " MB "
+                << std::setw(10) << (seconds * 1000.0) << " ms "
+                << std::setw(8) << (seconds > 0.0 ? mb / seconds : 0.0) << " MB/s" << std::endl;
+        }
+    };
+
+    // the text loaders only run if there's no cooked copy to use
+    void remove_cooked(const boost::filesystem::path& filename)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(CookedFile::filename(filename), ec);
+    }
+
+    template<typename T>
+    bool time_load(const boost::filesystem::path& filename, int repetitions, bool cooked, Throughput& throughput)
+    {
+        const boost::filesystem::path path(filename.parent_path().string().substr(model_dir().string().length() + 1));
+        for(int i=0; i<repetitions; ++i) {
+            if(!cooked) {
+                remove_cooked(filename);
+            }
+
+            T asset(filename.stem().string());
+            const double start = get_time();
+            if(!asset.load(path)) {
+                std::cerr << "Could not load " << filename << std::endl;
+                return false;
+            }
+            throughput.add(filename, get_time() - start);
+        }
+        return true;
+    }
+
+    // D3Map uploads its surfaces as it loads, so it needs a context
+    bool create_context()
+    {
+        if(SDL_Init(SDL_INIT_VIDEO) < 0) {
+            std::cerr << "Could not initialize SDL: " << SDL_GetError() << std::endl;
+            return false;
+        }
+
+        if(NULL == SDL_SetVideoMode(64, 64, 0, SDL_OPENGL)) {
+            std::cerr << "Unable to set video mode!" << std::endl;
+            return false;
+        }
+
+        return GLEW_OK == glewInit();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int repetitions = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 5;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+    if(!create_context()) {
+        return 1;
+    }
+
+    Throughput models, animations, cooked_models, cooked_animations;
+
+    boost::filesystem::recursive_directory_iterator end;
+    for(boost::filesystem::recursive_directory_iterator it(model_dir()); it != end; ++it) {
+        const boost::filesystem::path& filename(it->path());
+        if(MD5Model::extension() == filename.extension()) {
+            if(!time_load<MD5Model>(filename, repetitions, false, models)
+                || !time_load<MD5Model>(filename, repetitions, true, cooked_models))
+            {
+                return 1;
+            }
+        } else if(MD5Animation::extension() == filename.extension()) {
+            if(!time_load<MD5Animation>(filename, repetitions, false, animations)
+                || !time_load<MD5Animation>(filename, repetitions, true, cooked_animations))
+            {
+                return 1;
+            }
+        }
+    }
+
+    Throughput maps;
+    for(boost::filesystem::directory_iterator it(map_dir()); it != boost::filesystem::directory_iterator(); ++it) {
+        const boost::filesystem::path& filename(it->path());
+        if(".map" != filename.extension()) {
+            continue;
+        }
+
+        // the first load also reads the textures, which are kept after that
+        const boost::filesystem::path proc(boost::filesystem::change_extension(filename, ".proc"));
+        for(int i=-1; i<repetitions; ++i) {
+            D3Map map(filename.stem().string());
+            const double start = get_time();
+            if(!map.load("")) {
+                // not every map ships with its textures
+                std::cerr << "Skipping " << filename << std::endl;
+                break;
+            }
+
+            // the map and proc are timed together
+            const double elapsed = get_time() - start;
+            if(i >= 0) {
+                maps.add(filename, 0.0);
+                maps.add(proc, elapsed);
+            }
+        }
+    }
+
+    std::cout << repetitions << " loads of each file (MB/s is of the source files)" << std::endl;
+    models.print("share/models md5mesh");
+    animations.print("share/models md5anim");
+    maps.print("share/maps map + proc");
+    cooked_models.print("cooked md5mesh");
+    cooked_animations.print("cooked md5anim");
+
+    SDL_Quit();
+    return 0;
+}
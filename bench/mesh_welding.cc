@@ -0,0 +1,84 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "util.h"
+#include "Mesh.h"
+
+// times Mesh::weld_vertices() and Mesh::compute_edges() on a synthetic grid
+// where every quad has its own 4 vertices, so the welder has work to do
+// usage: mesh_welding [quads per side...] (500 is 500k triangles)
+
+namespace
+{
+    void run(int n)
+    {
+        const int vcount = n * n * 4, tcount = n * n * 2;
+        boost::shared_array<Vertex> vertices(new Vertex[vcount]);
+        boost::shared_array<Triangle> triangles(new Triangle[tcount]);
+        for(int y=0, q=0; y<n; ++y) {
+            for(int x=0; x<n; ++x, ++q) {
+                const int corners[4][2] = { { x, y }, { x + 1, y }, { x + 1, y + 1 }, { x, y + 1 } };
+                for(int k=0; k<4; ++k) {
+                    Vertex& vertex(vertices[q * 4 + k]);
+                    vertex.index = q * 4 + k;
+                    vertex.position = Position(corners[k][0] * 0.5f, corners[k][1] * 0.5f, 0.0f);
+                    vertex.texture_coords = Vector2(corners[k][0] / static_cast<float>(n), corners[k][1] / static_cast<float>(n));
+                }
+
+                Triangle& t1(triangles[q * 2]);
+                t1.index = q * 2;
+                t1.v1 = q * 4; t1.v2 = q * 4 + 1; t1.v3 = q * 4 + 2;
+
+                Triangle& t2(triangles[q * 2 + 1]);
+                t2.index = q * 2 + 1;
+                t2.v1 = q * 4; t2.v2 = q * 4 + 2; t2.v3 = q * 4 + 3;
+            }
+        }
+
+        Mesh mesh(vcount, vertices, tcount, triangles, 0, boost::shared_array<Weight>());
+
+        const double start = get_time();
+        mesh.weld_vertices();
+        const double welded = get_time();
+        mesh.compute_edges();
+        const double matched = get_time();
+
+        // the welded grid is (n + 1)^2 vertices with 3n^2 + 2n edges, 4n of them on the border
+        size_t closed = 0;
+        for(size_t i=0; i<mesh.edge_count(); ++i) {
+            if(mesh.edge(i).t2 >= 0) {
+                closed++;
+            }
+        }
+
+        std::cout << std::setw(8) << tcount << " triangles: "
+            << vcount << " -> " << mesh.vertex_count() << " vertices, "
+            << mesh.edge_count() << " edges (" << closed << " closed), "
+            << std::fixed << std::setprecision(1)
+            << "weld " << ((welded - start) * 1000.0) << " ms, "
+            << "edges " << ((matched - welded) * 1000.0) << " ms" << std::endl;
+
+        const size_t expected_edges = 3 * n * n + 2 * n;
+        if(mesh.vertex_count() != (n + 1) * (n + 1) || mesh.edge_count() != expected_edges || closed != expected_edges - (4 * n)) {
+            std::cerr << "unexpected welding result" << std::endl;
+            exit(1);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+
+    if(argc < 2) {
+        run(25);
+        run(100);
+        run(500);
+        return 0;
+    }
+
+    for(int i=1; i<argc; ++i) {
+        run(std::atoi(argv[i]));
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "common.h"
+#include "util.h"
+#include "CookedFile.h"
+#include "Lexer.h"
+#include "MappedFile.h"
+#include "MD5Animation.h"
+
+// numeric literal throughput of Lexer::parse_float() against strtod()
+// and of the whole text animation loader, run from the top of the tree
+// usage: numbers [repetitions]
+
+namespace
+{
+    const char* const MODEL_PATH = "monsters/hellknight";
+    const char* const ANIMATION_NAME = "idle2";
+
+    inline bool is_number(char ch)
+    {
+        return (ch >= '0' && ch <= '9') || ch == '-' || ch == '.';
+    }
+
+    void print(const std::string& name, size_t count, double mb, double seconds)
+    {
+        std::cout << std::setw(20) << std::left << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(2) << (count / seconds / 1000000.0) << " M/s "
+            << std::setw(10) << (mb / seconds) << " MB/s" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int repetitions = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 20;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+
+    const boost::filesystem::path filename(model_dir() / MODEL_PATH / (std::string(ANIMATION_NAME) + MD5Animation::extension()));
+    MappedFile file;
+    if(!file.open(filename)) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return 1;
+    }
+
+    // every literal in the file, the frame blocks are nearly all floats
+    std::vector<std::pair<const char*, const char*> > literals;
+    double mb = 0.0;
+    for(const char* p = file.data(); *p != '\0';) {
+        if(!is_number(*p)) {
+            p++;
+            continue;
+        }
+
+        const char* const start = p;
+        while(is_number(*p)) {
+            p++;
+        }
+        literals.push_back(std::make_pair(start, p));
+        mb += (p - start) / (1024.0 * 1024.0);
+    }
+
+    double sum = 0.0, start = get_time();
+    for(int i=0; i<repetitions; ++i) {
+        for(size_t j=0; j<literals.size(); ++j) {
+            double value;
+            Lexer::parse_float(literals[j].first, literals[j].second, value);
+            sum += value;
+        }
+    }
+    const double parse_float_time = get_time() - start;
+
+    start = get_time();
+    for(int i=0; i<repetitions; ++i) {
+        for(size_t j=0; j<literals.size(); ++j) {
+            // the literal is followed by a character that ends it
+            sum -= strtod(literals[j].first, NULL);
+        }
+    }
+    const double strtod_time = get_time() - start;
+
+    start = get_time();
+    for(int i=0; i<repetitions; ++i) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(CookedFile::filename(filename), ec);
+
+        MD5Animation animation(ANIMATION_NAME);
+        if(!animation.load(MODEL_PATH)) {
+            std::cerr << "Could not load " << filename << std::endl;
+            return 1;
+        }
+    }
+    const double load_time = get_time() - start;
+
+    std::cout << filename << ": " << literals.size() << " literals, "
+        << std::fixed << std::setprecision(2) << (file.size() / (1024.0 * 1024.0)) << " MB"
+        << " (checksum " << sum << ")" << std::endl;
+    print("parse_float()", literals.size() * repetitions, mb * repetitions, parse_float_time);
+    print("strtod()", literals.size() * repetitions, mb * repetitions, strtod_time);
+    print("text load", literals.size() * repetitions, (file.size() / (1024.0 * 1024.0)) * repetitions, load_time);
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include "util.h"
+#include "Animation.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Model.h"
+#include "ModelManager.h"
+#include "Monster.h"
+
+// finds the shadow silhouettes of the shipped monsters at each shadow level
+// for a few lights that move every frame, so nothing is cached, and reports
+// the edges swept per second and the allocations per frame once it's warm
+// NOTE: this needs a GL context for the renderables' buffers
+// usage: silhouettes [frames]
+
+namespace
+{
+    boost::atomic<size_t> allocations(0);
+}
+
+// the counting allocator
+void* operator new(std::size_t size)
+{
+    allocations++;
+    void* const p = std::malloc(size > 0 ? size : 1);
+    if(NULL == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    std::free(p);
+}
+
+namespace
+{
+    struct TestModel
+    {
+        const char* path;
+        const char* name;
+        const char* animation;
+    };
+
+    const TestModel MODELS[] = {
+        { "monsters/imp", "imp", "walk1" },
+        { "monsters/hellknight", "hellknight", "idle2" },
+        { "monsters/pinky", "pinky", "idle1" },
+    };
+
+    const size_t LODS = 4;
+    const int LIGHTS = 4;
+    const int WARM_FRAMES = 10;
+
+    // lights circling the monster, a little further out each
+    void move_lights(const Lights& lights, const AABB& bounds, int frame)
+    {
+        for(size_t i=0; i<lights.size(); ++i) {
+            const float angle = frame * 0.05f + i * 1.7f;
+            const float distance = bounds.radius() * (1.5f + i);
+            lights[i]->position(bounds.center() + Position(std::cos(angle) * distance, bounds.radius(), std::sin(angle) * distance));
+        }
+    }
+
+    bool run(const TestModel& test, int frames)
+    {
+        if(!ModelManager::instance().load_model(test.path, test.name)
+            || !ModelManager::instance().load_animation(test.path, test.name, test.animation))
+        {
+            std::cerr << "Could not load " << test.path << std::endl;
+            return false;
+        }
+
+        Monster monster(test.name);
+        monster.init();
+        monster.model(ModelManager::instance().model(test.name));
+        monster.animation(ModelManager::instance().animation(test.name, test.animation));
+
+        // the monster is at the origin
+        const Model& model(monster.model());
+        const AABB bounds(model.bounds());
+
+        Lights lights;
+        for(int i=0; i<LIGHTS; ++i) {
+            boost::shared_ptr<Light> light(new PositionalLight());
+            light->enable();
+            lights.push_back(light);
+        }
+
+        LightMask mask(lights.size());
+        mask.set();
+
+        std::cout << test.path << ": " << model.vertex_count() << " vertices, "
+            << LIGHTS << " lights" << std::endl;
+
+        // backing the camera away walks the levels, the shadows are a bias coarser
+        Camera camera;
+        size_t last_lod = model.lod_count();
+        for(size_t lod=0; lod<model.lod_count(); ++lod) {
+            camera.position(bounds.center() + Position(0.0f, 0.0f, bounds.radius() * 3.0f * static_cast<float>(1 << lod)));
+            monster.think(0.0);
+            monster.select_lod(camera);
+            monster.animate();
+            monster.commit_vertices();
+
+            const size_t shadow_lod = monster.shadow_lod();
+            if(shadow_lod == last_lod) {
+                continue;
+            }
+            last_lod = shadow_lod;
+
+            for(int i=0; i<WARM_FRAMES; ++i) {
+                move_lights(lights, bounds, i);
+                monster.compute_silhouettes(lights, mask);
+            }
+
+            const size_t start_allocations = allocations;
+            const double start = get_time();
+            for(int i=0; i<frames; ++i) {
+                move_lights(lights, bounds, i);
+                monster.compute_silhouettes(lights, mask);
+            }
+            const double elapsed = get_time() - start;
+            const size_t count = allocations - start_allocations;
+
+            const double edges = static_cast<double>(model.edge_count(shadow_lod)) * LIGHTS * frames;
+            std::cout << "  shadow lod " << shadow_lod << ": " << std::setw(6) << model.edge_count(shadow_lod) << " edges, "
+                << std::fixed << std::setprecision(1) << std::setw(7) << (edges / elapsed / 1e6) << " M edges/sec, "
+                << std::setprecision(3) << (elapsed * 1e3 / frames) << " ms/frame, "
+                << std::setprecision(1) << (static_cast<double>(count) / frames) << " allocations/frame" << std::endl;
+        }
+        return true;
+    }
+
+    bool create_context()
+    {
+        if(SDL_Init(SDL_INIT_VIDEO) < 0) {
+            std::cerr << "Could not initialize SDL: " << SDL_GetError() << std::endl;
+            return false;
+        }
+
+        if(NULL == SDL_SetVideoMode(64, 64, 0, SDL_OPENGL)) {
+            std::cerr << "Unable to set video mode!" << std::endl;
+            return false;
+        }
+
+        return GLEW_OK == glewInit();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int frames = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 2000;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+    if(!create_context()) {
+        return 1;
+    }
+
+    Model::lods(LODS, 0.5f);
+
+    int result = 0;
+    for(size_t i=0; i<sizeof(MODELS) / sizeof(MODELS[0]); ++i) {
+        if(!run(MODELS[i], frames)) {
+            result = 1;
+            break;
+        }
+    }
+
+    SDL_Quit();
+    return result;
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+#include <iomanip>
+#include <iostream>
+#include "util.h"
+#include "MD5Animation.h"
+#include "MD5Model.h"
+#include "Renderable.h"
+#include "Skinning.h"
+
+// skins the shipped monsters through their idle animations with each
+// kernel this machine supports and reports the vertices skinned per second
+// (through Model::calculate_vertices(), so it includes copying the triangles)
+// usage: skinning [seconds per kernel]
+
+namespace
+{
+    struct Monster
+    {
+        const char* path;
+        const char* model;
+        const char* animation;
+    };
+
+    const Monster MONSTERS[] = {
+        { "monsters/pinky", "pinky", "idle1" },
+        { "monsters/hellknight", "hellknight", "idle2" },
+    };
+
+    bool run(const Monster& monster, double seconds)
+    {
+        MD5Model model(monster.model);
+        MD5Animation animation(monster.animation);
+        if(!model.load(monster.path) || !animation.load(monster.path)) {
+            std::cerr << "Could not load " << monster.path << std::endl;
+            return false;
+        }
+
+        // one pose per frame, skinned round robin
+        std::vector<Skeleton> poses(animation.frame_count());
+        for(size_t i=0; i<poses.size(); ++i) {
+            animation.interpolate_skeleton(i, (i + 1) % poses.size(), poses[i], 0.5);
+        }
+
+        std::vector<Skinning::Kernel> kernels;
+        kernels.push_back(Skinning::ScalarKernel);
+#if defined USE_SSE
+        kernels.push_back(Skinning::SSEKernel);
+        if(Skinning::AVX2Kernel == Skinning::best_kernel()) {
+            kernels.push_back(Skinning::AVX2Kernel);
+        }
+#endif
+        kernels.push_back(Skinning::PaletteKernel);
+
+        std::cout << monster.model << "/" << monster.animation << ": "
+            << model.vertex_count() << " vertices, " << poses.size() << " frames" << std::endl;
+
+        boost::shared_array<Vertex> vertices(new Vertex[model.vertex_count()]);
+        RenderableBuffers buffers(model.triangle_count() * 3);
+
+        double scalar = 0.0;
+        for(size_t k=0; k<kernels.size(); ++k) {
+            size_t skinned = 0;
+            const double start = get_time();
+            double elapsed = 0.0;
+            do {
+                for(size_t i=0; i<poses.size(); ++i) {
+                    model.calculate_vertices(poses[i], vertices, buffers, kernels[k]);
+                }
+                skinned += poses.size() * model.vertex_count();
+                elapsed = get_time() - start;
+            } while(elapsed < seconds);
+
+            const double rate = skinned / elapsed;
+            if(Skinning::ScalarKernel == kernels[k]) {
+                scalar = rate;
+            }
+
+            std::cout << "  " << std::setw(28) << std::left << Skinning::kernel_name(kernels[k]) << std::right
+                << std::fixed << std::setprecision(2)
+                << std::setw(8) << (rate / 1e6) << " Mverts/s"
+                << std::setw(8) << (rate / scalar) << "x" << std::endl;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const double seconds = argc > 1 ? std::max(std::atof(argv[1]), 0.1) : 1.0;
+
+    Logger::configure(Logger::LoggerTypeStdout, Logger::LogLevelWarning, "");
+
+    for(size_t i=0; i<sizeof(MONSTERS) / sizeof(MONSTERS[0]); ++i) {
+        if(!run(MONSTERS[i], seconds)) {
+            return 1;
+        }
+    }
+    return 0;
+}
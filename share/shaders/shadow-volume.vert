@@ -0,0 +1,9 @@
+#version 330
+
+in vec3 vertex;
+
+void main()
+{
+    // the geometry shader extrudes in object-space
+    gl_Position = vec4(vertex, 1.0);
+}
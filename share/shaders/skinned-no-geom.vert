@@ -0,0 +1,32 @@
+#version 330
+
+uniform mat4 mvp, modelview;
+
+// joint matrix * inverse bind matrix for each joint,
+// stored as 4 (x, y, z, 0) column texels per joint
+uniform samplerBuffer palette;
+
+// this is bind-pose
+in vec3 vertex;
+in vec2 texture_coord;
+
+// up to 4 influences, unused influences have a weight of 0
+in uvec4 joints;
+in vec4 weights;
+
+out vec2 frag_texture_coord;
+
+void main()
+{
+    vec3 position = vec3(0.0);
+    for(int i=0; i<4; ++i) {
+        int idx = int(joints[i]) * 4;
+        position += weights[i] * (texelFetch(palette, idx).xyz * vertex.x
+            + texelFetch(palette, idx + 1).xyz * vertex.y
+            + texelFetch(palette, idx + 2).xyz * vertex.z
+            + texelFetch(palette, idx + 3).xyz);
+    }
+
+    gl_Position = mvp * vec4(position, 1.0);
+    frag_texture_coord = texture_coord;
+}
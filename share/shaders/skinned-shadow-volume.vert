@@ -0,0 +1,30 @@
+#version 330
+
+// joint matrix * inverse bind matrix for each joint,
+// stored as 4 (x, y, z, 0) column texels per joint
+uniform samplerBuffer palette;
+
+// this is bind-pose
+in vec3 vertex;
+
+// up to 4 influences, unused influences have a weight of 0
+in uvec4 joints;
+in vec4 weights;
+
+mat4 skin_matrix()
+{
+    mat4 matrix = mat4(0.0);
+    for(int i=0; i<4; ++i) {
+        int idx = int(joints[i]) * 4;
+        matrix += weights[i] * mat4(texelFetch(palette, idx), texelFetch(palette, idx + 1),
+            texelFetch(palette, idx + 2), texelFetch(palette, idx + 3));
+    }
+    matrix[3][3] = 1.0;
+    return matrix;
+}
+
+void main()
+{
+    // the geometry shader extrudes in object-space
+    gl_Position = skin_matrix() * vec4(vertex, 1.0);
+}
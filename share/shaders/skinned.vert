@@ -0,0 +1,40 @@
+#version 330
+
+// joint matrix * inverse bind matrix for each joint,
+// stored as 4 (x, y, z, 0) column texels per joint
+uniform samplerBuffer palette;
+
+// these are bind-pose
+in vec4 tangent;
+in vec3 vertex, normal;
+in vec2 texture_coord;
+
+// up to 4 influences, unused influences have a weight of 0
+in uvec4 joints;
+in vec4 weights;
+
+out vec4 geom_tangent;
+out vec3 geom_normal;
+out vec2 geom_texture_coord;
+
+mat4 skin_matrix()
+{
+    mat4 matrix = mat4(0.0);
+    for(int i=0; i<4; ++i) {
+        int idx = int(joints[i]) * 4;
+        matrix += weights[i] * mat4(texelFetch(palette, idx), texelFetch(palette, idx + 1),
+            texelFetch(palette, idx + 2), texelFetch(palette, idx + 3));
+    }
+    matrix[3][3] = 1.0;
+    return matrix;
+}
+
+void main()
+{
+    mat4 matrix = skin_matrix();
+
+    gl_Position = matrix * vec4(vertex, 1.0);
+    geom_normal = normalize(mat3(matrix) * normal);
+    geom_tangent = vec4(normalize(mat3(matrix) * tangent.xyz), tangent.w);
+    geom_texture_coord = texture_coord;
+}
@@ -2,6 +2,7 @@
 #include "Animation.h"
 #include "Character.h"
 #include "Monster.h"
+#include "PoseCache.h"
 #include "Renderer.h"
 #include "State.h"
 #include "Actor.h"
@@ -60,11 +61,34 @@ double Actor::frame_percent() const
 
 void Actor::animate()
 {
-    _skeleton.reset();
+    // a no-op after the first frame, the names and parents stay with the model
+    _skeleton.allocate(model().skeleton());
     _animation->interpolate_skeleton(current_frame(), next_frame(), _skeleton, frame_percent());
     calculate_vertices(_skeleton);
 }
 
+void Actor::animate(PoseCache& cache)
+{
+    share_pose(cache.pose(model(), *_animation, current_frame(), frame_percent(), !gpu_skinning(), selected_lod()));
+}
+
+void Actor::hold_pose(PoseCache& cache) const
+{
+    if(cached_pose()) {
+        cache.keep(cached_pose()->key());
+    }
+}
+
+const Skeleton& Actor::pose() const
+{
+    if(cached_pose()) {
+        return cached_pose()->skeleton();
+    }
+
+    // the bind pose until the first animate()
+    return _skeleton.joint_count() > 0 ? _skeleton : model().skeleton();
+}
+
 size_t Actor::next_frame() const
 {
     if(_cframe == _animation->frame_count() - 1) {
@@ -90,16 +114,19 @@ void Actor::render_skeleton() const
     Renderer::instance().multiply_model_matrix(matrix);
 
     // build the vertex buffer
-    const size_t vcount = _skeleton.nonroot_joint_count() * 3 * 2;
-    boost::shared_array<float> v(new float[vcount]);
+    const Skeleton& skeleton(pose());
+    const size_t vcount = skeleton.nonroot_joint_count() * 3 * 2;
+    _skeleton_vertices.resize(vcount);
+
+    float* const v = vcount > 0 ? &_skeleton_vertices[0] : NULL;
     for(size_t i=0, j=0; i<model().joint_count(); ++i) {
-        const Skeleton::Joint& joint(_skeleton.joint(i));
-        if(joint.parent < 0) {
+        const int parent = skeleton.parent(i);
+        if(parent < 0) {
             continue;
         }
 
-        const Position& pp(_skeleton.joint(joint.parent).position);
-        const Position& p(joint.position);
+        const Position pp(skeleton.position(parent));
+        const Position p(skeleton.position(i));
 
         const size_t idx = j * 3 * 2;
         v[idx + 0] = pp.x();
@@ -114,7 +141,7 @@ void Actor::render_skeleton() const
 
     // setup the vertex array
     glBindBuffer(GL_ARRAY_BUFFER, _skeleton_vbo[SkeletonVertexArray]);
-    glBufferData(GL_ARRAY_BUFFER, vcount * sizeof(float), v.get(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vcount * sizeof(float), v, GL_DYNAMIC_DRAW);
 
     Shader& shader(State::instance().gray_shader());
     shader.begin();
@@ -128,7 +155,7 @@ void Actor::render_skeleton() const
         glBindBuffer(GL_ARRAY_BUFFER, _skeleton_vbo[SkeletonVertexArray]);
         glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-        glDrawArrays(GL_LINES, 0, _skeleton.nonroot_joint_count() * 2);
+        glDrawArrays(GL_LINES, 0, skeleton.nonroot_joint_count() * 2);
     glDisableVertexAttribArray(vloc);
 
     shader.end();
@@ -10,6 +10,7 @@
 // can hold and subclass that instead
 
 class Animation;
+class PoseCache;
 
 class Actor : public Renderable
 {
@@ -47,6 +48,12 @@ public:
 
     virtual void animate();
 
+    // shares the cached pose for the current frame instead
+    void animate(PoseCache& cache);
+
+    // keeps sharing the cached pose from the last animate() without rebuilding it
+    void hold_pose(PoseCache& cache) const;
+
     void render_skeleton() const;
 
 private:
@@ -54,6 +61,8 @@ private:
     size_t next_frame() const;
     void advance_frame();
 
+    virtual const Skeleton& pose() const;
+
     virtual bool on_think(double dt);
     virtual void on_render_unlit(const Camera& camera) const;
 
@@ -66,6 +75,9 @@ private:
     Skeleton _skeleton;
     GLuint _skeleton_vbo[SkeletonVBOCount];
 
+    // reused so drawing the skeleton doesn't allocate every frame
+    mutable std::vector<float> _skeleton_vertices;
+
     Nameplate _nameplate;
 
 protected:
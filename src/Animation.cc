@@ -1,10 +1,96 @@
 #include "pch.h"
 #include "common.h"
 #include "Lexer.h"
+#include "math_util.h"
+#include "util.h"
 #include "Animation.h"
+#include "AnimationTracks.h"
+
+namespace
+{
+    // compressed joints are decoded this many at a time for batching
+    const size_t DECODE_BATCH = 32;
+
+#if defined USE_SSE
+    // interpolates 4 joints into the skeleton's (qx, qy, qz, qw, px, py, pz, pw) layout
+    // orientations are nlerped, returns a mask of the ones that are too far apart for that
+    int interpolate_joints_sse(const Animation::JointPose* const current, const Animation::JointPose* const next, float* const joints, __m128 t, __m128 cos_threshold)
+    {
+        // positions don't need transposing
+        for(int i=0; i<4; ++i) {
+            const __m128 c = _mm_loadu_ps(current[i].position), n = _mm_loadu_ps(next[i].position);
+            _mm_store_ps(joints + (i * Skeleton::JOINT_STRIDE) + 4, _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(n, c), t)));
+        }
+
+        // transpose the orientations into (x, y, z, w) rows
+        __m128 cx = _mm_loadu_ps(current[0].orientation), cy = _mm_loadu_ps(current[1].orientation),
+            cz = _mm_loadu_ps(current[2].orientation), cw = _mm_loadu_ps(current[3].orientation);
+        _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+        __m128 nx = _mm_loadu_ps(next[0].orientation), ny = _mm_loadu_ps(next[1].orientation),
+            nz = _mm_loadu_ps(next[2].orientation), nw = _mm_loadu_ps(next[3].orientation);
+        _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+
+        // take the shorter path, same as slerp
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx), _mm_mul_ps(cy, ny)), _mm_add_ps(_mm_mul_ps(cz, nz), _mm_mul_ps(cw, nw)));
+        const __m128 sign = _mm_and_ps(dot, _mm_set1_ps(-0.0f));
+        nx = _mm_xor_ps(nx, sign);
+        ny = _mm_xor_ps(ny, sign);
+        nz = _mm_xor_ps(nz, sign);
+        nw = _mm_xor_ps(nw, sign);
+        dot = _mm_xor_ps(dot, sign);
+
+        const __m128 s = _mm_sub_ps(_mm_set1_ps(1.0f), t);
+        __m128 rx = _mm_add_ps(_mm_mul_ps(cx, s), _mm_mul_ps(nx, t));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(cy, s), _mm_mul_ps(ny, t));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(cz, s), _mm_mul_ps(nz, t));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(cw, s), _mm_mul_ps(nw, t));
+
+        // rsqrt plus a Newton-Raphson step
+        const __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+        __m128 inv = _mm_rsqrt_ps(length2);
+        inv = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), inv), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(length2, inv), inv)));
+        rx = _mm_mul_ps(rx, inv);
+        ry = _mm_mul_ps(ry, inv);
+        rz = _mm_mul_ps(rz, inv);
+        rw = _mm_mul_ps(rw, inv);
+
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+        _mm_store_ps(joints, rx);
+        _mm_store_ps(joints + Skeleton::JOINT_STRIDE, ry);
+        _mm_store_ps(joints + (Skeleton::JOINT_STRIDE * 2), rz);
+        _mm_store_ps(joints + (Skeleton::JOINT_STRIDE * 3), rw);
+
+        return _mm_movemask_ps(_mm_cmplt_ps(dot, cos_threshold));
+    }
+#endif
+}
 
 Logger& Animation::logger(Logger::instance("md5mv.Animation"));
 
+bool Animation::_compress = false;
+float Animation::_position_tolerance = 0.0f;
+float Animation::_orientation_tolerance = 0.0f;
+
+bool Animation::_batch = false;
+float Animation::_nlerp_cos_threshold = FLT_MAX;
+
+void Animation::compression(bool enable, float position_tolerance, float orientation_tolerance)
+{
+    _compress = enable;
+    _position_tolerance = position_tolerance;
+    _orientation_tolerance = orientation_tolerance;
+}
+
+void Animation::batch_interpolation(bool enable, float nlerp_threshold)
+{
+    _batch = enable;
+
+    // the quaternions are half the angle apart, nothing is close enough past 1.0
+    // NOTE: the poses aren't quite unit length so their dot can land on or over 1.0
+    _nlerp_cos_threshold = nlerp_threshold > 0.0f ? std::cos(nlerp_threshold * 0.5f) : FLT_MAX;
+}
+
 Animation::Animation(const std::string& name)
     : _name(name), _frate(0), _fduration(0.0)
 {
@@ -18,13 +104,21 @@ Animation::~Animation() throw()
 bool Animation::load(const boost::filesystem::path& path)
 {
     unload();
-    return on_load(path);
+    if(!on_load(path)) {
+        return false;
+    }
+
+    if(_compress) {
+        compress_poses();
+    }
+    return true;
 }
 
 void Animation::unload() throw()
 {
     _frames.clear();
-    _skeletons.clear();
+    _poses.clear();
+    _tracks.reset();
 
     _skeleton.reset();
 
@@ -36,19 +130,78 @@ void Animation::unload() throw()
 
 void Animation::interpolate_skeleton(size_t current_frame, size_t next_frame, Skeleton& sk, double frame_percent) const
 {
-    const Skeleton &cframe(skeleton(current_frame)), &nframe(skeleton(next_frame));
-    for(size_t i=0; i<this->joint_count(); ++i) {
-        const Skeleton::Joint& cfjoint(cframe.joint(i)), nfjoint(nframe.joint(i));
+    if(sk.joint_count() != joint_count()) {
+        sk.allocate(_skeleton);
+    }
+
+    if(_tracks) {
+        JointPose cposes[DECODE_BATCH], nposes[DECODE_BATCH];
+        for(size_t i=0; i<this->joint_count(); i+=DECODE_BATCH) {
+            const size_t count = std::min(DECODE_BATCH, this->joint_count() - i);
+            for(size_t j=0; j<count; ++j) {
+                _tracks->decode(current_frame, i + j, cposes[j]);
+                _tracks->decode(next_frame, i + j, nposes[j]);
+            }
+            interpolate_joints(i, count, cposes, nposes, sk, frame_percent);
+        }
+        return;
+    }
 
-        Skeleton::Joint joint;
-        joint.parent = cfjoint.parent >= 0 ? cfjoint.parent : -1;
-        joint.position = cfjoint.position.lerp(nfjoint.position, frame_percent);
-        joint.orientation = cfjoint.orientation.slerp(nfjoint.orientation, frame_percent);
+    interpolate_joints(0, this->joint_count(), pose(current_frame), pose(next_frame), sk, frame_percent);
+}
+
+void Animation::interpolate_joints(size_t start, size_t count, const JointPose* const current, const JointPose* const next, Skeleton& sk, double frame_percent) const
+{
+#if defined USE_SSE
+    if(_batch) {
+        const __m128 t = _mm_set1_ps(static_cast<float>(frame_percent)), cos_threshold = _mm_set1_ps(_nlerp_cos_threshold);
+        for(size_t i=0; i<count; i+=4) {
+            float* joints = sk.joints() + ((start + i) * Skeleton::JOINT_STRIDE);
+            const JointPose *cposes = current + i, *nposes = next + i;
 
-        sk.add_joint(joint);
+            // the last few joints are padded out to a full batch
+            const size_t remaining = std::min(count - i, static_cast<size_t>(4));
+            JointPose cpad[4], npad[4];
+            __m128 pad[Skeleton::JOINT_STRIDE];
+            if(remaining < 4) {
+                for(size_t j=0; j<4; ++j) {
+                    cpad[j] = cposes[std::min(j, remaining - 1)];
+                    npad[j] = nposes[std::min(j, remaining - 1)];
+                }
+                cposes = cpad;
+                nposes = npad;
+                joints = reinterpret_cast<float*>(pad);
+            }
+
+            const int slerp = interpolate_joints_sse(cposes, nposes, joints, t, cos_threshold);
+            if(remaining < 4) {
+                std::memcpy(sk.joints() + ((start + i) * Skeleton::JOINT_STRIDE), pad, sizeof(float) * remaining * Skeleton::JOINT_STRIDE);
+            }
+
+            for(size_t j=0; j<remaining; ++j) {
+                if(slerp & (1 << j)) {
+                    sk.orientation(start + i + j, Quaternion(current[i + j].orientation).slerp(Quaternion(next[i + j].orientation), frame_percent));
+                }
+            }
+        }
+        return;
+    }
+#endif
+
+    for(size_t i=0; i<count; ++i) {
+        interpolate_joint(start + i, current[i], next[i], sk, frame_percent);
     }
 }
 
+void Animation::interpolate_joint(size_t idx, const JointPose& current, const JointPose& next, Skeleton& sk, double frame_percent) const
+{
+    const Position cfposition(current.position), nfposition(next.position);
+    const Quaternion cforientation(current.orientation), nforientation(next.orientation);
+
+    sk.position(idx, cfposition.lerp(nfposition, frame_percent));
+    sk.orientation(idx, cforientation.slerp(nforientation, frame_percent));
+}
+
 void Animation::frame_rate(int rate)
 {
     if(rate <= 0.0) {
@@ -59,6 +212,28 @@ void Animation::frame_rate(int rate)
     _fduration = 1.0 / rate;
 }
 
+void Animation::compress_poses()
+{
+    if(!has_poses()) {
+        return;
+    }
+
+    const double start = get_time();
+
+    _tracks.reset(new AnimationTracks());
+    _tracks->compress(*this, _position_tolerance, _orientation_tolerance);
+
+    const size_t size = _poses.size() * sizeof(JointPose);
+    LOG_INFO("Compressed animation '" << _name << "' from " << size << " to " << _tracks->size() << " bytes ("
+        << (_tracks->size() > 0 ? static_cast<double>(size) / _tracks->size() : 0.0) << ":1) in "
+        << ((get_time() - start) * 1000.0) << "ms, kept " << _tracks->key_count() << " of "
+        << (_poses.size() * 2) << " keys, max error " << _tracks->max_position_error() << " units / "
+        << RAD_DEG(_tracks->max_orientation_error()) << " degrees" << std::endl);
+
+    // the tracks replace the poses
+    std::vector<JointPose>().swap(_poses);
+}
+
 bool Animation::on_load(const boost::filesystem::path& path)
 {
     boost::filesystem::path filename(model_dir() / path / (name() + extension()));
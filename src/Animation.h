@@ -4,6 +4,7 @@
 #include "AABB.h"
 #include "Model.h"
 
+class AnimationTracks;
 class Lexer;
 
 class Animation
@@ -19,12 +20,41 @@ public:
         AABB bounds;
     };
 
+    // model-space joint pose
+    // these are kept flat so that a whole animation
+    // can be cooked and loaded without any per-joint allocations
+    struct JointPose
+    {
+        float position[4];
+
+        // NOTE: this is (x, y, z, w)
+        float orientation[4];
+    };
+
 public:
     static std::string extension() { return ".mdlanim"; }
 
+    // compresses the poses of every animation loaded afterwards (see AnimationTracks)
+    // the position tolerance is in world units and the orientation tolerance is in radians
+    static bool compression() { return _compress; }
+    static void compression(bool enable, float position_tolerance, float orientation_tolerance);
+
+    // interpolates skeletons four joints at a time (needs SSE)
+    // orientations that rotate less than the threshold (in radians) between frames
+    // are nlerped and the rest fall back to slerp, 0 always slerps
+    // NOTE: the scalar path is the reference
+    static bool batch_interpolation() { return _batch; }
+    static void batch_interpolation(bool enable, float nlerp_threshold);
+
 private:
     static Logger& logger;
 
+    static bool _compress;
+    static float _position_tolerance, _orientation_tolerance;
+
+    static bool _batch;
+    static float _nlerp_cos_threshold;
+
 public:
     explicit Animation(const std::string& name);
     virtual ~Animation() throw();
@@ -37,9 +67,14 @@ public:
     const Frame& frame(size_t idx) const { return *(_frames[idx]); }
 
     size_t joint_count() const { return _skeleton.joint_count(); }
-    const Skeleton& skeleton(size_t idx) const { return *(_skeletons[idx]); }
 
-    const Skeleton::Joint& base_joint(size_t idx) const { return _skeleton.joint(idx); }
+    bool compressed() const { return static_cast<bool>(_tracks); }
+
+    // model-space joint poses for the given frame
+    // NOTE: these are gone once the animation is compressed
+    const JointPose* pose(size_t idx) const { return &_poses[idx * joint_count()]; }
+
+    Skeleton::Joint base_joint(size_t idx) const { return _skeleton.joint(idx); }
 
     double frame_rate() const { return _frate; }
     double frame_duration() const { return _fduration; }
@@ -50,13 +85,19 @@ public:
 
     virtual void build_skeletons() {}
 
+    // interpolates in place into a skeleton allocated from the model
+    // (or from the animation's base skeleton if it isn't)
     void interpolate_skeleton(size_t current_frame, size_t next_frame, Skeleton& skeleton, double frame_percent) const;
 
 protected:
     void add_frame(boost::shared_ptr<Frame> frame) { _frames.push_back(frame); }
-    void add_skeleton(boost::shared_ptr<Skeleton> skeleton) { _skeletons.push_back(skeleton); }
     void add_base_joint(const Skeleton::Joint& joint) { _skeleton.add_joint(joint); }
 
+    // allocates a pose for each joint in each frame
+    void allocate_poses() { _poses.resize(frame_count() * joint_count()); }
+    bool has_poses() const { return !_poses.empty(); }
+    JointPose* pose(size_t idx) { return &_poses[idx * joint_count()]; }
+
     void frame_rate(int rate);
 
     virtual bool on_load(const boost::filesystem::path& path);
@@ -65,11 +106,20 @@ protected:
 private:
     bool scan_header(Lexer& lexer);
 
+    // replaces the poses with compressed tracks
+    void compress_poses();
+
+    void interpolate_joint(size_t idx, const JointPose& current, const JointPose& next, Skeleton& skeleton, double frame_percent) const;
+
+    // interpolates count joints starting at start
+    void interpolate_joints(size_t start, size_t count, const JointPose* const current, const JointPose* const next, Skeleton& skeleton, double frame_percent) const;
+
 private:
     std::string _name;
 
     std::vector<boost::shared_ptr<Frame> > _frames;
-    std::vector<boost::shared_ptr<Skeleton> > _skeletons;
+    std::vector<JointPose> _poses;
+    boost::scoped_ptr<AnimationTracks> _tracks;
     Skeleton _skeleton;
 
     int _frate;
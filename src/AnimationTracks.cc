@@ -0,0 +1,375 @@
+#include "pch.h"
+#include <algorithm>
+#include "common.h"
+#include "AnimationTracks.h"
+
+namespace
+{
+    // tracks that move less than this are kept as a single value
+    const float CONSTANT_POSITION = 1e-4f;
+    const float CONSTANT_ORIENTATION = 1e-4f;
+
+    // the smallest three components of a unit quaternion are
+    // in [-1/sqrt(2), 1/sqrt(2)], they're stored in 15 bits each
+    const float SMALLEST_RANGE = 0.70710678f;
+    const float SMALLEST_STEPS = 32767.0f;
+
+    // the angle of the rotation from a to b
+    // NOTE: this is more accurate than acos(a ^ b) for small angles
+    // and doesn't mind that the poses aren't quite unit length
+    float angle_between(const Quaternion& a, const Quaternion& b)
+    {
+        const Quaternion difference(~a * b);
+        return 2.0f * std::atan2(difference.vector().length(), std::fabs(difference.scalar()));
+    }
+
+    // cheaper than slerp and close enough between nearby keys
+    Quaternion nlerp(const Quaternion& a, const Quaternion& b, float t)
+    {
+        return a.lerp((a ^ b) < 0.0f ? -b : b, t);
+    }
+
+    void encode_smallest_three(const Quaternion& q, uint16_t* const value)
+    {
+        int largest = 0;
+        for(int i=1; i<4; ++i) {
+            if(std::fabs(q[i]) > std::fabs(q[largest])) {
+                largest = i;
+            }
+        }
+
+        // the dropped component has to be positive to rebuild it
+        const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+        for(int i=0, j=0; i<4; ++i) {
+            if(i == largest) {
+                continue;
+            }
+
+            const float v = std::max(std::min(q[i] * sign, SMALLEST_RANGE), -SMALLEST_RANGE);
+            value[j++] = static_cast<uint16_t>(((v / SMALLEST_RANGE) * 0.5f + 0.5f) * SMALLEST_STEPS + 0.5f);
+        }
+
+        // the dropped component's index goes in the spare bits
+        value[0] |= (largest & 1) << 15;
+        value[1] |= (largest >> 1) << 15;
+    }
+
+    void decode_smallest_three(const uint16_t* const value, float* const q)
+    {
+        const int largest = (value[0] >> 15) | ((value[1] >> 15) << 1);
+
+        float sum = 0.0f;
+        for(int i=0, j=0; i<4; ++i) {
+            if(i == largest) {
+                continue;
+            }
+
+            q[i] = (((value[j++] & 0x7fff) / SMALLEST_STEPS) * 2.0f - 1.0f) * SMALLEST_RANGE;
+            sum += q[i] * q[i];
+        }
+        q[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    }
+
+    // the error interpolating a frame between two decoded keys
+    struct PositionError
+    {
+        const std::vector<Position>& source;
+        const std::vector<Position>& decoded;
+
+        float operator()(size_t first, size_t last, size_t frame) const
+        {
+            const double t = static_cast<double>(frame - first) / (last - first);
+            return decoded[first].lerp(decoded[last], t).distance(source[frame]);
+        }
+    };
+
+    struct OrientationError
+    {
+        const std::vector<Quaternion>& source;
+        const std::vector<Quaternion>& decoded;
+
+        float operator()(size_t first, size_t last, size_t frame) const
+        {
+            const double t = static_cast<double>(frame - first) / (last - first);
+            return angle_between(nlerp(decoded[first], decoded[last], static_cast<float>(t)), source[frame]);
+        }
+    };
+
+    // keeps the first and last frames and as few in between as it can
+    template<typename Error>
+    std::vector<size_t> reduce_keys(size_t frame_count, float tolerance, const Error& error)
+    {
+        std::vector<size_t> keys;
+
+        // the kept frames are stored in 16 bits
+        if(tolerance <= 0.0f || frame_count > 0xffff) {
+            for(size_t i=0; i<frame_count; ++i) {
+                keys.push_back(i);
+            }
+            return keys;
+        }
+
+        keys.push_back(0);
+
+        size_t first = 0;
+        while(first + 1 < frame_count) {
+            // stretch the span until a frame in it can't be interpolated
+            size_t last = first + 1;
+            while(last + 1 < frame_count) {
+                bool fits = true;
+                for(size_t i=first+1; i<last+1 && fits; ++i) {
+                    fits = error(first, last + 1, i) <= tolerance;
+                }
+
+                if(!fits) {
+                    break;
+                }
+                last++;
+            }
+
+            keys.push_back(last);
+            first = last;
+        }
+
+        return keys;
+    }
+}
+
+AnimationTracks::AnimationTracks()
+    : _frame_count(0), _max_position_error(0.0f), _max_orientation_error(0.0f)
+{
+}
+
+AnimationTracks::~AnimationTracks() throw()
+{
+}
+
+size_t AnimationTracks::key_count() const
+{
+    size_t count = 0;
+    for(size_t i=0; i<joint_count(); ++i) {
+        count += _positions[i].key_count + _orientations[i].key_count;
+    }
+    return count;
+}
+
+size_t AnimationTracks::size() const
+{
+    return (_positions.size() + _orientations.size()) * sizeof(Track)
+        + (_values.size() + _keys.size()) * sizeof(uint16_t);
+}
+
+void AnimationTracks::compress(const Animation& animation, float position_tolerance, float orientation_tolerance)
+{
+    clear();
+
+    _frame_count = animation.frame_count();
+    if(0 == _frame_count) {
+        return;
+    }
+
+    for(size_t i=0; i<animation.joint_count(); ++i) {
+        _positions.push_back(compress_position(animation, i, position_tolerance));
+        _orientations.push_back(compress_orientation(animation, i, orientation_tolerance));
+    }
+
+    measure_error(animation);
+}
+
+void AnimationTracks::clear()
+{
+    _frame_count = 0;
+
+    _positions.clear();
+    _orientations.clear();
+    _values.clear();
+    _keys.clear();
+
+    _max_position_error = _max_orientation_error = 0.0f;
+}
+
+void AnimationTracks::decode(size_t frame, size_t joint, Animation::JointPose& pose) const
+{
+    decode_position(_positions[joint], frame, pose.position);
+    decode_orientation(_orientations[joint], frame, pose.orientation);
+}
+
+AnimationTracks::Track AnimationTracks::compress_position(const Animation& animation, size_t joint, float tolerance)
+{
+    Track track;
+    ZeroMemory(&track, sizeof(Track));
+    std::memcpy(track.base, animation.pose(0)[joint].position, sizeof(float) * 4);
+
+    std::vector<Position> source(_frame_count);
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for(size_t i=0; i<_frame_count; ++i) {
+        source[i] = Position(animation.pose(i)[joint].position);
+        for(int j=0; j<3; ++j) {
+            minimum[j] = std::min(minimum[j], source[i][j]);
+            maximum[j] = std::max(maximum[j], source[i][j]);
+        }
+    }
+
+    bool constant = true;
+    for(int i=0; i<3; ++i) {
+        constant = constant && maximum[i] - minimum[i] <= CONSTANT_POSITION;
+    }
+
+    if(constant) {
+        track.key_count = 1;
+        return track;
+    }
+
+    for(int i=0; i<3; ++i) {
+        track.base[i] = minimum[i];
+        track.scale[i] = (maximum[i] - minimum[i]) / 65535.0f;
+    }
+
+    std::vector<uint16_t> values(_frame_count * 3);
+    std::vector<Position> decoded(source);
+    for(size_t i=0; i<_frame_count; ++i) {
+        for(int j=0; j<3; ++j) {
+            const uint16_t value = track.scale[j] > 0.0f
+                ? static_cast<uint16_t>((source[i][j] - minimum[j]) / track.scale[j] + 0.5f)
+                : 0;
+
+            values[i * 3 + j] = value;
+            decoded[i][j] = track.base[j] + value * track.scale[j];
+        }
+    }
+
+    const PositionError error = { source, decoded };
+    store_keys(track, reduce_keys(_frame_count, tolerance, error), values);
+    return track;
+}
+
+AnimationTracks::Track AnimationTracks::compress_orientation(const Animation& animation, size_t joint, float tolerance)
+{
+    Track track;
+    ZeroMemory(&track, sizeof(Track));
+    std::memcpy(track.base, animation.pose(0)[joint].orientation, sizeof(float) * 4);
+
+    std::vector<Quaternion> source(_frame_count);
+    bool constant = true;
+    for(size_t i=0; i<_frame_count; ++i) {
+        source[i] = Quaternion(animation.pose(i)[joint].orientation);
+        constant = constant && angle_between(source[i], source[0]) <= CONSTANT_ORIENTATION;
+    }
+
+    if(constant) {
+        track.key_count = 1;
+        return track;
+    }
+
+    std::vector<uint16_t> values(_frame_count * 3);
+    std::vector<Quaternion> decoded(_frame_count);
+    for(size_t i=0; i<_frame_count; ++i) {
+        // the dropped component is rebuilt assuming unit length
+        // so this can't use the approximate normalize()
+        encode_smallest_three(source[i] / std::sqrt(source[i] ^ source[i]), &values[i * 3]);
+
+        float orientation[4];
+        decode_smallest_three(&values[i * 3], orientation);
+        decoded[i] = Quaternion(orientation);
+    }
+
+    const OrientationError error = { source, decoded };
+    store_keys(track, reduce_keys(_frame_count, tolerance, error), values);
+    return track;
+}
+
+void AnimationTracks::store_keys(Track& track, const std::vector<size_t>& keys, const std::vector<uint16_t>& values)
+{
+    track.key_count = keys.size();
+
+    track.values = _values.size();
+    BOOST_FOREACH(size_t key, keys) {
+        _values.insert(_values.end(), values.begin() + key * 3, values.begin() + key * 3 + 3);
+    }
+
+    // every frame is a key, so there's nothing to look up
+    if(keys.size() == _frame_count) {
+        return;
+    }
+
+    track.keys = _keys.size();
+    BOOST_FOREACH(size_t key, keys) {
+        _keys.push_back(static_cast<uint16_t>(key));
+    }
+}
+
+size_t AnimationTracks::find_key(const Track& track, size_t frame, float& t) const
+{
+    t = 0.0f;
+    if(track.key_count == _frame_count) {
+        return frame;
+    }
+
+    // the last frame is always kept so this only runs off the end on it
+    const uint16_t* const begin = &_keys[track.keys];
+    const uint16_t* const end = begin + track.key_count;
+    const uint16_t* const next = std::upper_bound(begin, end, frame);
+
+    const size_t key = (next - begin) - 1;
+    if(next != end) {
+        t = static_cast<float>(frame - begin[key]) / (*next - begin[key]);
+    }
+    return key;
+}
+
+void AnimationTracks::decode_position(const Track& track, size_t frame, float* const position) const
+{
+    if(1 == track.key_count) {
+        std::memcpy(position, track.base, sizeof(float) * 4);
+        return;
+    }
+
+    float t;
+    const uint16_t* const value = &_values[track.values + find_key(track, frame, t) * 3];
+    for(int i=0; i<3; ++i) {
+        position[i] = track.base[i] + value[i] * track.scale[i];
+        if(t > 0.0f) {
+            const float next = track.base[i] + value[i + 3] * track.scale[i];
+            position[i] += (next - position[i]) * t;
+        }
+    }
+    position[3] = track.base[3];
+}
+
+void AnimationTracks::decode_orientation(const Track& track, size_t frame, float* const orientation) const
+{
+    if(1 == track.key_count) {
+        std::memcpy(orientation, track.base, sizeof(float) * 4);
+        return;
+    }
+
+    float t;
+    const uint16_t* const value = &_values[track.values + find_key(track, frame, t) * 3];
+    decode_smallest_three(value, orientation);
+    if(t > 0.0f) {
+        float next[4];
+        decode_smallest_three(value + 3, next);
+
+        const Quaternion interpolated(nlerp(Quaternion(orientation), Quaternion(next), t));
+        for(int i=0; i<4; ++i) {
+            orientation[i] = interpolated[i];
+        }
+    }
+}
+
+void AnimationTracks::measure_error(const Animation& animation)
+{
+    _max_position_error = _max_orientation_error = 0.0f;
+    for(size_t i=0; i<_frame_count; ++i) {
+        const Animation::JointPose* const source = animation.pose(i);
+        for(size_t j=0; j<joint_count(); ++j) {
+            Animation::JointPose pose;
+            decode(i, j, pose);
+
+            _max_position_error = std::max(_max_position_error,
+                Position(pose.position).distance(Position(source[j].position)));
+            _max_orientation_error = std::max(_max_orientation_error,
+                angle_between(Quaternion(pose.orientation), Quaternion(source[j].orientation)));
+        }
+    }
+}
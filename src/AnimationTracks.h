@@ -0,0 +1,82 @@
+#if !defined __ANIMATIONTRACKS_H__
+#define __ANIMATIONTRACKS_H__
+
+#include "Animation.h"
+
+// compressed animation poses, a position track and an orientation track per joint
+// constant tracks keep a single value, the rest keep 16-bit positions
+// (quantized to the track's range) and smallest-three orientations
+// (the largest component is dropped and rebuilt from the other three)
+// keyframes that can be interpolated from the ones around them within
+// the tolerance are dropped as well
+class AnimationTracks
+{
+private:
+    struct Track
+    {
+        // 1 key is a constant track, frame_count() keys is every frame
+        // anything in between has its frames in _keys starting at keys
+        uint32_t key_count, keys;
+
+        // offset into _values, 3 per key
+        uint32_t values;
+
+        // constant value, or the quantization minimum and step for positions
+        float base[4];
+        float scale[3];
+    };
+
+public:
+    AnimationTracks();
+    virtual ~AnimationTracks() throw();
+
+public:
+    size_t frame_count() const { return _frame_count; }
+    size_t joint_count() const { return _positions.size(); }
+
+    // keys kept across every track
+    size_t key_count() const;
+
+    // bytes used by the tracks
+    size_t size() const;
+
+    // measured against the source poses
+    float max_position_error() const { return _max_position_error; }
+    float max_orientation_error() const { return _max_orientation_error; }
+
+    // position_tolerance is in world units and orientation_tolerance is in radians
+    // a tolerance of 0 keeps every keyframe
+    void compress(const Animation& animation, float position_tolerance, float orientation_tolerance);
+    void clear();
+
+    // NOTE: this doesn't allocate so it's safe to call from any thread
+    void decode(size_t frame, size_t joint, Animation::JointPose& pose) const;
+
+private:
+    Track compress_position(const Animation& animation, size_t joint, float tolerance);
+    Track compress_orientation(const Animation& animation, size_t joint, float tolerance);
+
+    // stores the kept keys' values and frames
+    void store_keys(Track& track, const std::vector<size_t>& keys, const std::vector<uint16_t>& values);
+
+    // the key at or before frame and how far frame is towards the next one
+    size_t find_key(const Track& track, size_t frame, float& t) const;
+
+    void decode_position(const Track& track, size_t frame, float* const position) const;
+    void decode_orientation(const Track& track, size_t frame, float* const orientation) const;
+
+    void measure_error(const Animation& animation);
+
+private:
+    size_t _frame_count;
+
+    std::vector<Track> _positions, _orientations;
+    std::vector<uint16_t> _values, _keys;
+
+    float _max_position_error, _max_orientation_error;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(AnimationTracks);
+};
+
+#endif
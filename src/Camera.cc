@@ -17,6 +17,29 @@ int Camera::check_clipping(const Vector4& clipped)
     return code;
 }
 
+float Camera::clip_distance(const Vector4& clipped, int plane)
+{
+    switch(plane)
+    {
+    case 0: return clipped.w() + clipped.x();   // left plane
+    case 1: return clipped.w() - clipped.x();   // right plane
+    case 2: return clipped.w() + clipped.y();   // bottom plane
+    case 3: return clipped.w() - clipped.y();   // top plane
+    case 4: return clipped.w() + clipped.z();   // near plane
+    default: return clipped.w() - clipped.z();  // far plane
+    }
+}
+
+void Camera::clip_corners(const AABB& bounds, const Matrix4& clipping, Vector4* const corners)
+{
+    const Position& minimum(bounds.minimum()), maximum(bounds.maximum());
+    for(int i=0; i<8; ++i) {
+        corners[i] = clipping * Position(i & 1 ? maximum.x() : minimum.x(),
+            i & 2 ? maximum.y() : minimum.y(),
+            i & 4 ? maximum.z() : minimum.z(), 1.0f);
+    }
+}
+
 Camera::Camera()
     : Physical(), _up(0.0f, 1.0f, 0.0f)
 {
@@ -40,20 +63,41 @@ void Camera::look()
 
 bool Camera::visible(const AABB& bounds) const
 {
-    const Matrix4 clipping(Renderer::instance().clipping_matrix());
-
     // need to test against the 8 points of the bounding box
-    const Position p1(bounds.minimum().homogeneous_position()),
-        p2(bounds.minimum().x(), bounds.minimum().y(), bounds.maximum().z(), 1.0f),
-        p3(bounds.minimum().x(), bounds.maximum().y(), bounds.minimum().z(), 1.0f),
-        p4(bounds.minimum().x(), bounds.maximum().y(), bounds.maximum().z(), 1.0f),
-        p5(bounds.maximum().x(), bounds.minimum().y(), bounds.minimum().z(), 1.0f),
-        p6(bounds.maximum().x(), bounds.minimum().y(), bounds.maximum().z(), 1.0f),
-        p7(bounds.maximum().x(), bounds.maximum().y(), bounds.minimum().z(), 1.0f),
-        p8(bounds.maximum().homogeneous_position());
+    Vector4 corners[8];
+    clip_corners(bounds, Renderer::instance().clipping_matrix(), corners);
 
     // if all points lie outside of at least one of the clipping planes, we can cull the object
-    return (check_clipping(clipping * p1) & check_clipping(clipping * p2) & check_clipping(clipping * p3)
-        & check_clipping(clipping * p4) & check_clipping(clipping * p5) & check_clipping(clipping * p6)
-        & check_clipping(clipping * p7) & check_clipping(clipping * p8)) == 0;
+    int code = ~0;
+    for(int i=0; i<8; ++i) {
+        code &= check_clipping(corners[i]);
+    }
+    return 0 == code;
+}
+
+bool Camera::shadow_visible(const AABB& bounds, const Vector4& light_position) const
+{
+    const Matrix4 clipping(Renderer::instance().clipping_matrix());
+
+    Vector4 corners[8];
+    clip_corners(bounds, clipping, corners);
+
+    // each corner is extruded away from the light, (1 + t * lw) * p - t * l for t >= 0
+    // which stays outside a plane if the corner is outside it
+    // and the extrusion doesn't head back in, lw * d(p) - d(l) <= 0
+    const Vector4 light(clipping * light_position);
+    for(int i=0; i<6; ++i) {
+        const float ldistance = clip_distance(light, i);
+
+        bool outside = true;
+        for(int j=0; j<8 && outside; ++j) {
+            const float distance = clip_distance(corners[j], i);
+            outside = distance < 0.0f && light_position.w() * distance - ldistance <= 0.0f;
+        }
+
+        if(outside) {
+            return false;
+        }
+    }
+    return true;
 }
@@ -11,6 +11,12 @@ class Camera : public Physical
 private:
     static int check_clipping(const Vector4& clipped);
 
+    // how far inside the clipping plane (0 - 5, same order as check_clipping) the point is
+    static float clip_distance(const Vector4& clipped, int plane);
+
+    // the 8 corners of the bounding box in clip space
+    static void clip_corners(const AABB& bounds, const Matrix4& clipping, Vector4* const corners);
+
 public:
     Camera();
     virtual ~Camera() throw();
@@ -36,6 +42,11 @@ public:
     // bounding box is within the viewing frustum
     bool visible(const AABB& bounds) const;
 
+    // returns true if the shadow volume of the world-space bounding box
+    // could reach the viewing frustum, light_position has w=0 for a directional light
+    // NOTE: this doesn't check whether the box itself is visible
+    bool shadow_visible(const AABB& bounds, const Vector4& light_position) const;
+
 private:
     Direction _up;
     Position _lookat;
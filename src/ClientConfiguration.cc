@@ -16,6 +16,14 @@ ClientConfiguration::ClientConfiguration()
 {
     set_default("renderer", "mode", "bump");
     set_default("renderer", "shadows", "true");
+    set_default("renderer", "palette_skinning", "false");
+    set_default("renderer", "skinning", "cpu");
+    set_default("renderer", "shadow_volumes", "cpu");
+    set_default("renderer", "mesh_lods", "1");
+    set_default("renderer", "lod_reduction", "0.5");
+    set_default("renderer", "lod_screen_size", "0.25");
+    set_default("renderer", "lod_hysteresis", "0.15");
+    set_default("renderer", "shadow_lod_bias", "1");
 
     set_default("video", "width", "1280");
     set_default("video", "height", "720");
@@ -25,6 +33,18 @@ ClientConfiguration::ClientConfiguration()
     set_default("video", "maxfps", "-1");
 
     set_default("game", "fov", "75.0");
+    set_default("game", "threads", "0");
+    set_default("game", "pose_steps", "0");
+
+    set_default("animation", "compress", "false");
+    set_default("animation", "position_error", "0.0");
+    set_default("animation", "orientation_error", "0.0");
+    set_default("animation", "interpolation", "scalar");
+    set_default("animation", "nlerp_threshold", "10.0");
+    set_default("animation", "update_lod", "false");
+    set_default("animation", "lod_half_rate", "0.2");
+    set_default("animation", "lod_quarter_rate", "0.1");
+    set_default("animation", "lod_frozen", "0.02");
 
     set_default("input", "sensitivity", "1.0");
 
@@ -58,6 +78,34 @@ void ClientConfiguration::validate() const throw(ConfigurationError)
 {
     Configuration::validate();
 
+    if("cpu" != render_skinning() && "gpu" != render_skinning()) {
+        throw ConfigurationError("Renderer skinning must be cpu or gpu");
+    }
+
+    if("cpu" != render_shadow_volumes() && "gpu" != render_shadow_volumes()) {
+        throw ConfigurationError("Renderer shadow_volumes must be cpu or gpu");
+    }
+
+    if(!is_int(get("renderer", "mesh_lods")) || render_mesh_lods() < 1 || render_mesh_lods() > 4) {
+        throw ConfigurationError("Renderer mesh_lods must be an integer from 1 to 4");
+    }
+
+    if(!is_double(get("renderer", "lod_reduction")) || render_lod_reduction() <= 0.0f || render_lod_reduction() >= 1.0f) {
+        throw ConfigurationError("Renderer lod_reduction must be a float between 0 and 1");
+    }
+
+    if(!is_double(get("renderer", "lod_screen_size")) || render_lod_screen_size() < 0.0f) {
+        throw ConfigurationError("Renderer lod_screen_size must be a non-negative float");
+    }
+
+    if(!is_double(get("renderer", "lod_hysteresis")) || render_lod_hysteresis() < 0.0f || render_lod_hysteresis() >= 1.0f) {
+        throw ConfigurationError("Renderer lod_hysteresis must be a float in [0, 1)");
+    }
+
+    if(!is_int(get("renderer", "shadow_lod_bias")) || render_shadow_lod_bias() < 0) {
+        throw ConfigurationError("Renderer shadow_lod_bias must be a non-negative integer");
+    }
+
     if(!is_int(get("video", "width"))) {
         throw ConfigurationError("Video width must be an integer");
     }
@@ -78,6 +126,46 @@ void ClientConfiguration::validate() const throw(ConfigurationError)
         throw ConfigurationError("Game fov must be a float");
     }
 
+    if(!is_int(get("game", "threads")) || game_threads() < 0) {
+        throw ConfigurationError("Game threads must be a non-negative integer");
+    }
+
+    if(!is_int(get("game", "pose_steps")) || game_pose_steps() < 0) {
+        throw ConfigurationError("Game pose_steps must be a non-negative integer");
+    }
+
+    if(!is_double(get("animation", "position_error")) || animation_position_error() < 0.0f) {
+        throw ConfigurationError("Animation position_error must be a non-negative float");
+    }
+
+    if(!is_double(get("animation", "orientation_error")) || animation_orientation_error() < 0.0f) {
+        throw ConfigurationError("Animation orientation_error must be a non-negative float");
+    }
+
+    if("scalar" != animation_interpolation() && "batch" != animation_interpolation()) {
+        throw ConfigurationError("Animation interpolation must be scalar or batch");
+    }
+
+    if(!is_double(get("animation", "nlerp_threshold")) || animation_nlerp_threshold() < 0.0f) {
+        throw ConfigurationError("Animation nlerp_threshold must be a non-negative float");
+    }
+
+    if(!is_double(get("animation", "lod_half_rate")) || animation_lod_half_rate() < 0.0f) {
+        throw ConfigurationError("Animation lod_half_rate must be a non-negative float");
+    }
+
+    if(!is_double(get("animation", "lod_quarter_rate")) || animation_lod_quarter_rate() < 0.0f) {
+        throw ConfigurationError("Animation lod_quarter_rate must be a non-negative float");
+    }
+
+    if(!is_double(get("animation", "lod_frozen")) || animation_lod_frozen() < 0.0f) {
+        throw ConfigurationError("Animation lod_frozen must be a non-negative float");
+    }
+
+    if(animation_lod_quarter_rate() > animation_lod_half_rate() || animation_lod_frozen() > animation_lod_quarter_rate()) {
+        throw ConfigurationError("Animation lod thresholds must be lod_half_rate >= lod_quarter_rate >= lod_frozen");
+    }
+
     if(!is_double(get("input", "sensitivity"))) {
         throw ConfigurationError("Input sensitivity must be a float");
     }
@@ -24,9 +24,32 @@ public:
     bool render_mode_vertex() const { return "vertex" == get("renderer", "mode"); }
     bool render_mode_bump() const { return "bump" == get("renderer", "mode"); }
 
+    // use the 4-influence matrix palette for CPU skinning
+    bool render_palette_skinning() const { return to_boolean(get("renderer", "palette_skinning").c_str()); }
+
+    // cpu or gpu
+    std::string render_skinning() const { return get("renderer", "skinning"); }
+    bool render_skinning_gpu() const { return "gpu" == get("renderer", "skinning"); }
+
     void render_shadows(bool enable) { set("renderer", "shadows", enable ? "true" : "false"); }
     bool render_shadows() const { return to_boolean(get("renderer", "shadows").c_str()); }
 
+    // cpu finds the silhouettes and uploads them for every light
+    // gpu extrudes them in a geometry shader from the triangles with adjacency
+    void render_shadow_volumes(const std::string& volumes) { set("renderer", "shadow_volumes", volumes); }
+    std::string render_shadow_volumes() const { return get("renderer", "shadow_volumes"); }
+    bool render_shadow_volumes_gpu() const { return "gpu" == get("renderer", "shadow_volumes"); }
+
+    // mesh levels generated at load, including the full mesh, 1 disables them
+    // the first simplified level is drawn below lod_screen_size of the screen height
+    // and each one after it below half the size of the one before it
+    // shadows use shadow_lod_bias levels coarser than what's drawn
+    int render_mesh_lods() const { return std::atoi(get("renderer", "mesh_lods").c_str()); }
+    float render_lod_reduction() const { return std::atof(get("renderer", "lod_reduction").c_str()); }
+    float render_lod_screen_size() const { return std::atof(get("renderer", "lod_screen_size").c_str()); }
+    float render_lod_hysteresis() const { return std::atof(get("renderer", "lod_hysteresis").c_str()); }
+    int render_shadow_lod_bias() const { return std::atoi(get("renderer", "shadow_lod_bias").c_str()); }
+
     int video_width() const { return std::atoi(get("video", "width").c_str()); }
     int video_height() const { return std::atoi(get("video", "height").c_str()); }
     int video_depth() const { return std::atoi(get("video", "depth").c_str()); }
@@ -36,6 +59,31 @@ public:
 
     float game_fov() const { return std::atof(get("game", "fov").c_str()); }
 
+    // job system threads, 0 for one per core
+    int game_threads() const { return std::atoi(get("game", "threads").c_str()); }
+
+    // poses cached per animation frame, 0 to disable the pose cache
+    int game_pose_steps() const { return std::atoi(get("game", "pose_steps").c_str()); }
+
+    // compress animations as they're loaded
+    // the errors bound the keyframe reduction, 0 keeps every keyframe
+    bool animation_compress() const { return to_boolean(get("animation", "compress").c_str()); }
+    float animation_position_error() const { return std::atof(get("animation", "position_error").c_str()); }
+    float animation_orientation_error() const { return std::atof(get("animation", "orientation_error").c_str()); }
+
+    // scalar or batch joint interpolation
+    // batch nlerps rotations under the threshold (in degrees) between frames
+    std::string animation_interpolation() const { return get("animation", "interpolation"); }
+    bool animation_interpolation_batch() const { return "batch" == get("animation", "interpolation"); }
+    float animation_nlerp_threshold() const { return std::atof(get("animation", "nlerp_threshold").c_str()); }
+
+    // update level of detail, actors covering less of the screen height than these
+    // update every 2nd frame, every 4th frame, or keep thinking but hold their pose
+    bool animation_update_lod() const { return to_boolean(get("animation", "update_lod").c_str()); }
+    float animation_lod_half_rate() const { return std::atof(get("animation", "lod_half_rate").c_str()); }
+    float animation_lod_quarter_rate() const { return std::atof(get("animation", "lod_quarter_rate").c_str()); }
+    float animation_lod_frozen() const { return std::atof(get("animation", "lod_frozen").c_str()); }
+
     float input_sensitivity() const { return std::atof(get("input", "sensitivity").c_str()); }
 
 public:
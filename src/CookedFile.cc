@@ -0,0 +1,159 @@
+#include "pch.h"
+#include <fstream>
+#include "CookedFile.h"
+
+namespace
+{
+    struct CookedHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t source_size;
+        int64_t source_mtime;
+    };
+
+    bool source_header(const boost::filesystem::path& source, uint32_t magic, uint32_t version, CookedHeader& header)
+    {
+        boost::system::error_code ec;
+        const boost::uintmax_t size = boost::filesystem::file_size(source, ec);
+        if(ec) {
+            return false;
+        }
+
+        const std::time_t mtime = boost::filesystem::last_write_time(source, ec);
+        if(ec) {
+            return false;
+        }
+
+        ZeroMemory(&header, sizeof(CookedHeader));
+        header.magic = magic;
+        header.version = version;
+        header.source_size = size;
+        header.source_mtime = mtime;
+        return true;
+    }
+}
+
+CookedFile::CookedFile()
+    : _position(0)
+{
+}
+
+CookedFile::~CookedFile() throw()
+{
+}
+
+bool CookedFile::open(const boost::filesystem::path& source, uint32_t magic, uint32_t version)
+{
+    close();
+
+    CookedHeader expected;
+    if(!source_header(source, magic, version, expected)) {
+        return false;
+    }
+
+    if(!_file.open(filename(source))) {
+        return false;
+    }
+
+    const CookedHeader* const header = read<CookedHeader>();
+    if(NULL == header || 0 != std::memcmp(header, &expected, sizeof(CookedHeader))) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void CookedFile::close() throw()
+{
+    _file.close();
+    _position = 0;
+}
+
+bool CookedFile::read(std::string& value)
+{
+    const uint32_t* const length = read<uint32_t>();
+    if(NULL == length) {
+        return false;
+    }
+
+    const char* const data = read<char>(*length);
+    if(NULL == data) {
+        return false;
+    }
+
+    value.assign(data, *length);
+    return true;
+}
+
+CookedFileWriter::CookedFileWriter()
+{
+}
+
+CookedFileWriter::~CookedFileWriter() throw()
+{
+    if(_file) {
+        _file.reset();
+
+        boost::system::error_code ec;
+        boost::filesystem::remove(_tmpfilename, ec);
+    }
+}
+
+bool CookedFileWriter::open(const boost::filesystem::path& source, uint32_t magic, uint32_t version)
+{
+    CookedHeader header;
+    if(!source_header(source, magic, version, header)) {
+        return false;
+    }
+
+    _filename = CookedFile::filename(source);
+    _tmpfilename = _filename.string() + ".tmp";
+
+    _file.reset(new std::ofstream(_tmpfilename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc));
+    if(!_file->is_open()) {
+        _file.reset();
+        return false;
+    }
+
+    write(&header);
+    return true;
+}
+
+void CookedFileWriter::write(const std::string& value)
+{
+    const uint32_t length = value.length();
+    write(&length);
+    write(value.data(), length);
+}
+
+bool CookedFileWriter::close()
+{
+    if(!_file) {
+        return false;
+    }
+
+    _file->close();
+    const bool success = !_file->fail();
+    _file.reset();
+
+    boost::system::error_code ec;
+    if(success) {
+        boost::filesystem::rename(_tmpfilename, _filename, ec);
+        if(!ec) {
+            return true;
+        }
+    }
+
+    boost::filesystem::remove(_tmpfilename, ec);
+    return false;
+}
+
+void CookedFileWriter::write_padded(const void* const data, size_t size)
+{
+    static const char padding[4] = { 0 };
+
+    _file->write(reinterpret_cast<const char*>(data), size);
+    _file->write(padding, ((size + 3) & ~static_cast<size_t>(3)) - size);
+}
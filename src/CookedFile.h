@@ -0,0 +1,85 @@
+#if !defined __COOKEDFILE_H__
+#define __COOKEDFILE_H__
+
+#include "MappedFile.h"
+
+// versioned binary cache of data that was derived from a source file
+// the cache is considered stale if the source size or modification time changes
+// NOTE: data is stored in native byte order and padded to 4 bytes
+class CookedFile
+{
+public:
+    static boost::filesystem::path filename(const boost::filesystem::path& source) { return source.string() + ".bin"; }
+
+public:
+    CookedFile();
+    virtual ~CookedFile() throw();
+
+public:
+    // maps the cache for the given source file
+    // fails if it doesn't exist, doesn't match or is stale
+    bool open(const boost::filesystem::path& source, uint32_t magic, uint32_t version);
+    void close() throw();
+
+    bool is_open() const { return _file.is_open(); }
+
+    // returns NULL if there isn't enough data left
+    template<typename T>
+    const T* read(size_t count=1)
+    {
+        if(_position > _file.size() || count > (_file.size() - _position) / sizeof(T)) {
+            return NULL;
+        }
+
+        // the padding of the last record may run past the end of the file
+        const T* values = reinterpret_cast<const T*>(_file.data() + _position);
+        _position = std::min(_position + padded(sizeof(T) * count), _file.size());
+        return values;
+    }
+
+    bool read(std::string& value);
+
+private:
+    static size_t padded(size_t size) { return (size + 3) & ~static_cast<size_t>(3); }
+
+private:
+    MappedFile _file;
+    size_t _position;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CookedFile);
+};
+
+class CookedFileWriter
+{
+public:
+    CookedFileWriter();
+    virtual ~CookedFileWriter() throw();
+
+public:
+    bool open(const boost::filesystem::path& source, uint32_t magic, uint32_t version);
+
+    template<typename T>
+    void write(const T* const values, size_t count=1)
+    {
+        write_padded(values, sizeof(T) * count);
+    }
+
+    void write(const std::string& value);
+
+    // moves the cache into place so that a partially
+    // written cache is never picked up by CookedFile
+    bool close();
+
+private:
+    void write_padded(const void* const data, size_t size);
+
+private:
+    boost::filesystem::path _filename, _tmpfilename;
+    boost::scoped_ptr<std::ofstream> _file;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CookedFileWriter);
+};
+
+#endif
@@ -1,7 +1,9 @@
 #include "pch.h"
 #include "common.h"
+#include "util.h"
 #include "Camera.h"
 #include "Lexer.h"
+#include "Light.h"
 #include "Renderable.h"
 #include "Renderer.h"
 #include "State.h"
@@ -74,6 +76,29 @@ bool D3Map::Surface::load_textures()
     return true;
 }
 
+D3Map::ShadowModel::ShadowModel()
+    : linked(NULL), linked_version(0), vertex_count(0), index_count(0), no_caps_count(0), no_front_caps_count(0)
+{
+    glGenBuffers(Renderable::ShadowVBOCount, vbo);
+}
+
+D3Map::ShadowModel::~ShadowModel() throw()
+{
+    glDeleteBuffers(Renderable::ShadowVBOCount, vbo);
+}
+
+void D3Map::ShadowModel::init()
+{
+    // setup the vertex array
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[Renderable::ShadowVertexArray]);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * 4 * sizeof(float), vertices.get(), GL_STATIC_DRAW);
+
+    // setup the index array
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[Renderable::ShadowIndexArray]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(uint32_t), indices.get(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
 Logger& D3Map::logger(Logger::instance("md5mv.D3Map"));
 
 D3Map::D3Map(const std::string& name)
@@ -89,32 +114,10 @@ D3Map::~D3Map() throw()
 Position D3Map::player_spawn_position() const
 {
     Position position;
-    try {
-        boost::shared_ptr<Entity> player_start(_entities.at("info_player_start_1"));
-        const std::string data(player_start->properties.at("origin"));
-
-        Lexer lexer(data);
-
-        float value;
-        if(!lexer.float_literal(value)) {
-            return position;
-        }
-        position.x(value);
-
-        if(!lexer.float_literal(value)) {
-            return position;
-        }
-        position.y(value);
-
-        if(!lexer.float_literal(value)) {
-            return position;
-        }
-        position.z(value);
-    } catch(const std::out_of_range&) {
+    if(!entity_origin("info_player_start_1", position)) {
         LOG_WARNING("Missing info_player_start origin!" << std::endl);
     }
-
-    return swizzle(position);
+    return position;
 }
 
 float D3Map::player_spawn_angle() const
@@ -150,12 +153,45 @@ bool D3Map::load(const boost::filesystem::path& path)
     return true;
 }
 
+bool D3Map::entity_origin(const std::string& name, Position& origin) const
+{
+    Position position;
+    try {
+        boost::shared_ptr<Entity> entity(_entities.at(name));
+        const std::string data(entity->properties.at("origin"));
+
+        Lexer lexer(data);
+
+        float value;
+        if(!lexer.float_literal(value)) {
+            return false;
+        }
+        position.x(value);
+
+        if(!lexer.float_literal(value)) {
+            return false;
+        }
+        position.y(value);
+
+        if(!lexer.float_literal(value)) {
+            return false;
+        }
+        position.z(value);
+    } catch(const std::out_of_range&) {
+        return false;
+    }
+
+    origin = swizzle(position);
+    return true;
+}
+
 void D3Map::on_unload()
 {
     _version = 0;
 
     _acount = 0;
     _models.clear();
+    _shadow_models.clear();
 
     _entities.clear();
     _worldspawn.reset();
@@ -207,6 +243,70 @@ void D3Map::render_normals(const Camera& camera) const
     }
 }
 
+bool D3Map::light_origin(const std::string& name, Position& origin) const
+{
+    Entities::const_iterator it(_entities.find(name));
+    if(it == _entities.end()) {
+        return false;
+    }
+
+    // dmap only builds shadows for point lights
+    boost::unordered_map<std::string, std::string>::const_iterator classname(it->second->properties.find("classname"));
+    if(classname == it->second->properties.end() || "light" != classname->second) {
+        return false;
+    }
+
+    return entity_origin(name, origin);
+}
+
+void D3Map::link_light(const std::string& name, const Light& light)
+{
+    size_t count = 0;
+    BOOST_FOREACH(boost::shared_ptr<ShadowModel> shadow_model, _shadow_models) {
+        if(shadow_model->light == name) {
+            shadow_model->linked = &light;
+            shadow_model->linked_version = light.transform_version();
+            count++;
+        }
+    }
+    LOG_INFO("Linked " << count << " precomputed shadow volumes to " << name << std::endl);
+}
+
+bool D3Map::render_shadow(Shader& shader, const Light& light) const
+{
+    BOOST_FOREACH(boost::shared_ptr<ShadowModel> shadow_model, _shadow_models) {
+        // the far vertices were projected from where the light started out
+        if(shadow_model->linked != &light || shadow_model->linked_version != light.transform_version()) {
+            continue;
+        }
+
+        shader.begin();
+
+        Renderer::instance().init_shader_matrices(shader);
+
+        // the vertices are all at w=1 so this draws them as they are
+        shader.uniform1i("cap", false);
+
+        // get the attribute locations
+        GLint vloc = shader.attrib_location("vertex");
+
+        // render the volume, the caps aren't needed without z-fail
+        glEnableVertexAttribArray(vloc);
+            glBindBuffer(GL_ARRAY_BUFFER, shadow_model->vbo[Renderable::ShadowVertexArray]);
+            glVertexAttribPointer(vloc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shadow_model->vbo[Renderable::ShadowIndexArray]);
+            glDrawElements(GL_TRIANGLES, shadow_model->no_caps_count, GL_UNSIGNED_INT, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDisableVertexAttribArray(vloc);
+
+        shader.end();
+        return true;
+    }
+
+    return false;
+}
+
 void D3Map::render_area(const Camera& camera, const Model& area, Shader& shader) const
 {
     for(int i=0; i<area.surface_count; ++i) {
@@ -318,11 +418,21 @@ void D3Map::render_surface_normals(const Surface& surface) const
     gshader.end();
 }
 
+void D3Map::log_load_time(const std::string& type, const boost::filesystem::path& filename, double start) const
+{
+    const double elapsed = get_time() - start;
+    const double mb = boost::filesystem::file_size(filename) / (1024.0 * 1024.0);
+    LOG_INFO("Loaded " << type << " '" << filename << "' in " << (elapsed * 1000.0) << "ms ("
+        << (elapsed > 0.0 ? mb / elapsed : 0.0) << " MB/s)" << std::endl);
+}
+
 bool D3Map::load_map(const boost::filesystem::path& path)
 {
     boost::filesystem::path filename = map_dir() / path / (name() + ".map");
     LOG_INFO("Loading map from '" << filename << "'" << std::endl);
 
+    const double start = get_time();
+
     Lexer lexer;
     if(!lexer.load(filename)) {
         return false;
@@ -346,6 +456,7 @@ bool D3Map::load_map(const boost::filesystem::path& path)
     }
 
     LOG_INFO("Read " << _entities.size() << " non-worldspawn entities" << std::endl);
+    log_load_time("map", filename, start);
 
     return true;
 }
@@ -821,6 +932,8 @@ bool D3Map::load_proc(const boost::filesystem::path& path)
     boost::filesystem::path filename(map_dir() / path / (name() + ".proc"));
     LOG_INFO("Loading geometry from '" << filename << "'" << std::endl);
 
+    const double start = get_time();
+
     Lexer lexer;
     if(!lexer.load(filename)) {
         return false;
@@ -849,6 +962,8 @@ bool D3Map::load_proc(const boost::filesystem::path& path)
             }
         }
     }
+    LOG_INFO("Read " << _shadow_models.size() << " precomputed shadow volumes" << std::endl);
+    log_load_time("geometry", filename, start);
 
     return true;
 }
@@ -1227,13 +1342,13 @@ bool D3Map::scan_proc_shadow_model(Lexer& lexer)
         return false;
     }
 
-    int cap_count;
-    if(!lexer.int_literal(cap_count)) {
+    int no_caps_count;
+    if(!lexer.int_literal(no_caps_count)) {
         return false;
     }
 
-    int front_cap_count;
-    if(!lexer.int_literal(front_cap_count)) {
+    int no_front_caps_count;
+    if(!lexer.int_literal(no_front_caps_count)) {
         return false;
     }
 
@@ -1242,55 +1357,115 @@ bool D3Map::scan_proc_shadow_model(Lexer& lexer)
         return false;
     }
 
+    // indices define triangles, so we need a multiple of 3
+    if(0 != index_count % 3 || 0 != no_caps_count % 3 || no_caps_count > index_count) {
+        return false;
+    }
+
     int plane_bits;
     if(!lexer.int_literal(plane_bits)) {
         return false;
     }
 
-    for(int i=0; i<vertex_count; ++i) {
-        if(!scan_proc_shadow_vertex(lexer)) {
+    boost::shared_ptr<ShadowModel> shadow_model(new ShadowModel());
+
+    shadow_model->vertex_count = vertex_count;
+    shadow_model->vertices.reset(new float[shadow_model->vertex_count * 4]);
+    for(int i=0; i<shadow_model->vertex_count; ++i) {
+        if(!scan_proc_shadow_vertex(lexer, shadow_model, i)) {
             return false;
         }
     }
 
-    for(int i=0; i<index_count; ++i) {
-        int index;
-        if(!lexer.int_literal(index)) {
+    shadow_model->index_count = index_count;
+    shadow_model->no_caps_count = no_caps_count;
+    shadow_model->no_front_caps_count = no_front_caps_count;
+    shadow_model->indices.reset(new uint32_t[shadow_model->index_count]);
+    for(int i=0; i<shadow_model->index_count; i+=3) {
+        int a;
+        if(!lexer.int_literal(a)) {
+            return false;
+        }
+
+        int b;
+        if(!lexer.int_literal(b)) {
+            return false;
+        }
+
+        int c;
+        if(!lexer.int_literal(c)) {
+            return false;
+        }
+
+        if(a < 0 || a >= vertex_count || b < 0 || b >= vertex_count || c < 0 || c >= vertex_count) {
             return false;
         }
+
+        // same winding swap as the surfaces
+        shadow_model->indices[i + 0] = c;
+        shadow_model->indices[i + 1] = b;
+        shadow_model->indices[i + 2] = a;
     }
 
     if(!lexer.match(CLOSE_BRACE)) {
         return false;
     }
 
-//LOG_ERROR("TODO: store shadow model info!" << std::endl);
+    // dmap names these after the light they were built for
+    static const std::string PREFIX("_prelight_");
+    if(0 != name.compare(0, PREFIX.length(), PREFIX)) {
+        LOG_WARNING("Skipping shadow model '" << name << "' with no light!" << std::endl);
+        return true;
+    }
+
+    shadow_model->light = name.substr(PREFIX.length());
+    Position origin;
+    if(!light_origin(shadow_model->light, origin)) {
+        LOG_WARNING("Skipping shadow model '" << name << "', missing light!" << std::endl);
+        return true;
+    }
+
+    shadow_model->init();
+    _shadow_models.push_back(shadow_model);
 
     return true;
 }
 
-bool D3Map::scan_proc_shadow_vertex(Lexer& lexer)
+bool D3Map::scan_proc_shadow_vertex(Lexer& lexer, boost::shared_ptr<ShadowModel> shadow_model, int index)
 {
     if(!lexer.match(OPEN_PAREN)) {
         return false;
     }
 
+    Position position;
+
     float value;
     if(!lexer.float_literal(value)) {
         return false;
     }
+    position.x(value);
 
     if(!lexer.float_literal(value)) {
         return false;
     }
+    position.y(value);
 
     if(!lexer.float_literal(value)) {
         return false;
     }
+    position.z(value);
 
     if(!lexer.match(CLOSE_PAREN)) {
         return false;
     }
 
+    // the projected vertices aren't at infinity
+    const Position swizzled(swizzle(position));
+    float* const v = shadow_model->vertices.get() + (index * 4);
+    *(v + 0) = swizzled.x();
+    *(v + 1) = swizzled.y();
+    *(v + 2) = swizzled.z();
+    *(v + 3) = 1.0f;
+
     return true;
 }
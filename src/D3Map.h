@@ -51,6 +51,33 @@ private:
     };
     typedef std::vector<boost::shared_ptr<Model> > Models;
 
+    // dmap's precomputed shadow volume of the world for one of the lights
+    // the far vertices are already projected out to the light's bounds
+    // so it's only good while the light is where the map put it
+    struct ShadowModel
+    {
+        // the map's light it was built for and the scene light linked to it
+        // with its transform version when it was linked
+        std::string light;
+        const Light* linked;
+        uint32_t linked_version;
+
+        int vertex_count;
+        boost::shared_array<float> vertices;
+
+        // the indices are ordered sides, back caps, front caps
+        int index_count, no_caps_count, no_front_caps_count;
+        boost::shared_array<uint32_t> indices;
+
+        GLuint vbo[Renderable::ShadowVBOCount];
+
+        ShadowModel();
+        virtual ~ShadowModel() throw();
+
+        void init();
+    };
+    typedef std::vector<boost::shared_ptr<ShadowModel> > ShadowModels;
+
     struct Brush
     {
         Plane plane;
@@ -101,6 +128,9 @@ public:
     virtual void render(const Camera& camera, Shader& shader) const;
     virtual void render(const Camera& camera, Shader& shader, const Light& light) const;
     virtual void render_normals(const Camera& camera) const;
+    virtual bool light_origin(const std::string& name, Position& origin) const;
+    virtual void link_light(const std::string& name, const Light& light);
+    virtual bool render_shadow(Shader& shader, const Light& light) const;
 
 private:
     void render_area(const Camera& camera, const Model& area, Shader& shader) const;
@@ -108,7 +138,13 @@ private:
     void render_surface(const Surface& surface, Shader& shader) const;
     void render_surface_normals(const Surface& surface) const;
 
+    // the origin property of the named entity
+    bool entity_origin(const std::string& name, Position& origin) const;
+
 private:
+    // logs the load time and throughput of a map or proc file
+    void log_load_time(const std::string& type, const boost::filesystem::path& filename, double start) const;
+
     bool load_map(const boost::filesystem::path& path);
     bool scan_map_version(Lexer& lexer);
     bool scan_map_entity(Lexer& lexer);
@@ -131,7 +167,7 @@ private:
     bool scan_proc_nodes(Lexer& lexer);
     bool scan_proc_node(Lexer& lexer);
     bool scan_proc_shadow_model(Lexer& lexer);
-    bool scan_proc_shadow_vertex(Lexer& lexer);
+    bool scan_proc_shadow_vertex(Lexer& lexer, boost::shared_ptr<ShadowModel> shadow_model, int index);
 
 private:
     virtual void on_unload();
@@ -142,6 +178,8 @@ private:
     int _acount;
     Models _models;
 
+    ShadowModels _shadow_models;
+
     Entities _entities;
     boost::shared_ptr<Entity> _worldspawn;
 
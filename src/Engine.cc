@@ -3,6 +3,7 @@
 #include "ClientConfiguration.h"
 #include "GameUIController.h"
 #include "Font.h"
+#include "JobSystem.h"
 #include "Player.h"
 #include "Renderer.h"
 #include "Scene.h"
@@ -37,6 +38,8 @@ bool Engine::init(int argc, char** argv)
 
     std::srand(std::time(NULL));
 
+    init_jobs(config.game_threads() > 0 ? config.game_threads() : JobSystem::default_thread_count());
+
     UIController::controller(GameUIController::new_controller());
 
     if(!Renderer::instance().create_window(config.video_width(), config.video_height(), config.video_depth(), config.video_fullscreen(), "MD5 Model Loader")) {
@@ -86,6 +89,11 @@ bool Engine::init(int argc, char** argv)
     return true;
 }
 
+void Engine::init_jobs(size_t threads)
+{
+    _jobs.reset(new JobSystem(threads));
+}
+
 void Engine::run()
 {
     UIController::controller()->handle_events();
@@ -102,6 +110,8 @@ void Engine::run()
 
 void Engine::shutdown()
 {
+    _jobs.reset();
+
     Sound::shutdown();
     TextFont::shutdown();
     SDL_Quit();
@@ -145,6 +155,20 @@ void Engine::event_loop()
 
         std::stringstream txt;
         txt << "Current FPS: " << current_fps() << ", Average FPS: " << average_fps();
+
+        const Scene& scene(*State::instance().scene());
+        if(scene.loaded()) {
+            txt << ", Skinned actors: " << scene.skinned_actor_count() << "/" << scene.actor_count();
+        }
+
+        // drawn/considered for each light
+        const std::vector<Renderer::ShadowCasterStats>& shadows(Renderer::instance().shadow_caster_stats());
+        if(!shadows.empty()) {
+            txt << ", Shadow casters:";
+            BOOST_FOREACH(const Renderer::ShadowCasterStats& stats, shadows) {
+                txt << " " << stats.light << ":" << stats.drawn << "/" << stats.considered;
+            }
+        }
         State::instance().display_text(txt.str());
 
         // check for any untrapped exceptions
@@ -1,6 +1,8 @@
 #if !defined __ENGINE_H__
 #define __ENGINE_H__
 
+class JobSystem;
+
 class Engine
 {
 public:
@@ -17,10 +19,16 @@ public:
     void run();
     void shutdown();
 
+    // init() starts these, this is for running frames without the rest
+    void init_jobs(size_t threads);
+
 public:
     void quit() { _quit = true; }
     bool should_quit() const { return _quit; }
 
+    // NOTE: only valid between init() and shutdown()
+    JobSystem& jobs() { return *_jobs; }
+
     double runtime() const;
     double frame_time() const;
 
@@ -37,6 +45,8 @@ private:
     uint64_t _frame_count;
     double _frame_start;
 
+    boost::scoped_ptr<JobSystem> _jobs;
+
 private:
     Engine();
     DISALLOW_COPY_AND_ASSIGN(Engine);
@@ -34,6 +34,9 @@ void GameUIController::key_down(SDLKey key)
         State::instance().render_wireframe(!State::instance().render_wireframe());
         glPolygonMode(GL_FRONT_AND_BACK, State::instance().render_wireframe() ? GL_LINE : GL_FILL);
         break;
+    case SDLK_g:
+        config.render_shadow_volumes(config.render_shadow_volumes_gpu() ? "cpu" : "gpu");
+        break;
     case SDLK_h:
         config.render_shadows(!config.render_shadows());
         break;
@@ -0,0 +1,319 @@
+#include "pch.h"
+#include "JobSystem.h"
+
+Logger& JobSystem::logger(Logger::instance("md5mv.JobSystem"));
+
+size_t JobSystem::default_thread_count()
+{
+    // this can be 0 if it can't be determined
+    const size_t cores = boost::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+JobSystem::JobSystem(size_t thread_count)
+    : _queued(0), _quit(false), _jobs_run(0), _jobs_stolen(0), _jobs_failed(0)
+{
+    if(thread_count < 1) {
+        thread_count = 1;
+    }
+
+    LOG_INFO("Starting job system with " << thread_count << " threads" << std::endl);
+
+    for(size_t i=0; i<thread_count; ++i) {
+        _workers.push_back(boost::shared_ptr<Worker>(new Worker()));
+    }
+
+    _counters.reserve(INITIAL_COUNTERS);
+    _free_counters.reserve(INITIAL_COUNTERS);
+    for(size_t i=0; i<INITIAL_COUNTERS; ++i) {
+        _counters.push_back(boost::shared_ptr<CounterState>(new CounterState(*this)));
+        _free_counters.push_back(_counters.back().get());
+    }
+
+    _worker_index.reset(new size_t(0));
+    for(size_t i=1; i<thread_count; ++i) {
+        _threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&JobSystem::run, this, i))));
+    }
+}
+
+JobSystem::~JobSystem() throw()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(_sleep_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+
+    BOOST_FOREACH(boost::shared_ptr<boost::thread> thread, _threads) {
+        thread->join();
+    }
+
+    // anything still queued holds counters that have to go back to the pool
+    // before it goes away
+    BOOST_FOREACH(boost::shared_ptr<Worker> worker, _workers) {
+        worker->jobs.clear();
+        worker->count = 0;
+    }
+
+    BOOST_FOREACH(boost::shared_ptr<CounterState> counter, _counters) {
+        counter->continuations.clear();
+    }
+
+    LOG_INFO("Ran " << _jobs_run << " jobs, " << _jobs_stolen << " stolen, " << _jobs_failed << " failed, "
+        << _counters.size() << " counters" << std::endl);
+}
+
+size_t JobSystem::counters_allocated() const
+{
+    boost::lock_guard<boost::mutex> lock(_counter_mutex);
+    return _counters.size();
+}
+
+JobSystem::Counter JobSystem::submit(const Task& task)
+{
+    Counter counter(acquire(1));
+    push(task, counter);
+    return counter;
+}
+
+JobSystem::Counter JobSystem::parallel_for(size_t count, const Work& work, size_t grain)
+{
+    if(grain < 1) {
+        grain = 1;
+    }
+
+    const size_t jobs = (count + grain - 1) / grain;
+    Counter counter(acquire(jobs));
+    if(0 == jobs) {
+        return counter;
+    }
+
+    // the jobs can outlive the caller's work
+    counter->work = work;
+
+    Worker& worker(*_workers[current_worker()]);
+    {
+        boost::lock_guard<boost::mutex> lock(worker.mutex);
+
+        // pushed backwards so the owner pops them in order
+        // while the thieves take from the other end
+        for(size_t i=jobs; i>0; --i) {
+            Job job;
+            job.counter = counter;
+            job.begin = (i - 1) * grain;
+            job.end = std::min(job.begin + grain, count);
+            push_back(worker, job);
+        }
+        _queued += jobs;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(_sleep_mutex);
+    }
+    _wake.notify_all();
+
+    return counter;
+}
+
+JobSystem::Counter JobSystem::then(Counter counter, const Task& task)
+{
+    Counter next(acquire(1));
+    if(counter) {
+        boost::unique_lock<boost::mutex> lock(counter->mutex);
+        if(!counter->done) {
+            counter->continuations.push_back(std::make_pair(task, next));
+            return next;
+        }
+    }
+
+    push(task, next);
+    return next;
+}
+
+void JobSystem::wait(Counter counter)
+{
+    while(!finished(counter)) {
+        if(!run_one()) {
+            boost::this_thread::yield();
+        }
+    }
+}
+
+JobSystem::Counter JobSystem::acquire(size_t count)
+{
+    CounterState* counter = NULL;
+    {
+        boost::lock_guard<boost::mutex> lock(_counter_mutex);
+        if(_free_counters.empty()) {
+            _counters.push_back(boost::shared_ptr<CounterState>(new CounterState(*this)));
+            counter = _counters.back().get();
+
+            // so releasing it never has to grow the free list
+            if(_free_counters.capacity() < _counters.size()) {
+                _free_counters.reserve(_counters.capacity());
+            }
+        } else {
+            counter = _free_counters.back();
+            _free_counters.pop_back();
+        }
+    }
+
+    counter->pending = count;
+    counter->done = 0 == count;
+    return Counter(counter);
+}
+
+void JobSystem::release(CounterState* counter)
+{
+    // the continuations keep their capacity for the next user
+    counter->continuations.clear();
+    counter->work.clear();
+
+    boost::lock_guard<boost::mutex> lock(_counter_mutex);
+    _free_counters.push_back(counter);
+}
+
+void JobSystem::push(const Task& task, Counter counter)
+{
+    Worker& worker(*_workers[current_worker()]);
+    {
+        boost::lock_guard<boost::mutex> lock(worker.mutex);
+
+        Job job;
+        job.task = task;
+        job.counter = counter;
+        push_back(worker, job);
+        _queued++;
+    }
+
+    // taking the lock means a worker can't miss this between checking and sleeping
+    {
+        boost::lock_guard<boost::mutex> lock(_sleep_mutex);
+    }
+    _wake.notify_one();
+}
+
+void JobSystem::push_back(Worker& worker, Job& job)
+{
+    // unroll the ring into one twice the size
+    if(worker.count == worker.jobs.size()) {
+        std::vector<Job> jobs(worker.jobs.size() * 2);
+        for(size_t i=0; i<worker.count; ++i) {
+            std::swap(jobs[i], worker.jobs[(worker.head + i) % worker.jobs.size()]);
+        }
+        worker.jobs.swap(jobs);
+        worker.head = 0;
+    }
+
+    std::swap(worker.jobs[(worker.head + worker.count) % worker.jobs.size()], job);
+    worker.count++;
+}
+
+void JobSystem::finish(Counter counter)
+{
+    if(--counter->pending > 0) {
+        return;
+    }
+
+    // nothing can add continuations once it's done
+    {
+        boost::lock_guard<boost::mutex> lock(counter->mutex);
+        counter->done = true;
+    }
+
+    for(size_t i=0; i<counter->continuations.size(); ++i) {
+        push(counter->continuations[i].first, counter->continuations[i].second);
+    }
+}
+
+bool JobSystem::run_one()
+{
+    const size_t idx = current_worker();
+
+    Job job;
+    if(!pop(*_workers[idx], job) && !steal(idx, job)) {
+        return false;
+    }
+
+    // a job that throws still has to finish its counter
+    // or everything waiting on it would wait forever
+    try {
+        if(job.task) {
+            job.task();
+        } else {
+            for(size_t i=job.begin; i<job.end; ++i) {
+                job.counter->work(i);
+            }
+        }
+    } catch(const std::exception& e) {
+        LOG_ERROR("Job threw an exception: " << e.what() << std::endl);
+        _jobs_failed++;
+    } catch(...) {
+        LOG_ERROR("Job threw an unknown exception" << std::endl);
+        _jobs_failed++;
+    }
+    _jobs_run++;
+
+    finish(job.counter);
+    return true;
+}
+
+bool JobSystem::pop(Worker& worker, Job& job)
+{
+    boost::lock_guard<boost::mutex> lock(worker.mutex);
+    if(0 == worker.count) {
+        return false;
+    }
+
+    // swapped out so the slot doesn't hold on to the counter
+    worker.count--;
+    std::swap(job, worker.jobs[(worker.head + worker.count) % worker.jobs.size()]);
+    _queued--;
+    return true;
+}
+
+bool JobSystem::steal(size_t thief, Job& job)
+{
+    for(size_t i=1; i<_workers.size(); ++i) {
+        Worker& victim(*_workers[(thief + i) % _workers.size()]);
+
+        boost::lock_guard<boost::mutex> lock(victim.mutex);
+        if(0 == victim.count) {
+            continue;
+        }
+
+        std::swap(job, victim.jobs[victim.head]);
+        victim.head = (victim.head + 1) % victim.jobs.size();
+        victim.count--;
+        _queued--;
+        _jobs_stolen++;
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::run(size_t idx)
+{
+    _worker_index.reset(new size_t(idx));
+
+    while(true) {
+        if(run_one()) {
+            continue;
+        }
+
+        boost::unique_lock<boost::mutex> lock(_sleep_mutex);
+        while(!_quit && 0 == _queued) {
+            _wake.wait(lock);
+        }
+
+        if(_quit) {
+            return;
+        }
+    }
+}
+
+size_t JobSystem::current_worker() const
+{
+    const size_t* const idx = _worker_index.get();
+    return NULL != idx && *idx < _workers.size() ? *idx : 0;
+}
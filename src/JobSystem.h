@@ -0,0 +1,156 @@
+#if !defined __JOBSYSTEM_H__
+#define __JOBSYSTEM_H__
+
+#include <boost/atomic.hpp>
+#include <boost/intrusive_ptr.hpp>
+
+// work-stealing job scheduler
+// each thread pushes and pops its own jobs from the back of its queue
+// and steals from the front of everybody else's when it runs out
+// the counters and job queues are pooled so a frame's worth of jobs
+// doesn't allocate once the pools have grown to fit it
+// NOTE: jobs must not touch GL, that stays on the render thread
+// NOTE: counters must not outlive the system they came from
+class JobSystem
+{
+public:
+    typedef boost::function<void ()> Task;
+    typedef boost::function<void (size_t)> Work;
+
+private:
+    struct CounterState;
+
+public:
+    // tracks a group of jobs, finished when it reaches 0
+    typedef boost::intrusive_ptr<CounterState> Counter;
+
+private:
+    struct CounterState
+    {
+        explicit CounterState(JobSystem& system) : system(system), references(0), pending(0), done(false) {}
+
+        // returns to the system's free counters when the last reference goes
+        friend void intrusive_ptr_add_ref(CounterState* counter) { counter->references++; }
+        friend void intrusive_ptr_release(CounterState* counter) { if(0 == --counter->references) counter->recycle(); }
+
+        void recycle() { system.release(this); }
+
+        JobSystem& system;
+        boost::atomic<size_t> references;
+
+        boost::atomic<size_t> pending;
+
+        // continuations waiting on this counter, guarded by mutex
+        boost::mutex mutex;
+        bool done;
+        std::vector<std::pair<Task, Counter> > continuations;
+
+        // what the parallel_for jobs on this counter run
+        Work work;
+    };
+
+    // either a task or a range of the counter's work
+    struct Job
+    {
+        Job() : begin(0), end(0) {}
+
+        Task task;
+        Counter counter;
+        size_t begin, end;
+    };
+
+    // a ring of jobs that only grows when it's full
+    struct Worker
+    {
+        Worker() : jobs(INITIAL_JOBS), head(0), count(0) {}
+
+        boost::mutex mutex;
+        std::vector<Job> jobs;
+        size_t head, count;
+    };
+
+    static const size_t INITIAL_JOBS = 1024;
+    static const size_t INITIAL_COUNTERS = 64;
+
+public:
+    // one thread per core
+    static size_t default_thread_count();
+
+private:
+    static Logger& logger;
+
+public:
+    // thread_count includes the constructing thread
+    // which becomes the first worker and runs jobs whenever it waits
+    explicit JobSystem(size_t thread_count);
+    virtual ~JobSystem() throw();
+
+public:
+    size_t thread_count() const { return _workers.size(); }
+
+    uint64_t jobs_run() const { return _jobs_run; }
+    uint64_t jobs_stolen() const { return _jobs_stolen; }
+
+    // jobs that threw, they're logged and their counters still finish
+    uint64_t jobs_failed() const { return _jobs_failed; }
+
+    // counters allocated for the pool, it only grows while more are in use than ever before
+    size_t counters_allocated() const;
+
+    Counter submit(const Task& task);
+
+    // splits [0, count) into jobs of grain items each
+    Counter parallel_for(size_t count, const Work& work, size_t grain=1);
+
+    // runs task once counter is finished
+    Counter then(Counter counter, const Task& task);
+
+    // runs jobs until counter is finished
+    void wait(Counter counter);
+
+    static bool finished(Counter counter) { return !counter || 0 == counter->pending; }
+
+private:
+    Counter acquire(size_t count);
+    void release(CounterState* counter);
+
+    void push(const Task& task, Counter counter);
+    void push_back(Worker& worker, Job& job);
+    void finish(Counter counter);
+
+    // runs one job from our own queue or somebody else's
+    bool run_one();
+    bool pop(Worker& worker, Job& job);
+    bool steal(size_t thief, Job& job);
+
+    void run(size_t idx);
+
+    size_t current_worker() const;
+
+private:
+    std::vector<boost::shared_ptr<Worker> > _workers;
+    std::vector<boost::shared_ptr<boost::thread> > _threads;
+
+    // every counter ever allocated and the ones not in use, guarded by _counter_mutex
+    mutable boost::mutex _counter_mutex;
+    std::vector<boost::shared_ptr<CounterState> > _counters;
+    std::vector<CounterState*> _free_counters;
+
+    // each thread's index into the workers
+    // NOTE: threads that aren't workers share the first queue
+    boost::thread_specific_ptr<size_t> _worker_index;
+
+    // idle workers sleep until there's something to steal
+    boost::mutex _sleep_mutex;
+    boost::condition_variable _wake;
+    boost::atomic<size_t> _queued;
+    bool _quit;
+
+    boost::atomic<uint64_t> _jobs_run, _jobs_stolen, _jobs_failed;
+
+private:
+    JobSystem();
+    DISALLOW_COPY_AND_ASSIGN(JobSystem);
+};
+
+#endif
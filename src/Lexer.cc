@@ -1,64 +1,39 @@
 #include "pch.h"
-#include "fs_util.h"
+#include <iostream>
 #include "Lexer.h"
 
-Lexer::KeywordMap Lexer::keyword_map;
-
-Lexer::KeywordMap::KeywordMap()
+namespace
 {
-    keywords["Version"] = VERSION;
-    keywords["MD5Version"] = MD5VERSION;
-    keywords["commandline"] = COMMANDLINE;
-    keywords["numJoints"] = NUM_JOINTS;
-    keywords["numMeshes"] = NUM_MESHES;
-    keywords["joints"] = JOINTS;
-    keywords["mesh"] = MESH;
-    keywords["shader"] = SHADER;
-    keywords["numverts"] = NUM_VERTS;
-    keywords["vert"] = VERT;
-    keywords["numtris"] = NUM_TRIS;
-    keywords["tri"] = TRI;
-    keywords["numweights"] = NUM_WEIGHTS;
-    keywords["weight"] = WEIGHT;
-    keywords["numFrames"] = NUM_FRAMES;
-    keywords["frameRate"] = FRAME_RATE;
-    keywords["numAnimatedComponents"] = NUM_ANIMATED_COMPONENTS;
-    keywords["hierarchy"] = HIERARCHY;
-    keywords["bounds"] = BOUNDS;
-    keywords["baseframe"] = BASE_FRAME;
-    keywords["frame"] = FRAME;
-    keywords["map"] = MAP;
-    keywords["global_ambient_color"] = GLOBAL_AMBIENT_COLOR;
-    keywords["models"] = MODELS;
-    keywords["renderables"] = RENDERABLES;
-    keywords["lights"] = LIGHTS;
-    keywords["ambient"] = AMBIENT;
-    keywords["diffuse"] = DIFFUSE;
-    keywords["specular"] = SPECULAR;
-    keywords["emissive"] = EMISSIVE;
-    keywords["shininess"] = SHININESS;
-    keywords["brushDef3"] = BRUSHDEF3;
-    keywords["patchDef2"] = PATCHDEF2;
-    keywords["patchDef3"] = PATCHDEF3;
-    keywords["mapProcFile003"] = MAP_PROC_FILE;
-    keywords["model"] = MODEL;
-    keywords["interAreaPortals"] = PORTALS;
-    keywords["nodes"] = NODES;
-    keywords["shadowModel"] = SHADOW_MODEL;
-    keywords["meshes"] = MESHES;
-    keywords["has_normals"] = HAS_NORMALS;
-    keywords["has_edges"] = HAS_EDGES;
-    keywords["vertices"] = VERTICES;
-    keywords["triangles"] = TRIANGLES;
+    inline bool is_digit(char ch)
+    {
+        return ch >= '0' && ch <= '9';
+    }
+
+    // powers of 10 that are exactly representable as doubles
+    const double EXACT_POWERS_OF_10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int MAX_EXACT_POWER_OF_10 = 22;
+
+    // largest integer that is exactly representable as a double
+    const uint64_t MAX_EXACT_MANTISSA = 1ULL << 53;
+
+    // largest number of decimal digits that always fits in a uint64_t
+    const int MAX_MANTISSA_DIGITS = 19;
 }
 
 Lexer::Lexer()
-    : _current(0)
+    : _buffer(_data.c_str()), _length(0), _current(0),
+        _lookahead(LEX_ERROR), _lookahead_position(-1), _lookahead_length(0)
 {
 }
 
 Lexer::Lexer(const std::string& data)
-    : _data(data), _current(0)
+    : _data(data), _buffer(_data.c_str()), _length(_data.length()), _current(0),
+        _lookahead(LEX_ERROR), _lookahead_position(-1), _lookahead_length(0)
 {
 }
 
@@ -68,33 +43,36 @@ Lexer::~Lexer() throw()
 
 bool Lexer::load(const boost::filesystem::path& filename)
 {
-    _data.erase();
-    if(!file_to_string(filename, _data)) {
+    clear();
+    if(!_file.open(filename)) {
+        std::cerr << "file: " << filename << " does NOT exist!" << std::endl;
         return false;
     }
+
+    _buffer = _file.data();
+    _length = _file.size();
     return true;
 }
 
+void Lexer::clear()
+{
+    _current = 0;
+
+    _data.erase();
+    _file.close();
+
+    _buffer = _data.c_str();
+    _length = 0;
+
+    _lookahead_position = -1;
+}
+
 bool Lexer::check_token(Token token)
 {
     skip_whitespace();
 
-    char ch = advance();
-    _current--;
-    switch(ch)
-    {
-    case '\0': return END == token;
-    case '(': return OPEN_PAREN == token;
-    case ')': return CLOSE_PAREN == token;
-    case '{': return OPEN_BRACE == token;
-    case '}': return CLOSE_BRACE == token;
-    default:
-        if(std::isalpha(ch) || '_' == ch) {
-            return check_keyword(token);
-        }
-    }
-
-    return false;
+    // unknown words and characters never match
+    return LEX_ERROR != token && peek() == token;
 }
 
 bool Lexer::match(Token token)
@@ -107,51 +85,42 @@ bool Lexer::int_literal(int& value)
 {
     skip_whitespace();
 
-    std::string scratch;
-    char ch = advance();
-    while(ch != '\0' && (std::isdigit(ch) || ch == '-' || ch == '.')) {
-        scratch += ch;
-        ch = advance();
-    }
-    _current--;
+    const char* const start = _buffer + _current;
+    const size_t len = number_length(false);
+    _current += len;
 
-    char* end;
-    value = strtol(scratch.c_str(), &end, 0);
-    return !(*end);
+    long v;
+    const bool ret = parse_integer(start, start + len, v);
+    value = v;
+    return ret;
 }
 
 bool Lexer::size_literal(size_t& value)
 {
     skip_whitespace();
 
-    std::string scratch;
-    char ch = advance();
-    while(ch != '\0' && (std::isdigit(ch) || ch == '-' || ch == '.')) {
-        scratch += ch;
-        ch = advance();
-    }
-    _current--;
+    const char* const start = _buffer + _current;
+    const size_t len = number_length(false);
+    _current += len;
 
-    char* end;
-    value = strtol(scratch.c_str(), &end, 0);
-    return !(*end);
+    long v;
+    const bool ret = parse_integer(start, start + len, v);
+    value = v;
+    return ret;
 }
 
 bool Lexer::float_literal(float& value)
 {
     skip_whitespace();
 
-    std::string scratch;
-    char ch = advance();
-    while(ch != '\0' && (std::isdigit(ch) || ch == '-' || ch == '.')) {
-        scratch += ch;
-        ch = advance();
-    }
-    _current--;
+    const char* const start = _buffer + _current;
+    const size_t len = number_length(true);
+    _current += len;
 
-    char* end;
-    value = strtod(scratch.c_str(), &end);
-    return !(*end);
+    double v;
+    const bool ret = parse_float(start, start + len, v);
+    value = v;
+    return ret;
 }
 
 bool Lexer::string_literal(std::string& value)
@@ -159,7 +128,10 @@ bool Lexer::string_literal(std::string& value)
     skip_whitespace();
 
     char ch = advance();
-    if(ch != '"') return false;
+    if(ch != '"') {
+        if(ch == '\0') _current--;
+        return false;
+    }
 
     value.erase();
 
@@ -168,7 +140,12 @@ bool Lexer::string_literal(std::string& value)
         value += ch;
         ch = advance();
     }
-    return ch != '\0' && ch != '\n';
+
+    if(ch == '\0') {
+        _current--;
+        return false;
+    }
+    return ch != '\n';
 }
 
 bool Lexer::bool_literal(bool& value)
@@ -193,36 +170,243 @@ void Lexer::advance_line()
     while(ch != '\0' && ch != '\r' && ch != '\n') {
         ch = advance();
     }
+
+    if(ch == '\0') {
+        _current--;
+    }
     skip_whitespace();
 }
 
+size_t Lexer::number_length(bool exponent) const
+{
+    const char* const start = _buffer + _current;
+
+    const char* p = start;
+    while(true) {
+        const char ch = *p;
+        if(is_digit(ch) || ch == '-' || ch == '.') {
+            p++;
+        } else if(exponent && (ch == 'e' || ch == 'E') && p > start && (is_digit(*(p - 1)) || *(p - 1) == '.')) {
+            p++;
+            if(*p == '+' || *p == '-') {
+                p++;
+            }
+        } else {
+            break;
+        }
+    }
+    return p - start;
+}
+
+bool Lexer::parse_integer(const char* start, const char* end, long& value)
+{
+    value = 0;
+
+    // strtol() converts nothing and succeeds
+    if(start == end) {
+        return true;
+    }
+
+    const char* p = start;
+
+    const bool negative = *p == '-';
+    if(negative) {
+        p++;
+    }
+
+    if(p == end || !is_digit(*p)) {
+        return false;
+    }
+
+    // base 0 means a leading zero is octal
+    const unsigned long base = *p == '0' ? 8 : 10;
+    const unsigned long limit = negative
+        ? static_cast<unsigned long>(LONG_MAX) + 1
+        : static_cast<unsigned long>(LONG_MAX);
+
+    unsigned long v = 0;
+    bool overflow = false;
+    for(; p != end && is_digit(*p); ++p) {
+        const unsigned long digit = *p - '0';
+        if(digit >= base) {
+            break;
+        }
+
+        if(v > (limit - digit) / base) {
+            overflow = true;
+        } else {
+            v = (v * base) + digit;
+        }
+    }
+
+    if(overflow) {
+        value = negative ? LONG_MIN : LONG_MAX;
+    } else if(negative) {
+        value = v == limit ? LONG_MIN : -static_cast<long>(v);
+    } else {
+        value = static_cast<long>(v);
+    }
+    return p == end;
+}
+
+bool Lexer::parse_float(const char* start, const char* end, double& value)
+{
+    value = 0.0;
+
+    // strtod() converts nothing and succeeds
+    if(start == end) {
+        return true;
+    }
+
+    const char* p = start;
+
+    const bool negative = *p == '-';
+    if(negative) {
+        p++;
+    }
+
+    // collect up to MAX_MANTISSA_DIGITS significant digits
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool has_digits = false, truncated = false;
+    for(; p != end && is_digit(*p); ++p) {
+        has_digits = true;
+        if(0 == mantissa && *p == '0') {
+            continue;
+        }
+
+        if(digits < MAX_MANTISSA_DIGITS) {
+            mantissa = (mantissa * 10) + (*p - '0');
+            digits++;
+        } else {
+            truncated = true;
+            exponent++;
+        }
+    }
+
+    if(p != end && *p == '.') {
+        for(++p; p != end && is_digit(*p); ++p) {
+            has_digits = true;
+            if(0 == mantissa && *p == '0') {
+                exponent--;
+                continue;
+            }
+
+            if(digits < MAX_MANTISSA_DIGITS) {
+                mantissa = (mantissa * 10) + (*p - '0');
+                digits++;
+                exponent--;
+            } else {
+                truncated = true;
+            }
+        }
+    }
+
+    if(!has_digits) {
+        return false;
+    }
+
+    if(p != end && (*p == 'e' || *p == 'E')) {
+        p++;
+
+        bool negative_exponent = false;
+        if(p != end && (*p == '+' || *p == '-')) {
+            negative_exponent = *p == '-';
+            p++;
+        }
+
+        if(p == end || !is_digit(*p)) {
+            return false;
+        }
+
+        int e = 0;
+        for(; p != end && is_digit(*p); ++p) {
+            if(e < 100000) {
+                e = (e * 10) + (*p - '0');
+            }
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+
+    if(p != end) {
+        return false;
+    }
+
+    // if the mantissa and the power of 10 are both exact
+    // then a single multiply or divide is correctly rounded
+    // Clinger, "How to Read Floating Point Numbers Accurately"
+    if(!truncated && mantissa <= MAX_EXACT_MANTISSA
+        && exponent >= -MAX_EXACT_POWER_OF_10 && exponent <= MAX_EXACT_POWER_OF_10)
+    {
+        double v = static_cast<double>(mantissa);
+        if(exponent < 0) {
+            v /= EXACT_POWERS_OF_10[-exponent];
+        } else {
+            v *= EXACT_POWERS_OF_10[exponent];
+        }
+        value = negative ? -v : v;
+        return true;
+    }
+
+    // the range is followed by a character that can't continue the number
+    // so strtod() can safely parse it in place without copying it
+    char* strtod_end;
+    value = strtod(start, &strtod_end);
+    return strtod_end == end;
+}
+
 char Lexer::advance()
 {
-    char ret = _current < _data.length() ? _data[_current] : '\0';
-    _current++;
-    return ret;
+    // the buffer is always terminated, so there's no need to check the length
+    return _buffer[_current++];
 }
 
 Token Lexer::lex()
 {
     skip_whitespace();
 
-    char ch = advance();
-    switch(ch)
+    const Token token = peek();
+    _current += _lookahead_length;
+    return token;
+}
+
+Token Lexer::peek()
+{
+    // the same token is usually checked for and then matched
+    if(_lookahead_position == _current) {
+        return _lookahead;
+    }
+
+    const char* const start = _buffer + _current;
+
+    Token token = LEX_ERROR;
+    int length = 1;
+    switch(*start)
     {
-    case '\0': return END;
-    case '(': return OPEN_PAREN;
-    case ')': return CLOSE_PAREN;
-    case '{': return OPEN_BRACE;
-    case '}': return CLOSE_BRACE;
+    case '\0':
+        token = END;
+        length = 0;
+        break;
+    case '(': token = OPEN_PAREN; break;
+    case ')': token = CLOSE_PAREN; break;
+    case '{': token = OPEN_BRACE; break;
+    case '}': token = CLOSE_BRACE; break;
     default:
-        if(std::isalnum(ch) || '_' == ch) {
-            _current--;
-            return keyword();
+        if(std::isalnum(*start) || '_' == *start) {
+            const char* end = start + 1;
+            while(std::isalnum(*end) || '_' == *end) {
+                end++;
+            }
+
+            length = end - start;
+            token = keyword(start, length);
         }
     }
 
-    return LEX_ERROR;
+    _lookahead = token;
+    _lookahead_position = _current;
+    _lookahead_length = length;
+    return token;
 }
 
 void Lexer::skip_whitespace()
@@ -246,55 +430,102 @@ void Lexer::skip_comments()
             return advance_line();
         } else if(ch == '*') {
             ch = advance();
-            while(true) {
+            while(ch != '\0') {
                 if(ch == '*') {
                     ch = advance();
                     if(ch == '/') {
                         return skip_whitespace();
                     }
+                } else {
+                    ch = advance();
                 }
-                ch = advance();
             }
+
+            // unterminated comment
+            _current--;
+            return;
         }
         _current--;
     }
     _current--;
 }
 
-bool Lexer::check_keyword(Token token)
+Token Lexer::keyword(const char* word, size_t length)
 {
-    std::string scratch;
-
-    char ch = advance();
-    size_t len = 1;
-    while(ch != '\0' && (std::isalnum(ch) || '_' == ch)) {
-        scratch += ch;
-        ch = advance();
-        len++;
-    }
-    _current -= len;
-
-    try {
-        return token == keyword_map.keywords.at(scratch);
-    } catch(std::out_of_range&) {
-    }
-    return false;
-}
-
-Token Lexer::keyword()
-{
-    std::string scratch;
-
-    char ch = advance();
-    while(ch != '\0' && (std::isalnum(ch) || '_' == ch)) {
-        scratch += ch;
-        ch = advance();
-    }
-    _current--;
-
-    try {
-        return keyword_map.keywords.at(scratch);
-    } catch(std::out_of_range&) {
+    // keywords are matched by length first and then by content
+    // NOTE: keep this in sync with the Token enum
+    switch(length)
+    {
+    case 3:
+        if(0 == std::memcmp(word, "tri", 3)) return TRI;
+        if(0 == std::memcmp(word, "map", 3)) return MAP;
+        break;
+    case 4:
+        if(0 == std::memcmp(word, "mesh", 4)) return MESH;
+        if(0 == std::memcmp(word, "vert", 4)) return VERT;
+        break;
+    case 5:
+        if(0 == std::memcmp(word, "frame", 5)) return FRAME;
+        if(0 == std::memcmp(word, "model", 5)) return MODEL;
+        if(0 == std::memcmp(word, "nodes", 5)) return NODES;
+        break;
+    case 6:
+        if(0 == std::memcmp(word, "joints", 6)) return JOINTS;
+        if(0 == std::memcmp(word, "shader", 6)) return SHADER;
+        if(0 == std::memcmp(word, "weight", 6)) return WEIGHT;
+        if(0 == std::memcmp(word, "bounds", 6)) return BOUNDS;
+        if(0 == std::memcmp(word, "models", 6)) return MODELS;
+        if(0 == std::memcmp(word, "lights", 6)) return LIGHTS;
+        if(0 == std::memcmp(word, "meshes", 6)) return MESHES;
+        break;
+    case 7:
+        if(0 == std::memcmp(word, "Version", 7)) return VERSION;
+        if(0 == std::memcmp(word, "numtris", 7)) return NUM_TRIS;
+        if(0 == std::memcmp(word, "ambient", 7)) return AMBIENT;
+        if(0 == std::memcmp(word, "diffuse", 7)) return DIFFUSE;
+        break;
+    case 8:
+        if(0 == std::memcmp(word, "numverts", 8)) return NUM_VERTS;
+        if(0 == std::memcmp(word, "specular", 8)) return SPECULAR;
+        if(0 == std::memcmp(word, "emissive", 8)) return EMISSIVE;
+        if(0 == std::memcmp(word, "vertices", 8)) return VERTICES;
+        break;
+    case 9:
+        if(0 == std::memcmp(word, "numJoints", 9)) return NUM_JOINTS;
+        if(0 == std::memcmp(word, "numMeshes", 9)) return NUM_MESHES;
+        if(0 == std::memcmp(word, "numFrames", 9)) return NUM_FRAMES;
+        if(0 == std::memcmp(word, "frameRate", 9)) return FRAME_RATE;
+        if(0 == std::memcmp(word, "hierarchy", 9)) return HIERARCHY;
+        if(0 == std::memcmp(word, "baseframe", 9)) return BASE_FRAME;
+        if(0 == std::memcmp(word, "shininess", 9)) return SHININESS;
+        if(0 == std::memcmp(word, "brushDef3", 9)) return BRUSHDEF3;
+        if(0 == std::memcmp(word, "patchDef2", 9)) return PATCHDEF2;
+        if(0 == std::memcmp(word, "patchDef3", 9)) return PATCHDEF3;
+        if(0 == std::memcmp(word, "has_edges", 9)) return HAS_EDGES;
+        if(0 == std::memcmp(word, "triangles", 9)) return TRIANGLES;
+        break;
+    case 10:
+        if(0 == std::memcmp(word, "MD5Version", 10)) return MD5VERSION;
+        if(0 == std::memcmp(word, "numweights", 10)) return NUM_WEIGHTS;
+        break;
+    case 11:
+        if(0 == std::memcmp(word, "commandline", 11)) return COMMANDLINE;
+        if(0 == std::memcmp(word, "renderables", 11)) return RENDERABLES;
+        if(0 == std::memcmp(word, "shadowModel", 11)) return SHADOW_MODEL;
+        if(0 == std::memcmp(word, "has_normals", 11)) return HAS_NORMALS;
+        break;
+    case 14:
+        if(0 == std::memcmp(word, "mapProcFile003", 14)) return MAP_PROC_FILE;
+        break;
+    case 16:
+        if(0 == std::memcmp(word, "interAreaPortals", 16)) return PORTALS;
+        break;
+    case 20:
+        if(0 == std::memcmp(word, "global_ambient_color", 20)) return GLOBAL_AMBIENT_COLOR;
+        break;
+    case 21:
+        if(0 == std::memcmp(word, "numAnimatedComponents", 21)) return NUM_ANIMATED_COMPONENTS;
+        break;
     }
     return LEX_ERROR;
 }
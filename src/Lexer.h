@@ -1,6 +1,8 @@
 #if !defined __LEXER_H__
 #define __LEXER_H__
 
+#include "MappedFile.h"
+
 enum Token
 {
     // keywords
@@ -64,13 +66,16 @@ enum Token
 
 class Lexer
 {
+public:
+    // these parse [start, end) without allocating and
+    // return false if the entire range isn't consumed
+    // (parse_integer() behaves like strtol() with base 0, parse_float() like strtod())
+    static bool parse_integer(const char* start, const char* end, long& value);
+    static bool parse_float(const char* start, const char* end, double& value);
+
 private:
-    struct KeywordMap
-    {
-        boost::unordered_map<std::string, Token> keywords;
-        KeywordMap();
-    };
-    static KeywordMap keyword_map;
+    // returns the keyword token for the word, or LEX_ERROR if it isn't a keyword
+    static Token keyword(const char* word, size_t length);
 
 public:
     Lexer();
@@ -81,8 +86,8 @@ public:
     bool load(const boost::filesystem::path& filename);
 
     int position() const { return _current; }
-    size_t length() const { return _data.length(); }
-    void clear() { _current = 0; _data.erase(); }
+    size_t length() const { return _length; }
+    void clear();
     void reset() { _current = 0; }
 
     void skip_whitespace();
@@ -100,15 +105,33 @@ public:
 private:
     void skip_comments();
 
+    // returns the length of the numeric literal at the current position
+    // the exponent form is only considered for floating point literals
+    size_t number_length(bool exponent) const;
+
     char advance();
     Token lex();
-    bool check_keyword(Token token);
-    Token keyword();
+
+    // returns the token at the current position without consuming it
+    Token peek();
 
 private:
+    // backing storage, either a copy of the string
+    // being lexed or a mapping of the file being lexed
     std::string _data;
+    MappedFile _file;
+
+    // '\0' terminated view of whichever backing storage is in use
+    // NOTE: the lexer never advances past the terminator
+    const char* _buffer;
+    size_t _length;
+
     int _current;
 
+    // the most recently peeked token
+    Token _lookahead;
+    int _lookahead_position, _lookahead_length;
+
 private:
     DISALLOW_COPY_AND_ASSIGN(Lexer);
 };
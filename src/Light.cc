@@ -21,6 +21,12 @@ Light::~Light() throw()
 {
 }
 
+float Light::intensity() const
+{
+    return std::max(std::max(std::max(_diffuse.x(), _diffuse.y()), std::max(_diffuse.z(), _specular.x())),
+        std::max(_specular.y(), _specular.z()));
+}
+
 bool Light::load_colordef(const std::string& name)
 {
     boost::filesystem::path filename(light_dir() / (name + ".light"));
@@ -138,7 +144,7 @@ bool Light::scan_specular(Lexer& lexer)
 
 PositionalLight::PositionalLight()
     : Light(), /*_bounds(Point3(0.0f, 0.0f, 1.0f)),*/
-        _constant_atten(1.0f), _linear_atten(0.0f), _quadratic_atten(0.0f)
+        _constant_atten(1.0f), _linear_atten(0.0f), _quadratic_atten(0.0f), _radius(FLT_MAX)
 {
 }
 
@@ -182,21 +188,20 @@ std::string PositionalLight::str() const
 
 void PositionalLight::calculate_radius()
 {
-    /*float radius = 1.0f;
-    if(_constant_atten > 0.0f) {
-        radius = MAX(radius, 1.0f / _constant_atten);
-    }
+    // the distance where the brightest component over (c + l*d + q*d^2)
+    // drops below one color step
+    const float cutoff = 256.0f * intensity();
 
-    if(_linear_atten > 0.0f) {
-        radius = MAX(radius, 1.0f / _linear_atten);
+    if(_constant_atten >= cutoff) {
+        _radius = 0.0f;
+    } else if(_quadratic_atten > 0.0f) {
+        const float discriminant = (_linear_atten * _linear_atten) - (4.0f * _quadratic_atten * (_constant_atten - cutoff));
+        _radius = (std::sqrt(discriminant) - _linear_atten) / (2.0f * _quadratic_atten);
+    } else if(_linear_atten > 0.0f) {
+        _radius = (cutoff - _constant_atten) / _linear_atten;
+    } else {
+        _radius = FLT_MAX;
     }
-
-    if(_quadratic_atten > 0.0f) {
-        radius = MAX(radius, invsqrt(_quadratic_atten));
-    }
-
-    _bounds.radius(MAX(radius, 1.0f));*/
-//_bounds.radius(10.0f);
 }
 
 DirectionalLight::DirectionalLight()
@@ -36,10 +36,16 @@ public:
     void ambient_color(const Color& color) { _ambient = color; }
 
     const Color& diffuse_color() const { return _diffuse; }
-    void diffuse_color(const Color& color) { _diffuse = color; }
+    void diffuse_color(const Color& color) { _diffuse = color; on_color_changed(); }
 
     const Color& specular_color() const { return _specular; }
-    void specular_color(const Color& color) { _specular = color; }
+    void specular_color(const Color& color) { _specular = color; on_color_changed(); }
+
+    // the brightest diffuse or specular component
+    float intensity() const;
+
+    // the position with w=1, or the direction towards the light with w=0
+    virtual Vector4 homogeneous_position() const { return position().homogeneous_position(); }
 
 public:
     virtual bool is_transparent() const { return false; }
@@ -57,6 +63,8 @@ private:
 protected:
     Light();
 
+    virtual void on_color_changed() {}
+
 private:
     DISALLOW_COPY_AND_ASSIGN(Light);
 };
@@ -77,13 +85,21 @@ public:
     float quadratic_attenuation() const { return _quadratic_atten; }
     void quadratic_attenuation(float atten);
 
+    // how far the light reaches before the attenuation makes it too dim to see
+    // this is FLT_MAX for a light that never falls off
+    float radius() const { return _radius; }
+
     virtual std::string str() const;
 
+protected:
+    virtual void on_color_changed() { calculate_radius(); }
+
 private:
     void calculate_radius();
 
 private:
     float _constant_atten, _linear_atten, _quadratic_atten;
+    float _radius;
 
 private:
     DISALLOW_COPY_AND_ASSIGN(PositionalLight);
@@ -99,6 +115,8 @@ public:
     Direction direction() const { return position().homogeneous_direction(); }
     void direction(const Direction& direction) { position(direction); }
 
+    virtual Vector4 homogeneous_position() const { return direction(); }
+
     virtual std::string str() const;
 
 private:
@@ -1,10 +1,51 @@
 #include "pch.h"
 #include <iostream>
 #include "common.h"
+#include "CookedFile.h"
 #include "Lexer.h"
 #include "MD5Model.h"
 #include "MD5Animation.h"
 
+namespace
+{
+    // bump COOKED_VERSION whenever the layout or the skeleton building changes
+    const uint32_t COOKED_MAGIC = 0x4135444d;   // "MD5A"
+    const uint32_t COOKED_VERSION = 1;
+
+    struct CookedAnimation
+    {
+        int32_t version;
+        int32_t frame_rate;
+        uint32_t joint_count;
+        uint32_t frame_count;
+    };
+
+    struct CookedJoint
+    {
+        int32_t parent;
+        float position[4];
+        float orientation[4];
+    };
+
+    struct CookedBounds
+    {
+        float minimum[4];
+        float maximum[4];
+    };
+
+    void cook(const Vector& vector, float* const value)
+    {
+        std::memcpy(value, vector.array(), sizeof(float) * 4);
+    }
+
+    void cook(const Quaternion& quaternion, float* const value)
+    {
+        for(int i=0; i<4; ++i) {
+            value[i] = quaternion[i];
+        }
+    }
+}
+
 Logger& MD5Animation::logger(Logger::instance("md5mv.MD5Animation"));
 
 MD5Animation::MD5Animation(const std::string& name)
@@ -18,14 +59,20 @@ MD5Animation::~MD5Animation() throw()
 
 void MD5Animation::build_skeletons()
 {
+    // cooked animations come with their poses already built
+    if(has_poses()) {
+        return;
+    }
+
     LOG_INFO("Building animation skeletons..." << std::endl);
+    allocate_poses();
     for(size_t i=0; i<frame_count(); ++i) {
-        const MD5Frame& md5frame(dynamic_cast<const MD5Frame&>(frame(i)));
+        MD5Frame& md5frame(dynamic_cast<MD5Frame&>(frame(i)));
 
-        boost::shared_ptr<Skeleton> skeleton(new Skeleton());
+        JointPose* const poses(pose(i));
         for(size_t j=0; j<joint_count(); ++j) {
             const AnimationJoint& ajoint(_askeleton[j]);
-            const Skeleton::Joint& bjoint(base_joint(j));
+            const Skeleton::Joint bjoint(base_joint(j));
 
             // start with the base frame
             Position position(bjoint.position);
@@ -61,28 +108,33 @@ void MD5Animation::build_skeletons()
             orientation.compute_scalar();
 
             // joint depends on the parent unless it's a root
-            Skeleton::Joint joint;
+            // (parents always come before their children)
             if(ajoint.parent >= 0) {
-                joint.parent = ajoint.parent;
-
-                const Skeleton::Joint& parent(skeleton->joint(ajoint.parent));
-                joint.position = parent.position + (parent.orientation * position);
-                joint.orientation = parent.orientation * orientation;
-                joint.orientation.normalize();
-            } else {
-                joint.parent = -1;
-                joint.position = position;
-                joint.orientation = orientation;
+                const JointPose& parent(poses[ajoint.parent]);
+                const Position parent_position(parent.position);
+                const Quaternion parent_orientation(parent.orientation);
+
+                position = parent_position + (parent_orientation * position);
+                orientation = parent_orientation * orientation;
+                orientation.normalize();
             }
-            skeleton->add_joint(joint);
+
+            cook(position, poses[j].position);
+            cook(orientation, poses[j].orientation);
         }
-        add_skeleton(skeleton);
+
+        // the components aren't needed once the poses are built
+        md5frame.animated_components.reset();
     }
 }
 
 bool MD5Animation::on_load(const boost::filesystem::path& path)
 {
     boost::filesystem::path filename(model_dir() / path / (name() + extension()));
+    if(load_cooked(filename)) {
+        return true;
+    }
+
     LOG_INFO("Loading animation from '" << filename << "'" << std::endl);
 
     Lexer lexer;
@@ -128,6 +180,12 @@ bool MD5Animation::on_load(const boost::filesystem::path& path)
         return false;
     }
 
+    build_skeletons();
+
+    if(!save_cooked(filename)) {
+        LOG_WARNING("Could not write cooked animation for '" << filename << "'" << std::endl);
+    }
+
     return true;
 }
 
@@ -140,6 +198,107 @@ void MD5Animation::on_unload() throw()
     _account = 0;
 }
 
+bool MD5Animation::load_cooked(const boost::filesystem::path& filename)
+{
+    CookedFile file;
+    if(!file.open(filename, COOKED_MAGIC, COOKED_VERSION)) {
+        return false;
+    }
+
+    LOG_INFO("Loading cooked animation from '" << CookedFile::filename(filename) << "'" << std::endl);
+
+    const CookedAnimation* const animation = file.read<CookedAnimation>();
+    if(NULL == animation || !file.read(_commandline)) {
+        unload();
+        return false;
+    }
+
+    const CookedJoint* const joints = file.read<CookedJoint>(animation->joint_count);
+    const CookedBounds* const bounds = file.read<CookedBounds>(animation->frame_count);
+    if(NULL == joints || NULL == bounds) {
+        unload();
+        return false;
+    }
+
+    const size_t pcount = static_cast<size_t>(animation->frame_count) * animation->joint_count;
+    const JointPose* const poses = file.read<JointPose>(pcount);
+    if(NULL == poses) {
+        unload();
+        return false;
+    }
+
+    // a corrupt parent would be used to index the skeleton
+    for(uint32_t i=0; i<animation->joint_count; ++i) {
+        if(joints[i].parent < -1 || joints[i].parent >= static_cast<int64_t>(animation->joint_count)) {
+            LOG_WARNING("Ignoring corrupt cooked animation '" << CookedFile::filename(filename) << "'" << std::endl);
+            unload();
+            return false;
+        }
+    }
+
+    _version = animation->version;
+    frame_rate(animation->frame_rate);
+
+    for(uint32_t i=0; i<animation->joint_count; ++i) {
+        Skeleton::Joint joint;
+        joint.parent = joints[i].parent;
+        joint.position = Position(joints[i].position);
+        joint.orientation = Quaternion(joints[i].orientation);
+        add_base_joint(joint);
+    }
+
+    for(uint32_t i=0; i<animation->frame_count; ++i) {
+        boost::shared_ptr<Frame> frame(new MD5Frame());
+        frame->bounds = AABB(Point3(bounds[i].minimum), Point3(bounds[i].maximum));
+        add_frame(frame);
+    }
+
+    allocate_poses();
+    if(pcount > 0) {
+        std::memcpy(pose(0), poses, sizeof(JointPose) * pcount);
+    }
+
+    return true;
+}
+
+bool MD5Animation::save_cooked(const boost::filesystem::path& filename) const
+{
+    CookedFileWriter file;
+    if(!file.open(filename, COOKED_MAGIC, COOKED_VERSION)) {
+        return false;
+    }
+
+    CookedAnimation animation;
+    animation.version = _version;
+    animation.frame_rate = static_cast<int32_t>(frame_rate());
+    animation.joint_count = joint_count();
+    animation.frame_count = frame_count();
+    file.write(&animation);
+    file.write(_commandline);
+
+    std::vector<CookedJoint> joints(joint_count());
+    for(size_t i=0; i<joint_count(); ++i) {
+        const Skeleton::Joint joint(base_joint(i));
+        joints[i].parent = joint.parent;
+        cook(joint.position, joints[i].position);
+        cook(joint.orientation, joints[i].orientation);
+    }
+    file.write(joints.data(), joints.size());
+
+    std::vector<CookedBounds> bounds(frame_count());
+    for(size_t i=0; i<frame_count(); ++i) {
+        cook(frame(i).bounds.minimum(), bounds[i].minimum);
+        cook(frame(i).bounds.maximum(), bounds[i].maximum);
+    }
+    file.write(bounds.data(), bounds.size());
+
+    if(frame_count() > 0 && joint_count() > 0) {
+        file.write(pose(0), frame_count() * joint_count());
+    }
+
+    return file.close();
+}
+
 bool MD5Animation::scan_version(Lexer& lexer)
 {
     if(!lexer.match(MD5VERSION)) {
@@ -397,6 +556,7 @@ bool MD5Animation::scan_baseframe(Lexer& lexer, int count)
         }
 
         Skeleton::Joint joint;
+        joint.parent = _askeleton[i].parent;
         joint.position = swizzle(position);
         joint.orientation = Quaternion(swizzle(orientation));
         add_base_joint(joint);
@@ -43,6 +43,10 @@ private:
     virtual void on_unload() throw();
 
 private:
+    // cooked animations hold the built poses so there's nothing to lex or build
+    bool load_cooked(const boost::filesystem::path& filename);
+    bool save_cooked(const boost::filesystem::path& filename) const;
+
     bool scan_version(Lexer& lexer);
     bool scan_commandline(Lexer& lexer);
     int scan_num_frames(Lexer& lexer);
@@ -1,11 +1,126 @@
 #include "pch.h"
 #include <iostream>
 #include "common.h"
+#include "CookedFile.h"
 #include "Lexer.h"
 #include "MD5Model.h"
 
 // NOTE: MD5s are *not* guaranteed to be closed - one-winged edges require the *first* triangle to face the light
 
+namespace
+{
+    // bump COOKED_VERSION whenever the layout or the mesh processing changes
+    const uint32_t COOKED_MAGIC = 0x4d35444d;   // "MD5M"
+    const uint32_t COOKED_VERSION = 2;
+
+    struct CookedModel
+    {
+        int32_t version;
+        uint32_t joint_count;
+        uint32_t mesh_count;
+    };
+
+    struct CookedJoint
+    {
+        int32_t parent;
+        float position[4];
+        float orientation[4];
+    };
+
+    struct CookedMesh
+    {
+        uint32_t vertex_count;
+        uint32_t triangle_count;
+        uint32_t weight_count;
+        uint32_t edge_count;
+        float minimum[4];
+        float maximum[4];
+    };
+
+    struct CookedVertex
+    {
+        int32_t index;
+        float position[4];
+        float normal[4], tangent[4], bitangent[4];
+        float texture_coords[4];
+        int32_t weight_start, weight_count;
+    };
+
+    struct CookedTriangle
+    {
+        int32_t index;
+        int32_t v1, v2, v3;
+        float normal[4];
+    };
+
+    struct CookedWeight
+    {
+        int32_t index;
+        int32_t joint;
+        float weight;
+        float position[4];
+        float normal[4], tangent[4], bitangent[4];
+    };
+
+    struct CookedEdge
+    {
+        int32_t v1, v2;
+        int32_t t1, t2;
+    };
+
+    void cook(const Vector& vector, float* const value)
+    {
+        std::memcpy(value, vector.array(), sizeof(float) * 4);
+    }
+
+    inline bool in_range(int32_t value, uint32_t count)
+    {
+        return value >= 0 && static_cast<uint32_t>(value) < count;
+    }
+
+    // the cache is trusted for its values but not its indices,
+    // a corrupt index would be used to read out of bounds
+    bool valid_mesh(const CookedMesh& mesh, const CookedVertex* const vertices, const CookedTriangle* const triangles,
+        const CookedWeight* const weights, const CookedEdge* const edges, uint32_t joint_count)
+    {
+        for(uint32_t i=0; i<mesh.vertex_count; ++i) {
+            const CookedVertex& vertex(vertices[i]);
+            if(vertex.weight_start < 0 || vertex.weight_count < 0
+                || static_cast<int64_t>(vertex.weight_start) + vertex.weight_count > mesh.weight_count)
+            {
+                return false;
+            }
+        }
+
+        for(uint32_t i=0; i<mesh.triangle_count; ++i) {
+            const CookedTriangle& triangle(triangles[i]);
+            if(!in_range(triangle.v1, mesh.vertex_count) || !in_range(triangle.v2, mesh.vertex_count)
+                || !in_range(triangle.v3, mesh.vertex_count))
+            {
+                return false;
+            }
+        }
+
+        for(uint32_t i=0; i<mesh.weight_count; ++i) {
+            if(!in_range(weights[i].joint, joint_count)) {
+                return false;
+            }
+        }
+
+        // one-winged edges have no second triangle
+        for(uint32_t i=0; i<mesh.edge_count; ++i) {
+            const CookedEdge& edge(edges[i]);
+            if(!in_range(edge.v1, mesh.vertex_count) || !in_range(edge.v2, mesh.vertex_count)
+                || !in_range(edge.t1, mesh.triangle_count) || (edge.t2 != -1 && !in_range(edge.t2, mesh.triangle_count)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
 MD5Mesh::MD5Mesh(const std::string& shader, size_t vcount, boost::shared_array<Vertex> vertices, size_t tcount, boost::shared_array<Triangle> triangles, size_t wcount, boost::shared_array<Weight> weights)
     : Mesh(vcount, vertices, tcount, triangles, wcount, weights),
         _shader_name(shader)
@@ -30,6 +145,10 @@ MD5Model::~MD5Model() throw()
 bool MD5Model::on_load(const boost::filesystem::path& path)
 {
     boost::filesystem::path filename(model_dir() / path / (name() + extension()));
+    if(load_cooked(filename)) {
+        return true;
+    }
+
     LOG_INFO("Loading model from '" << filename << "'" << std::endl);
 
     Lexer lexer;
@@ -59,6 +178,10 @@ bool MD5Model::on_load(const boost::filesystem::path& path)
         return false;
     }
 
+    if(!save_cooked(filename)) {
+        LOG_WARNING("Could not write cooked model for '" << filename << "'" << std::endl);
+    }
+
     return true;
 }
 
@@ -68,6 +191,218 @@ void MD5Model::on_unload() throw()
     _commandline.erase();
 }
 
+bool MD5Model::load_cooked(const boost::filesystem::path& filename)
+{
+    CookedFile file;
+    if(!file.open(filename, COOKED_MAGIC, COOKED_VERSION)) {
+        return false;
+    }
+
+    LOG_INFO("Loading cooked model from '" << CookedFile::filename(filename) << "'" << std::endl);
+
+    const CookedModel* const model = file.read<CookedModel>();
+    if(NULL == model || !file.read(_commandline)) {
+        unload();
+        return false;
+    }
+    _version = model->version;
+
+    for(uint32_t i=0; i<model->joint_count; ++i) {
+        Skeleton::Joint joint;
+        if(!file.read(joint.name)) {
+            unload();
+            return false;
+        }
+
+        const CookedJoint* const cj = file.read<CookedJoint>();
+        if(NULL == cj || (cj->parent != -1 && !in_range(cj->parent, model->joint_count))) {
+            unload();
+            return false;
+        }
+
+        // the scalar is recomputed the same way scan_joint() does it
+        joint.parent = cj->parent;
+        joint.position = Position(cj->position);
+        joint.orientation = Quaternion(Vector3(cj->orientation));
+        skeleton().add_joint(joint);
+    }
+
+    for(uint32_t i=0; i<model->mesh_count; ++i) {
+        std::string shader;
+        if(!file.read(shader)) {
+            unload();
+            return false;
+        }
+
+        const CookedMesh* const cm = file.read<CookedMesh>();
+        if(NULL == cm) {
+            unload();
+            return false;
+        }
+
+        const CookedVertex* const cv = file.read<CookedVertex>(cm->vertex_count);
+        const CookedTriangle* const ct = file.read<CookedTriangle>(cm->triangle_count);
+        const CookedWeight* const cw = file.read<CookedWeight>(cm->weight_count);
+        const CookedEdge* const ce = file.read<CookedEdge>(cm->edge_count);
+        if(NULL == cv || NULL == ct || NULL == cw || NULL == ce) {
+            unload();
+            return false;
+        }
+
+        if(!valid_mesh(*cm, cv, ct, cw, ce, model->joint_count)) {
+            LOG_WARNING("Ignoring corrupt cooked model '" << CookedFile::filename(filename) << "'" << std::endl);
+            unload();
+            return false;
+        }
+
+        // these are straight copies, the only thing
+        // the records can't do is carry the vtables
+        boost::shared_array<Vertex> vertices(new Vertex[cm->vertex_count]);
+        for(uint32_t j=0; j<cm->vertex_count; ++j) {
+            Vertex& vertex(vertices[j]);
+            vertex.index = cv[j].index;
+            vertex.position = Position(cv[j].position);
+            vertex.normal = Vector3(cv[j].normal);
+            vertex.tangent = Vector3(cv[j].tangent);
+            vertex.bitangent = Vector3(cv[j].bitangent);
+            vertex.texture_coords = Vector2(cv[j].texture_coords);
+            vertex.weight_start = cv[j].weight_start;
+            vertex.weight_count = cv[j].weight_count;
+        }
+
+        boost::shared_array<Triangle> triangles(new Triangle[cm->triangle_count]);
+        for(uint32_t j=0; j<cm->triangle_count; ++j) {
+            Triangle& triangle(triangles[j]);
+            triangle.index = ct[j].index;
+            triangle.v1 = ct[j].v1;
+            triangle.v2 = ct[j].v2;
+            triangle.v3 = ct[j].v3;
+            triangle.normal = Vector3(ct[j].normal);
+        }
+
+        boost::shared_array<Weight> weights(new Weight[cm->weight_count]);
+        for(uint32_t j=0; j<cm->weight_count; ++j) {
+            Weight& weight(weights[j]);
+            weight.index = cw[j].index;
+            weight.joint = cw[j].joint;
+            weight.weight = cw[j].weight;
+            weight.position = Position(cw[j].position);
+            weight.normal = Vector3(cw[j].normal);
+            weight.tangent = Vector3(cw[j].tangent);
+            weight.bitangent = Vector3(cw[j].bitangent);
+        }
+
+        std::vector<Edge> edges(cm->edge_count);
+        for(uint32_t j=0; j<cm->edge_count; ++j) {
+            Edge& edge(edges[j]);
+            edge.v1 = ce[j].v1;
+            edge.v2 = ce[j].v2;
+            edge.t1 = ce[j].t1;
+            edge.t2 = ce[j].t2;
+        }
+
+        boost::shared_ptr<Mesh> mesh(new MD5Mesh(shader, cm->vertex_count, vertices, cm->triangle_count, triangles, cm->weight_count, weights));
+        mesh->restore(edges, AABB(Point3(cm->minimum), Point3(cm->maximum)));
+        add_processed_mesh(mesh);
+    }
+
+    return true;
+}
+
+bool MD5Model::save_cooked(const boost::filesystem::path& filename) const
+{
+    CookedFileWriter file;
+    if(!file.open(filename, COOKED_MAGIC, COOKED_VERSION)) {
+        return false;
+    }
+
+    CookedModel model;
+    model.version = _version;
+    model.joint_count = joint_count();
+    model.mesh_count = mesh_count();
+    file.write(&model);
+    file.write(_commandline);
+
+    for(size_t i=0; i<joint_count(); ++i) {
+        const Skeleton::Joint joint(this->joint(i));
+        file.write(joint.name);
+
+        CookedJoint cj;
+        cj.parent = joint.parent;
+        cook(joint.position, cj.position);
+        cook(joint.orientation.vector(), cj.orientation);
+        file.write(&cj);
+    }
+
+    for(size_t i=0; i<mesh_count(); ++i) {
+        const MD5Mesh& mesh(dynamic_cast<const MD5Mesh&>(this->mesh(i)));
+        file.write(mesh.shader_name());
+
+        CookedMesh cm;
+        cm.vertex_count = mesh.vertex_count();
+        cm.triangle_count = mesh.triangle_count();
+        cm.weight_count = mesh.weight_count();
+        cm.edge_count = mesh.edge_count();
+        cook(mesh.bounds().minimum(), cm.minimum);
+        cook(mesh.bounds().maximum(), cm.maximum);
+        file.write(&cm);
+
+        std::vector<CookedVertex> vertices(cm.vertex_count);
+        for(uint32_t j=0; j<cm.vertex_count; ++j) {
+            const Vertex& vertex(mesh.vertex(j));
+            CookedVertex& cv(vertices[j]);
+            cv.index = vertex.index;
+            cook(vertex.position, cv.position);
+            cook(vertex.normal, cv.normal);
+            cook(vertex.tangent, cv.tangent);
+            cook(vertex.bitangent, cv.bitangent);
+            cook(vertex.texture_coords, cv.texture_coords);
+            cv.weight_start = vertex.weight_start;
+            cv.weight_count = vertex.weight_count;
+        }
+        file.write(vertices.data(), vertices.size());
+
+        std::vector<CookedTriangle> triangles(cm.triangle_count);
+        for(uint32_t j=0; j<cm.triangle_count; ++j) {
+            const Triangle& triangle(mesh.triangle(j));
+            CookedTriangle& ct(triangles[j]);
+            ct.index = triangle.index;
+            ct.v1 = triangle.v1;
+            ct.v2 = triangle.v2;
+            ct.v3 = triangle.v3;
+            cook(triangle.normal, ct.normal);
+        }
+        file.write(triangles.data(), triangles.size());
+
+        std::vector<CookedWeight> weights(cm.weight_count);
+        for(uint32_t j=0; j<cm.weight_count; ++j) {
+            const Weight& weight(mesh.weight(j));
+            CookedWeight& cw(weights[j]);
+            cw.index = weight.index;
+            cw.joint = weight.joint;
+            cw.weight = weight.weight;
+            cook(weight.position, cw.position);
+            cook(weight.normal, cw.normal);
+            cook(weight.tangent, cw.tangent);
+            cook(weight.bitangent, cw.bitangent);
+        }
+        file.write(weights.data(), weights.size());
+
+        std::vector<CookedEdge> edges(cm.edge_count);
+        for(uint32_t j=0; j<cm.edge_count; ++j) {
+            const Edge& edge(mesh.edge(j));
+            CookedEdge& ce(edges[j]);
+            ce.v1 = edge.v1;
+            ce.v2 = edge.v2;
+            ce.t1 = edge.t1;
+            ce.t2 = edge.t2;
+        }
+        file.write(edges.data(), edges.size());
+    }
+
+    return file.close();
+}
+
 bool MD5Model::scan_version(Lexer& lexer)
 {
     if(!lexer.match(MD5VERSION)) {
@@ -44,6 +44,10 @@ private:
     void on_unload() throw();
 
 private:
+    // cooked models skip lexing and all of the mesh processing
+    bool load_cooked(const boost::filesystem::path& filename);
+    bool save_cooked(const boost::filesystem::path& filename) const;
+
     bool scan_version(Lexer& lexer);
     bool scan_commandline(Lexer& lexer);
     int scan_num_joints(Lexer& lexer);
@@ -9,6 +9,9 @@ class Shader;
 class Light;
 typedef std::vector<boost::shared_ptr<Light> > Lights;
 
+// a bit for each of the lights, however many there are
+typedef boost::dynamic_bitset<> LightMask;
+
 class Map
 {
 public:
@@ -41,6 +44,17 @@ public:
     virtual void render(const Camera& camera, Shader& shader, const Light& light) const = 0;
     virtual void render_normals(const Camera& camera) const = 0;
 
+    // the origin of the map's own light called name
+    virtual bool light_origin(const std::string& name, Position& origin) const = 0;
+
+    // ties light to whatever the map precomputed for its light called name
+    // that's used until the light moves
+    virtual void link_light(const std::string& name, const Light& light) = 0;
+
+    // fills the stencil with the map's own shadow volume for the light
+    // returns false if the light isn't linked to one or has moved since
+    virtual bool render_shadow(Shader& shader, const Light& light) const = 0;
+
 private:
     std::string _name;
 
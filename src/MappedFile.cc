@@ -0,0 +1,142 @@
+#include "pch.h"
+#if !defined WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+#endif
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+    : _data(NULL), _size(0), _mapsize(0)
+#if defined WIN32
+        , _view(false)
+#endif
+{
+}
+
+MappedFile::~MappedFile() throw()
+{
+    close();
+}
+
+bool MappedFile::open(const boost::filesystem::path& path)
+{
+    close();
+
+#if defined WIN32
+    HANDLE file = CreateFileA(path.string().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(INVALID_HANDLE_VALUE == file) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(file_size.QuadPart);
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    // the part of the last page of a view past the end of the file is zeroed,
+    // so the file can be mapped directly unless it ends exactly on a page
+    // (then there's nowhere to put the sentinel and the file is read instead)
+    if(0 != size % info.dwPageSize) {
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if(NULL == mapping) {
+            return false;
+        }
+
+        // the view keeps the mapping alive
+        const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if(NULL == data) {
+            return false;
+        }
+
+        _data = reinterpret_cast<const char*>(data);
+        _size = size;
+        _mapsize = ((size / info.dwPageSize) + 1) * info.dwPageSize;
+        _view = true;
+        return true;
+    }
+
+    char* data = new char[size + 1];
+    DWORD read = 0;
+    if(size > 0 && (!ReadFile(file, data, static_cast<DWORD>(size), &read, NULL) || read != size)) {
+        delete[] data;
+        CloseHandle(file);
+        return false;
+    }
+    CloseHandle(file);
+    data[size] = '\0';
+
+    _data = data;
+    _size = size;
+    _mapsize = size + 1;
+    _view = false;
+#else
+    const int fd = ::open(path.string().c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    const size_t size = st.st_size;
+    const size_t page = sysconf(_SC_PAGESIZE);
+
+    // reserve the file plus at least one trailing page of zeros
+    // (the part of the last file page past the end is zeroed by the kernel
+    // and the extra anonymous page covers files that are a multiple of the page size)
+    const size_t mapsize = ((size / page) + 1) * page;
+    void* base = mmap(NULL, mapsize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == base) {
+        ::close(fd);
+        return false;
+    }
+
+    if(size > 0) {
+        void* data = mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if(MAP_FAILED == data) {
+            munmap(base, mapsize);
+            ::close(fd);
+            return false;
+        }
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    _data = reinterpret_cast<const char*>(base);
+    _size = size;
+    _mapsize = mapsize;
+#endif
+
+    return true;
+}
+
+void MappedFile::close() throw()
+{
+    if(NULL == _data) {
+        return;
+    }
+
+#if defined WIN32
+    if(_view) {
+        UnmapViewOfFile(_data);
+    } else {
+        delete[] _data;
+    }
+#else
+    munmap(const_cast<char*>(_data), _mapsize);
+#endif
+
+    _data = NULL;
+    _size = 0;
+    _mapsize = 0;
+}
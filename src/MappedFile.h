@@ -0,0 +1,38 @@
+#if !defined __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+// read-only view of an entire file
+// the view is always followed by at least one '\0' byte
+// so that it can be scanned without checking the length
+class MappedFile
+{
+public:
+    MappedFile();
+    virtual ~MappedFile() throw();
+
+public:
+    bool open(const boost::filesystem::path& path);
+    void close() throw();
+
+    bool is_open() const { return NULL != _data; }
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    const char* _data;
+    size_t _size;
+
+    // size of the whole mapping (file + sentinel)
+    size_t _mapsize;
+
+#if defined WIN32
+    // false if the file was read into memory rather than mapped
+    bool _view;
+#endif
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+#endif
@@ -1,9 +1,65 @@
 #include "pch.h"
 #include "common.h"
+#include "MeshSimplifier.h"
 #include "Model.h"
 #include "Renderable.h"
 #include "Mesh.h"
 
+namespace
+{
+    // vertices closer than this (squared) in position and texture coordinates are welded
+    const float WELD_EPSILON = 0.001f;
+
+    // this must be larger than the welding distance
+    // so that only neighboring cells need to be searched
+    const float WELD_CELL_SIZE = 0.04f;
+
+    // the first simplified level can move the surface by this much of the mesh's radius
+    const float LOD_ERROR = 0.03f;
+
+    int weld_cell_coord(float value)
+    {
+        return static_cast<int>(std::floor(value / WELD_CELL_SIZE));
+    }
+
+    // NOTE: cells wrap at 21 bits per axis, which just means some cells are shared
+    uint64_t weld_cell(int x, int y, int z)
+    {
+        return ((static_cast<uint64_t>(x) & 0x1fffff) << 42)
+            | ((static_cast<uint64_t>(y) & 0x1fffff) << 21)
+            | (static_cast<uint64_t>(z) & 0x1fffff);
+    }
+
+    uint64_t weld_cell(const Position& position)
+    {
+        return weld_cell(weld_cell_coord(position.x()), weld_cell_coord(position.y()), weld_cell_coord(position.z()));
+    }
+
+    uint64_t edge_key(int v1, int v2)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(v1)) << 32) | static_cast<uint32_t>(v2);
+    }
+
+    // the corner of the triangle that isn't on the edge
+    int opposite_corner(const Triangle& triangle, const Edge& edge)
+    {
+        if(triangle.v1 != edge.v1 && triangle.v1 != edge.v2) {
+            return 0;
+        }
+
+        if(triangle.v2 != edge.v1 && triangle.v2 != edge.v2) {
+            return 1;
+        }
+        return 2;
+    }
+
+    // the adjacency index for the edge opposite the corner
+    int adjacent_slot(int corner)
+    {
+        return (((corner + 1) % 3) * 2) + 1;
+    }
+}
+
 Logger& Mesh::logger(Logger::instance("md5mv.Mesh"));
 
 Mesh::Mesh(int vcount, boost::shared_array<Vertex> vertices, int tcount, boost::shared_array<Triangle> triangles, int wcount, boost::shared_array<Weight> weights)
@@ -55,11 +111,11 @@ void Mesh::pose(const Skeleton& skeleton)
         if(has_weights()) {
             for(int j=0; j<vertex.weight_count; ++j) {
                 const Weight& weight(_weights[vertex.weight_start + j]);
-                const Skeleton::Joint& joint(skeleton.joint(weight.joint));
+                const Quaternion orientation(skeleton.orientation(weight.joint));
 
                 // convert the joint to object space and weight the vertex
-                const Position wpos(joint.orientation * weight.position);
-                position += ((wpos + joint.position) * weight.weight);
+                const Position wpos(orientation * weight.position);
+                position += ((wpos + skeleton.position(weight.joint)) * weight.weight);
             }
             vertex.position = position;
         } else {
@@ -83,10 +139,8 @@ void Mesh::compute_normals(const Skeleton& skeleton, bool smooth)
             // put the normals and tangents into joint space
             for(int j=0; j<vertex.weight_count; ++j) {
                 Weight& weight(_weights[vertex.weight_start + j]);
-                const Skeleton::Joint& joint(skeleton.joint(weight.joint));
-
                 // convert to joint-space and store
-                Quaternion inv(joint.orientation.inverse());
+                Quaternion inv(skeleton.orientation(weight.joint).inverse());
                 weight.normal += inv * vertex.normal;
                 weight.tangent += inv * vertex.tangent;
                 weight.bitangent += inv * vertex.bitangent;
@@ -105,40 +159,152 @@ void Mesh::compute_normals(const Skeleton& skeleton, bool smooth)
 
 void Mesh::weld_vertices()
 {
+    // bucket the vertices by position so that only
+    // the vertices in neighboring cells need to be compared
+    // (each cell is a list of vertices threaded through next)
+    boost::unordered_map<uint64_t, int> cells;
+    std::vector<int> next(_vcount, -1);
+    for(int i=0; i<_vcount; ++i) {
+        int& head(cells.insert(std::make_pair(weld_cell(_vertices[i].position), -1)).first->second);
+        next[i] = head;
+        head = i;
+    }
+
     // find the vertices that need to be welded
-    boost::unordered_map<int, int> vertices;
+    // (each vertex is welded to the highest matching vertex after it)
+    std::vector<int> vertices(_vcount, -1);
+    size_t count = 0;
     for(int i=0; i<_vcount; ++i) {
-        for(int j=i+1; j<_vcount; ++j) {
-            const Vertex &v1(_vertices[i]), &v2(_vertices[j]);
-            if(v1.position.distance_squared(v2.position) < 0.001f
-                && v1.texture_coords.distance_squared(v2.texture_coords) < 0.001f)
-            {
-                vertices[v1.index] = v2.index;
+        const Vertex& v1(_vertices[i]);
+        const int x = weld_cell_coord(v1.position.x()), y = weld_cell_coord(v1.position.y()), z = weld_cell_coord(v1.position.z());
+
+        int weld = -1;
+        for(int dx=-1; dx<=1; ++dx) {
+            for(int dy=-1; dy<=1; ++dy) {
+                for(int dz=-1; dz<=1; ++dz) {
+                    boost::unordered_map<uint64_t, int>::const_iterator it(cells.find(weld_cell(x + dx, y + dy, z + dz)));
+                    if(cells.end() == it) {
+                        continue;
+                    }
+
+                    for(int j=it->second; j>=0; j=next[j]) {
+                        const Vertex& v2(_vertices[j]);
+                        if(j > i && j > weld
+                            && v1.position.distance_squared(v2.position) < WELD_EPSILON
+                            && v1.texture_coords.distance_squared(v2.texture_coords) < WELD_EPSILON)
+                        {
+                            weld = j;
+                        }
+                    }
+                }
             }
         }
+
+        if(weld >= 0) {
+            vertices[i] = weld;
+            count++;
+        }
     }
 
     // weld them
-    weld_vertices(vertices);
+    weld_vertices(vertices, count);
 }
 
 void Mesh::compute_edges()
 {
-    // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.3
-    for(int i=0; i<_tcount; ++i) {
-        calculate_edge(_triangles[i], i);
+    compute_edges(_triangles.get(), _tcount, _edges);
+}
+
+void Mesh::restore(std::vector<Edge>& edges, const AABB& bounds)
+{
+    _edges.swap(edges);
+    _bounds = bounds;
+}
+
+void Mesh::generate_lods(size_t count, float reduction)
+{
+    _lods.clear();
+    if(count < 2) {
+        return;
+    }
+
+    MeshSimplifier simplifier(_vertices.get(), _vcount, _triangles.get(), _tcount, has_weights() ? _weights.get() : NULL);
+
+    // each level is picked at about half the screen size of the one before it
+    // so it can be off by about twice as much
+    float target = static_cast<float>(_tcount), max_error = _bounds.radius() * LOD_ERROR;
+    for(size_t i=1; i<count; ++i, max_error *= 2.0f) {
+        target *= reduction;
+
+        // NOTE: this keeps the level even if nothing else could be collapsed
+        // so that every mesh in the model has the same number of them
+        simplifier.simplify(static_cast<size_t>(target), max_error);
+
+        Lod lod;
+        lod.tcount = simplifier.copy_triangles(lod.triangles);
+        compute_edges(lod.triangles.get(), lod.tcount, lod.edges);
+        _lods.push_back(lod);
+
+        LOG_INFO("LOD " << i << ": " << lod.tcount << " of " << _tcount << " triangles, "
+            << lod.edges.size() << " edges" << std::endl);
+    }
+}
+
+void Mesh::prepare_skinning(const Skeleton& skeleton)
+{
+    if(has_weights()) {
+        _skinning.build(skeleton, _vertices.get(), _vcount, _weights.get());
     }
-    find_matching_edges();
 }
 
-void Mesh::calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart, RenderableBuffers& buffers, size_t tstart) const
+void Mesh::calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart, RenderableBuffers& buffers, size_t tstart, Skinning::Kernel kernel, size_t lod) const
+{
+    position_vertices(skeleton, vertices, vstart, kernel);
+    copy_triangles(lod, vertices, vstart, buffers, tstart);
+}
+
+void Mesh::copy_triangles(size_t lod, boost::shared_array<Vertex> vertices, size_t vstart, RenderableBuffers& buffers, size_t tstart) const
+{
+    // the normal lines are per vertex so they're only copied with the full mesh
+    // (the simplified levels would overrun each other's, see Model::calculate_vertices())
+    const Triangle* const triangles = 0 == lod ? _triangles.get() : _lods[lod - 1].triangles.get();
+    buffers.copy_triangles(triangles, triangle_count(lod), vertices.get() + vstart, 0 == lod ? _vcount : 0, tstart * 3);
+}
+
+void Mesh::copy_adjacency(size_t lod, uint32_t* const indices, size_t tstart) const
 {
-    position_vertices(skeleton, vertices, vstart);
-    buffers.copy_triangles(_triangles.get(), _tcount, vertices.get() + vstart, _vcount, tstart * 3);
+    // open edges get the triangle's own opposite corner
+    // so the triangle across them is the same one facing the other way
+    for(int i=0; i<triangle_count(lod); ++i) {
+        const uint32_t v = static_cast<uint32_t>((tstart + i) * 3);
+        uint32_t* const t = indices + (i * 6);
+
+        t[0] = v;       t[1] = v + 2;
+        t[2] = v + 1;   t[3] = v;
+        t[4] = v + 2;   t[5] = v + 1;
+    }
+
+    for(size_t i=0; i<edge_count(lod); ++i) {
+        const Edge& e(edge(lod, i));
+        if(e.t2 < 0) {
+            continue;
+        }
+
+        const int c1 = opposite_corner(triangle(lod, e.t1), e);
+        const int c2 = opposite_corner(triangle(lod, e.t2), e);
+        *(indices + (e.t1 * 6) + adjacent_slot(c1)) = static_cast<uint32_t>(((tstart + e.t2) * 3) + c2);
+        *(indices + (e.t2 * 6) + adjacent_slot(c2)) = static_cast<uint32_t>(((tstart + e.t1) * 3) + c1);
+    }
 }
 
-void Mesh::position_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart) const
+void Mesh::position_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart, Skinning::Kernel kernel) const
 {
+    if(_skinning.supports(kernel)) {
+        _skinning.skin(kernel, skeleton, _vertices.get(), vertices.get() + vstart);
+        return;
+    }
+
+    // NOTE: this is the reference for the Skinning kernels
     for(int i=0; i<_vcount; ++i) {
         const Vertex& meshvertex(_vertices[i]);
 
@@ -147,14 +313,14 @@ void Mesh::position_vertices(const Skeleton& skeleton, boost::shared_array<Verte
         if(has_weights()) {
             for(int j=0; j<meshvertex.weight_count; ++j) {
                 const Weight& weight(_weights[meshvertex.weight_start + j]);
-                const Skeleton::Joint& joint(skeleton.joint(weight.joint));
+                const Quaternion orientation(skeleton.orientation(weight.joint));
 
                 // convert the joint to object space and weight the vertex attributes
-                const Position wpos(joint.orientation * weight.position);
-                position += ((wpos + joint.position) * weight.weight);
-                normal += (joint.orientation * weight.normal);
-                tangent += (joint.orientation * weight.tangent);
-                bitangent += (joint.orientation * weight.bitangent);
+                const Position wpos(orientation * weight.position);
+                position += ((wpos + skeleton.position(weight.joint)) * weight.weight);
+                normal += (orientation * weight.normal);
+                tangent += (orientation * weight.tangent);
+                bitangent += (orientation * weight.bitangent);
             }
         } else {
             position = meshvertex.position;
@@ -173,114 +339,147 @@ void Mesh::position_vertices(const Skeleton& skeleton, boost::shared_array<Verte
     }
 }
 
-void Mesh::weld_vertices(const boost::unordered_map<int, int>& vertices)
+void Mesh::weld_vertices(const std::vector<int>& vertices, size_t count)
 {
-    if(0 == vertices.size()) {
+    if(0 == count) {
         return;
     }
 
-    LOG_INFO("Welding " << vertices.size() << " vertices" << std::endl);
+    LOG_INFO("Welding " << count << " vertices" << std::endl);
 
-    const size_t vcount = _vcount - vertices.size();
+    const size_t vcount = _vcount - count;
     boost::shared_array<Vertex> v(new Vertex[vcount]);
 
+    // copy the vertices that are kept and update their index
+    std::vector<int> remap(_vcount);
     size_t j=0;
     for(int i=0; i<_vcount; ++i) {
-        const Vertex& vertex(_vertices[i]);
-        if(vertices.end() == vertices.find(vertex.index)) {
-            // copy the vertex and update it's index
+        if(vertices[i] < 0) {
             Vertex& new_vertex(v[j]);
-            new_vertex = vertex;
+            new_vertex = _vertices[i];
             new_vertex.index = j;
-            fix_triangles(vertex.index, new_vertex.index);
+            remap[i] = j;
             j++;
-        } else {
-            // point triangles at the new vertex
-            fix_triangles(i, vertices.at(i));
         }
     }
 
+    // welded vertices always point forward, so walking
+    // backwards resolves chains of welded vertices
+    for(int i=_vcount-1; i>=0; --i) {
+        if(vertices[i] >= 0) {
+            remap[i] = remap[vertices[i]];
+        }
+    }
+
+    fix_triangles(remap);
+
     _vcount = vcount;
     _vertices = v;
 }
 
-void Mesh::fix_triangles(int old_index, int new_index)
+void Mesh::fix_triangles(const std::vector<int>& remap)
 {
     for(int i=0; i<_tcount; ++i) {
         Triangle& triangle(_triangles[i]);
-        if(triangle.v1 == old_index) {
-            triangle.v1 = new_index;
-        } else if(triangle.v2 == old_index) {
-            triangle.v2 = new_index;
-        } else if(triangle.v3 == old_index) {
-            triangle.v3 = new_index;
-        }
+        triangle.v1 = remap[triangle.v1];
+        triangle.v2 = remap[triangle.v2];
+        triangle.v3 = remap[triangle.v3];
+    }
+}
+
+void Mesh::compute_edges(const Triangle* const triangles, int tcount, std::vector<Edge>& edges) const
+{
+    // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.3
+    EdgeMap map(edges);
+    map.map.rehash(tcount * 3 / 2);
+    edges.reserve(tcount * 3 / 2);
+    map.next.reserve(tcount * 3 / 2);
+
+    for(int i=0; i<tcount; ++i) {
+        calculate_edge(triangles[i], i, map);
     }
+    find_matching_edges(triangles, tcount, map);
 }
 
-void Mesh::calculate_edge(const Triangle& triangle, int t)
+void Mesh::calculate_edge(const Triangle& triangle, int t, EdgeMap& edges) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.3
     if(triangle.v1 < triangle.v2) {
-        Edge edge;
-        edge.v1 = triangle.v1;
-        edge.v2 = triangle.v2;
-        edge.t1 = t;
-        _edges.push_back(edge);
+        add_edge(triangle.v1, triangle.v2, t, edges);
     }
 
     if(triangle.v2 < triangle.v3) {
-        Edge edge;
-        edge.v1 = triangle.v2;
-        edge.v2 = triangle.v3;
-        edge.t1 = t;
-        _edges.push_back(edge);
+        add_edge(triangle.v2, triangle.v3, t, edges);
     }
 
     if(triangle.v3 < triangle.v1) {
-        Edge edge;
-        edge.v1 = triangle.v3;
-        edge.v2 = triangle.v1;
-        edge.t1 = t;
-        _edges.push_back(edge);
+        add_edge(triangle.v3, triangle.v1, t, edges);
     }
 }
 
-void Mesh::find_matching_edges()
+void Mesh::find_matching_edges(const Triangle* const triangles, int tcount, EdgeMap& edges) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.3
-    for(int i=0; i<_tcount; ++i) {
-        const Triangle& triangle(_triangles[i]);
+    for(int i=0; i<tcount; ++i) {
+        const Triangle& triangle(triangles[i]);
 
         if(triangle.v1 > triangle.v2) {
-            find_matching_edge(triangle.v2, triangle.v1, i);
+            find_matching_edge(triangle.v2, triangle.v1, i, edges);
         }
 
         if(triangle.v2 > triangle.v3) {
-            find_matching_edge(triangle.v3, triangle.v2, i);
+            find_matching_edge(triangle.v3, triangle.v2, i, edges);
         }
 
         if(triangle.v3 > triangle.v1) {
-            find_matching_edge(triangle.v1, triangle.v3, i);
+            find_matching_edge(triangle.v1, triangle.v3, i, edges);
         }
     }
 }
 
-void Mesh::find_matching_edge(int v1, int v2, int t)
+void Mesh::find_matching_edge(int v1, int v2, int t, EdgeMap& edges) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.3
-    BOOST_FOREACH(Edge& edge, _edges) {
-        if(edge.v1 == v1 && edge.v2 == v2 && edge.t2 < 0) {
-            edge.t2 = t;
-            return;
+    // the first unmatched edge is the head of the list
+    boost::unordered_map<uint64_t, EdgeList>::iterator it(edges.map.find(edge_key(v1, v2)));
+    if(edges.map.end() != it && it->second.first >= 0) {
+        EdgeList& list(it->second);
+        const int e = list.first;
+
+        edges.edges[e].t2 = t;
+        list.first = edges.next[e];
+        if(list.first < 0) {
+            list.last = -1;
         }
+        return;
     }
 
     // didn't find a match, so this is a one-winged edge
-    // TODO: not sure if I'm setting the v1/v2 properties correctly
+    // this pass walks the triangle's corners backwards, so flip
+    // them back to follow its winding like the first pass's edges
+    // NOTE: that keys it (larger, smaller), which nothing looks up, so a later
+    // triangle wound the same way along the edge gets its own one-winged edge
+    // rather than pairing with this one
+    add_edge(v2, v1, t, edges);
+}
+
+void Mesh::add_edge(int v1, int v2, int t, EdgeMap& edges) const
+{
     Edge edge;
     edge.v1 = v1;
     edge.v2 = v2;
     edge.t1 = t;
-    _edges.push_back(edge);
+    edges.edges.push_back(edge);
+
+    // append the edge to the unmatched edges between v1 and v2
+    const int e = edges.edges.size() - 1;
+    edges.next.push_back(-1);
+
+    EdgeList& list(edges.map.insert(std::make_pair(edge_key(v1, v2), EdgeList())).first->second);
+    if(list.last >= 0) {
+        edges.next[list.last] = e;
+    } else {
+        list.first = e;
+    }
+    list.last = e;
 }
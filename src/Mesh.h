@@ -3,6 +3,7 @@
 
 #include "AABB.h"
 #include "Geometry.h"
+#include "Skinning.h"
 #include "TextureManager.h"
 
 class RenderableBuffers;
@@ -10,6 +11,35 @@ class Skeleton;
 
 class Mesh
 {
+private:
+    // unmatched edges between a pair of vertices,
+    // in the order they were added (threaded through EdgeMap::next)
+    struct EdgeList
+    {
+        int first, last;
+
+        EdgeList() : first(-1), last(-1) {}
+    };
+
+    struct EdgeMap
+    {
+        explicit EdgeMap(std::vector<Edge>& edges) : edges(edges) {}
+
+        boost::unordered_map<uint64_t, EdgeList> map;
+        std::vector<int> next;
+
+        // the edges being built
+        std::vector<Edge>& edges;
+    };
+
+    // a simplified level, made from the same vertices as the full mesh
+    struct Lod
+    {
+        int tcount;
+        boost::shared_array<Triangle> triangles;
+        std::vector<Edge> edges;
+    };
+
 private:
     static Logger& logger;
 
@@ -25,10 +55,19 @@ public:
     const Triangle& triangle(size_t idx) const { return _triangles[idx]; }
 
     bool has_weights() const { return static_cast<bool>(_weights); }
+    int weight_count() const { return _wcount; }
+    const Weight& weight(size_t idx) const { return _weights[idx]; }
 
     size_t edge_count() const { return _edges.size(); }
     const Edge& edge(size_t idx) const { return _edges[idx]; }
 
+    // level 0 is the full mesh, the rest are from generate_lods()
+    size_t lod_count() const { return _lods.size() + 1; }
+    int triangle_count(size_t lod) const { return 0 == lod ? _tcount : _lods[lod - 1].tcount; }
+    const Triangle& triangle(size_t lod, size_t idx) const { return 0 == lod ? _triangles[idx] : _lods[lod - 1].triangles[idx]; }
+    size_t edge_count(size_t lod) const { return 0 == lod ? _edges.size() : _lods[lod - 1].edges.size(); }
+    const Edge& edge(size_t lod, size_t idx) const { return 0 == lod ? _edges[idx] : _lods[lod - 1].edges[idx]; }
+
     GLuint texture(TextureManager::TextureType idx) const { return _textures[idx]; }
 
     // pose-position bounds
@@ -45,18 +84,46 @@ public:
     void weld_vertices();
     void compute_edges();
 
+    // restores the results of pose(), weld_vertices(), compute_normals() and compute_edges()
+    // for a mesh that was already processed (the edges are swapped out of the given vector)
+    void restore(std::vector<Edge>& edges, const AABB& bounds);
+
+    // simplifies the mesh into up to count levels (including the full mesh)
+    // each with about reduction times the triangles of the one before it
+    // NOTE: this must be called after the mesh is fully processed
+    void generate_lods(size_t count, float reduction);
+
+    // copies the weights for the vectorized skinning kernels
+    // NOTE: this must be called after the mesh is fully processed
+    void prepare_skinning(const Skeleton& skeleton);
+
+    const Skinning& skinning() const { return _skinning; }
+
     // puts the vertices for this mesh into the given buffers
     // vstart is the vertex-based index into vertices
     // tstart is the triangle-based buffer index
-    void calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart, RenderableBuffers& buffers, size_t tstart) const;
+    // every vertex is positioned, only the triangles for the lod are copied
+    void calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart, RenderableBuffers& buffers, size_t tstart, Skinning::Kernel kernel, size_t lod=0) const;
+
+    // skins every vertex into vertices starting at vstart, no triangles are copied
+    void position_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart, Skinning::Kernel kernel) const;
+
+    // copies the triangles for the lod from vertices that are already positioned
+    void copy_triangles(size_t lod, boost::shared_array<Vertex> vertices, size_t vstart, RenderableBuffers& buffers, size_t tstart) const;
+
+    // 6 indices per triangle of the lod for drawing with GL_TRIANGLES_ADJACENCY
+    // they index the expanded vertices, tstart is the triangle-based buffer index
+    void copy_adjacency(size_t lod, uint32_t* const indices, size_t tstart) const;
 
 private:
-    void position_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, size_t vstart) const;
-    void weld_vertices(const boost::unordered_map<int, int>& vertices);
-    void fix_triangles(int old_index, int new_index);
-    void calculate_edge(const Triangle& triangle, int t);
-    void find_matching_edges();
-    void find_matching_edge(int v1, int v2, int t);
+    // vertices[i] is the vertex that i is welded to, or -1
+    void weld_vertices(const std::vector<int>& vertices, size_t count);
+    void fix_triangles(const std::vector<int>& remap);
+    void compute_edges(const Triangle* const triangles, int tcount, std::vector<Edge>& edges) const;
+    void calculate_edge(const Triangle& triangle, int t, EdgeMap& edges) const;
+    void find_matching_edges(const Triangle* const triangles, int tcount, EdgeMap& edges) const;
+    void find_matching_edge(int v1, int v2, int t, EdgeMap& edges) const;
+    void add_edge(int v1, int v2, int t, EdgeMap& edges) const;
 
 private:
     int _vcount;
@@ -70,6 +137,10 @@ private:
 
     std::vector<Edge> _edges;
 
+    std::vector<Lod> _lods;
+
+    Skinning _skinning;
+
     GLuint _textures[TextureManager::TextureCount];
 
     // pose-position bounds
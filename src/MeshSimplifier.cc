@@ -0,0 +1,380 @@
+#include "pch.h"
+#include <algorithm>
+#include <iterator>
+#include "common.h"
+#include "MeshSimplifier.h"
+
+namespace
+{
+    // scales the squared edge length into the cost of collapsing
+    // between vertices skinned differently, a total mismatch costs
+    // as much as moving the edge length off of the surface
+    const double WEIGHT_COST = 1.0;
+
+    // prefers shorter edges where the surface is flat
+    const double EDGE_COST = 0.01;
+
+    // collapses that turn a triangle further than this (cos of ~78 degrees) are rejected
+    const double MIN_NORMAL_DOT = 0.2;
+
+    uint64_t edge_key(int v1, int v2)
+    {
+        if(v1 > v2) {
+            std::swap(v1, v2);
+        }
+        return (static_cast<uint64_t>(static_cast<uint32_t>(v1)) << 32) | static_cast<uint32_t>(v2);
+    }
+
+    // unnormalized, the length is twice the area
+    void triangle_normal(const Position& p1, const Position& p2, const Position& p3, double* const normal)
+    {
+        const double e1[3] = { p2.x() - p1.x(), p2.y() - p1.y(), p2.z() - p1.z() };
+        const double e2[3] = { p3.x() - p1.x(), p3.y() - p1.y(), p3.z() - p1.z() };
+
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    double dot(const double* const a, const double* const b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+}
+
+void MeshSimplifier::Quadric::add_plane(double a, double b, double c, double d)
+{
+    m[0] += a * a; m[1] += a * b; m[2] += a * c; m[3] += a * d;
+                   m[4] += b * b; m[5] += b * c; m[6] += b * d;
+                                  m[7] += c * c; m[8] += c * d;
+                                                 m[9] += d * d;
+}
+
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& rhs)
+{
+    for(int i=0; i<10; ++i) {
+        m[i] += rhs.m[i];
+    }
+    return *this;
+}
+
+double MeshSimplifier::Quadric::error(const Position& p) const
+{
+    const double x = p.x(), y = p.y(), z = p.z();
+    return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+                        +       m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+                                             +       m[7] * z * z + 2.0 * m[8] * z
+                                                                  +       m[9];
+}
+
+Logger& MeshSimplifier::logger(Logger::instance("md5mv.MeshSimplifier"));
+
+MeshSimplifier::MeshSimplifier(const Vertex* const vertices, size_t vertex_count, const Triangle* const triangles, size_t triangle_count, const Weight* const weights)
+    : _vertices(vertex_count), _triangles(triangles, triangles + triangle_count),
+        _removed(triangle_count, false), _live_triangles(triangle_count)
+{
+    for(size_t i=0; i<vertex_count; ++i) {
+        const Vertex& vertex(vertices[i]);
+
+        SimplifierVertex& v(_vertices[i]);
+        v.position = vertex.position;
+        v.locked = v.removed = false;
+        v.version = 0;
+
+        if(NULL != weights) {
+            for(int j=0; j<vertex.weight_count; ++j) {
+                const Weight& weight(weights[vertex.weight_start + j]);
+                v.weights.push_back(std::make_pair(weight.joint, weight.weight));
+            }
+            std::sort(v.weights.begin(), v.weights.end());
+        }
+    }
+
+    // every vertex starts with the planes of the triangles around it
+    for(size_t i=0; i<_triangles.size(); ++i) {
+        const Triangle& triangle(_triangles[i]);
+        const int v[3] = { triangle.v1, triangle.v2, triangle.v3 };
+
+        double normal[3];
+        triangle_normal(_vertices[v[0]].position, _vertices[v[1]].position, _vertices[v[2]].position, normal);
+
+        const double length = std::sqrt(dot(normal, normal));
+        for(int j=0; j<3; ++j) {
+            _vertices[v[j]].triangles.push_back(i);
+
+            // degenerate triangles don't have a plane
+            if(length > 0.0) {
+                const Position& p(_vertices[v[0]].position);
+                const double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+                _vertices[v[j]].quadric.add_plane(a, b, c, -(a * p.x() + b * p.y() + c * p.z()));
+            }
+        }
+    }
+
+    lock_open_edges();
+
+    for(size_t i=0; i<_vertices.size(); ++i) {
+        queue_collapses(i);
+    }
+}
+
+MeshSimplifier::~MeshSimplifier() throw()
+{
+}
+
+void MeshSimplifier::simplify(size_t target, float max_error)
+{
+    // the costs are squared distances
+    const double max_cost = static_cast<double>(max_error) * max_error;
+    while(_live_triangles > target && !_collapses.empty()) {
+        const Collapse next(_collapses.top());
+        if(next.cost > max_cost) {
+            break;
+        }
+        _collapses.pop();
+
+        // something's changed around it since it was queued
+        const SimplifierVertex &from(_vertices[next.from]), &to(_vertices[next.to]);
+        if(from.removed || to.removed || from.version != next.from_version || to.version != next.to_version) {
+            continue;
+        }
+
+        if(can_collapse(next.from, next.to)) {
+            collapse(next.from, next.to);
+        }
+    }
+}
+
+size_t MeshSimplifier::copy_triangles(boost::shared_array<Triangle>& triangles) const
+{
+    triangles.reset(new Triangle[_live_triangles]);
+
+    size_t count = 0;
+    for(size_t i=0; i<_triangles.size(); ++i) {
+        if(_removed[i]) {
+            continue;
+        }
+
+        Triangle& triangle(triangles[count]);
+        triangle = _triangles[i];
+        triangle.index = count;
+
+        // the cooked normals are for the original corners
+        double normal[3];
+        triangle_normal(_vertices[triangle.v1].position, _vertices[triangle.v2].position, _vertices[triangle.v3].position, normal);
+        triangle.normal = Vector3(static_cast<float>(normal[0]), static_cast<float>(normal[1]), static_cast<float>(normal[2]));
+        if(triangle.normal.length_squared() > 0.0f) {
+            triangle.normal.normalize();
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+void MeshSimplifier::lock_open_edges()
+{
+    boost::unordered_map<uint64_t, int> edges;
+    BOOST_FOREACH(const Triangle& triangle, _triangles) {
+        edges[edge_key(triangle.v1, triangle.v2)]++;
+        edges[edge_key(triangle.v2, triangle.v3)]++;
+        edges[edge_key(triangle.v3, triangle.v1)]++;
+    }
+
+    // anything but two triangles is an open (or non-manifold) edge
+    size_t count = 0;
+    for(boost::unordered_map<uint64_t, int>::const_iterator it=edges.begin(); it!=edges.end(); ++it) {
+        if(2 == it->second) {
+            continue;
+        }
+
+        const int v[2] = { static_cast<int>(it->first >> 32), static_cast<int>(it->first & 0xffffffff) };
+        for(int i=0; i<2; ++i) {
+            if(!_vertices[v[i]].locked) {
+                _vertices[v[i]].locked = true;
+                count++;
+            }
+        }
+    }
+
+    LOG_DEBUG("Locked " << count << " of " << _vertices.size() << " vertices on open edges" << std::endl);
+}
+
+void MeshSimplifier::queue_collapses(int v)
+{
+    std::vector<int> neighbors;
+    BOOST_FOREACH(int t, _vertices[v].triangles) {
+        const Triangle& triangle(_triangles[t]);
+        neighbors.push_back(triangle.v1);
+        neighbors.push_back(triangle.v2);
+        neighbors.push_back(triangle.v3);
+    }
+
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+    BOOST_FOREACH(int neighbor, neighbors) {
+        if(neighbor != v) {
+            queue_collapse(v, neighbor);
+            queue_collapse(neighbor, v);
+        }
+    }
+}
+
+void MeshSimplifier::queue_collapse(int from, int to)
+{
+    if(_vertices[from].locked) {
+        return;
+    }
+
+    Collapse collapse;
+    collapse.cost = collapse_cost(from, to);
+    collapse.from = from;
+    collapse.to = to;
+    collapse.from_version = _vertices[from].version;
+    collapse.to_version = _vertices[to].version;
+    _collapses.push(collapse);
+}
+
+double MeshSimplifier::collapse_cost(int from, int to) const
+{
+    const SimplifierVertex &v1(_vertices[from]), &v2(_vertices[to]);
+
+    Quadric quadric(v1.quadric);
+    quadric += v2.quadric;
+
+    const double length = v1.position.distance_squared(v2.position);
+    return std::max(quadric.error(v2.position), 0.0) + (WEIGHT_COST * weight_difference(from, to) + EDGE_COST) * length;
+}
+
+double MeshSimplifier::weight_difference(int v1, int v2) const
+{
+    // both are sorted by joint
+    const std::vector<std::pair<int, float> > &w1(_vertices[v1].weights), &w2(_vertices[v2].weights);
+
+    double difference = 0.0;
+    size_t i=0, j=0;
+    while(i < w1.size() || j < w2.size()) {
+        if(j >= w2.size() || (i < w1.size() && w1[i].first < w2[j].first)) {
+            difference += std::fabs(w1[i++].second);
+        } else if(i >= w1.size() || w2[j].first < w1[i].first) {
+            difference += std::fabs(w2[j++].second);
+        } else {
+            difference += std::fabs(w1[i++].second - w2[j++].second);
+        }
+    }
+
+    // in [0, 1] for normalized weights
+    return difference * 0.5;
+}
+
+bool MeshSimplifier::can_collapse(int from, int to) const
+{
+    const SimplifierVertex &v1(_vertices[from]), &v2(_vertices[to]);
+
+    // the only vertices the two can share are the ones across the triangles on the edge
+    // anything else would pinch the surface together when they're merged
+    std::vector<int> n1, n2;
+    size_t shared = 0;
+    BOOST_FOREACH(int t, v1.triangles) {
+        const Triangle& triangle(_triangles[t]);
+        const bool has_to = triangle.v1 == to || triangle.v2 == to || triangle.v3 == to;
+        if(has_to) {
+            shared++;
+        }
+
+        n1.push_back(triangle.v1);
+        n1.push_back(triangle.v2);
+        n1.push_back(triangle.v3);
+
+        if(has_to) {
+            continue;
+        }
+
+        // the triangle can't turn over once from moves to to
+        const Position* p[3] = { &_vertices[triangle.v1].position, &_vertices[triangle.v2].position, &_vertices[triangle.v3].position };
+
+        double before[3];
+        triangle_normal(*p[0], *p[1], *p[2], before);
+
+        for(int i=0; i<3; ++i) {
+            if(p[i] == &v1.position) {
+                p[i] = &v2.position;
+            }
+        }
+
+        double after[3];
+        triangle_normal(*p[0], *p[1], *p[2], after);
+
+        const double lengths = std::sqrt(dot(before, before) * dot(after, after));
+        if(lengths <= 0.0 || dot(before, after) < MIN_NORMAL_DOT * lengths) {
+            return false;
+        }
+    }
+
+    if(0 == shared) {
+        return false;
+    }
+
+    BOOST_FOREACH(int t, v2.triangles) {
+        const Triangle& triangle(_triangles[t]);
+        n2.push_back(triangle.v1);
+        n2.push_back(triangle.v2);
+        n2.push_back(triangle.v3);
+    }
+
+    std::sort(n1.begin(), n1.end());
+    n1.erase(std::unique(n1.begin(), n1.end()), n1.end());
+
+    std::sort(n2.begin(), n2.end());
+    n2.erase(std::unique(n2.begin(), n2.end()), n2.end());
+
+    std::vector<int> common;
+    std::set_intersection(n1.begin(), n1.end(), n2.begin(), n2.end(), std::back_inserter(common));
+
+    // both ends of the edge are in each other's neighborhoods
+    return common.size() - 2 <= shared;
+}
+
+void MeshSimplifier::collapse(int from, int to)
+{
+    SimplifierVertex &v1(_vertices[from]), &v2(_vertices[to]);
+
+    BOOST_FOREACH(int t, v1.triangles) {
+        Triangle& triangle(_triangles[t]);
+
+        if(triangle.v1 == to || triangle.v2 == to || triangle.v3 == to) {
+            // the triangles on the edge collapse away
+            const int v[3] = { triangle.v1, triangle.v2, triangle.v3 };
+            for(int i=0; i<3; ++i) {
+                if(v[i] != from) {
+                    std::vector<int>& triangles(_vertices[v[i]].triangles);
+                    triangles.erase(std::remove(triangles.begin(), triangles.end(), t), triangles.end());
+                }
+            }
+
+            _removed[t] = true;
+            _live_triangles--;
+            continue;
+        }
+
+        if(triangle.v1 == from) {
+            triangle.v1 = to;
+        } else if(triangle.v2 == from) {
+            triangle.v2 = to;
+        } else {
+            triangle.v3 = to;
+        }
+        v2.triangles.push_back(t);
+    }
+
+    v2.quadric += v1.quadric;
+
+    v1.triangles.clear();
+    v1.removed = true;
+
+    // everything queued against to is out of date
+    v2.version++;
+    queue_collapses(to);
+}
@@ -0,0 +1,97 @@
+#if !defined __MESHSIMPLIFIER_H__
+#define __MESHSIMPLIFIER_H__
+
+#include <queue>
+#include "Geometry.h"
+
+// quadric error simplification (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics")
+// vertices are collapsed onto one of their neighbors rather than a new position
+// so every level is built from the mesh's own vertices, weights and texture coordinates
+// vertices on open edges never move, welding leaves the texture seams open so they're kept as well
+class MeshSimplifier
+{
+private:
+    // symmetric 4x4 matrix, the upper triangle row by row
+    struct Quadric
+    {
+        double m[10];
+
+        Quadric() { std::fill(m, m + 10, 0.0); }
+
+        void add_plane(double a, double b, double c, double d);
+        Quadric& operator+=(const Quadric& rhs);
+
+        // the sum of the squared distances from the point to the planes
+        double error(const Position& p) const;
+    };
+
+    struct SimplifierVertex
+    {
+        Position position;
+        Quadric quadric;
+
+        // the joints and weights the vertex is skinned with
+        std::vector<std::pair<int, float> > weights;
+
+        // the live triangles using the vertex
+        std::vector<int> triangles;
+
+        bool locked, removed;
+
+        // bumped whenever the vertex's collapses need recosting
+        uint32_t version;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        int from, to;
+        uint32_t from_version, to_version;
+
+        bool operator<(const Collapse& rhs) const { return cost > rhs.cost; }
+    };
+
+private:
+    static Logger& logger;
+
+public:
+    // weights may be NULL for an unskinned mesh
+    MeshSimplifier(const Vertex* const vertices, size_t vertex_count, const Triangle* const triangles, size_t triangle_count, const Weight* const weights);
+    virtual ~MeshSimplifier() throw();
+
+public:
+    size_t triangle_count() const { return _live_triangles; }
+
+    // collapses vertices until there are at most target triangles left
+    // or the next one would move the surface further than max_error
+    // this can be called again with a smaller target to build the next level
+    void simplify(size_t target, float max_error);
+
+    // the triangles that are left, in their original order
+    size_t copy_triangles(boost::shared_array<Triangle>& triangles) const;
+
+private:
+    void lock_open_edges();
+    void queue_collapses(int v);
+    void queue_collapse(int from, int to);
+    double collapse_cost(int from, int to) const;
+    double weight_difference(int v1, int v2) const;
+
+    // false if the collapse would flip a triangle or pinch the surface
+    bool can_collapse(int from, int to) const;
+    void collapse(int from, int to);
+
+private:
+    std::vector<SimplifierVertex> _vertices;
+    std::vector<Triangle> _triangles;
+    std::vector<bool> _removed;
+    size_t _live_triangles;
+
+    std::priority_queue<Collapse> _collapses;
+
+private:
+    MeshSimplifier();
+    DISALLOW_COPY_AND_ASSIGN(MeshSimplifier);
+};
+
+#endif
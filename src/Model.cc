@@ -6,30 +6,100 @@
 #include "Model.h"
 
 Skeleton::Skeleton()
-    : _nonroot_joint_count(0)
+    : _joints(NULL), _joint_count(0), _capacity(0)
 {
 }
 
 Skeleton::~Skeleton() throw()
 {
+    reset();
+}
+
+void Skeleton::orientation(size_t idx, const Quaternion& orientation)
+{
+    float* const joint = _joints + (idx * JOINT_STRIDE);
+    joint[0] = orientation[0];
+    joint[1] = orientation[1];
+    joint[2] = orientation[2];
+    joint[3] = orientation[3];
+}
+
+Skeleton::Joint Skeleton::joint(size_t idx) const
+{
+    Joint joint;
+    joint.name = name(idx);
+    joint.parent = parent(idx);
+    joint.position = position(idx);
+    joint.orientation = orientation(idx);
+    return joint;
 }
 
 void Skeleton::add_joint(const Joint& joint)
 {
-    _joints.push_back(joint);
+    if(!_hierarchy) {
+        _hierarchy.reset(new Hierarchy());
+    } else if(!_hierarchy.unique()) {
+        _hierarchy.reset(new Hierarchy(*_hierarchy));
+    }
+
+    _hierarchy->names.push_back(joint.name);
+    _hierarchy->parents.push_back(joint.parent);
     if(joint.parent >= 0) {
-        _nonroot_joint_count++;
+        _hierarchy->nonroot_joint_count++;
+    }
+
+    if(_joint_count == _capacity) {
+        reserve(std::max<size_t>(_capacity * 2, 16));
     }
+
+    _joint_count++;
+    position(_joint_count - 1, joint.position);
+    orientation(_joint_count - 1, joint.orientation);
+}
+
+void Skeleton::allocate(const Skeleton& skeleton)
+{
+    _hierarchy = skeleton._hierarchy;
+    if(skeleton._joint_count > _capacity) {
+        reserve(skeleton._joint_count);
+    }
+    _joint_count = skeleton._joint_count;
 }
 
 void Skeleton::reset()
 {
-    _joints.clear();
-    _nonroot_joint_count = 0;
+    _hierarchy.reset();
+
+    if(NULL != _joints) {
+        _aligned_free(_joints);
+    }
+    _joints = NULL;
+    _joint_count = _capacity = 0;
+}
+
+void Skeleton::reserve(size_t count)
+{
+    float* const joints = static_cast<float*>(_aligned_malloc(count * JOINT_STRIDE * sizeof(float), 16));
+    if(NULL != _joints) {
+        std::memcpy(joints, _joints, _joint_count * JOINT_STRIDE * sizeof(float));
+        _aligned_free(_joints);
+    }
+
+    _joints = joints;
+    _capacity = count;
 }
 
 Logger& Model::logger(Logger::instance("md5mv.Model"));
 
+size_t Model::_lods = 1;
+float Model::_lod_reduction = 0.5f;
+
+void Model::lods(size_t count, float reduction)
+{
+    _lods = std::max<size_t>(count, 1);
+    _lod_reduction = reduction;
+}
+
 Model::Model(const std::string& name)
     : _name(name), _vcount(0), _tcount(0), _ecount(0)
 {
@@ -64,28 +134,112 @@ void Model::unload() throw()
     _vcount = 0;
     _tcount = 0;
     _ecount = 0;
+    _lod_tcount.clear();
+    _lod_ecount.clear();
 
     _bounds = AABB();
 
     on_unload();
 }
 
-void Model::calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, RenderableBuffers& buffers) const
+size_t Model::max_edge_count() const
+{
+    size_t count = 0;
+    for(size_t i=0; i<lod_count(); ++i) {
+        count = std::max(count, edge_count(i));
+    }
+    return count;
+}
+
+size_t Model::lod_start(size_t lod) const
 {
-    size_t vstart=0, tstart=0;
+    size_t start = 0;
+    for(size_t i=0; i<lod; ++i) {
+        start += triangle_count(i);
+    }
+    return start;
+}
+
+void Model::calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, RenderableBuffers& buffers, Skinning::Kernel kernel, size_t lod) const
+{
+    size_t vstart=0, tstart=0, lstart=0;
     for(size_t i=0; i<_meshes.size(); ++i) {
         const Mesh& m(mesh(i));
-        m.calculate_vertices(skeleton, vertices, vstart, buffers, tstart);
+        m.calculate_vertices(skeleton, vertices, vstart, buffers, tstart, kernel, lod);
+
+        // the normal lines always go where the full mesh puts them
+        if(lod > 0) {
+            buffers.copy_normal_lines(vertices.get() + vstart, m.vertex_count(), lstart * 3);
+        }
 
         vstart += m.vertex_count();
-        tstart += m.triangle_count();
+        tstart += m.triangle_count(lod);
+        lstart += m.triangle_count();
     }
 }
 
-void Model::add_mesh(boost::shared_ptr<Mesh> mesh, bool has_normals, bool has_edges)
+void Model::skin_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, Skinning::Kernel kernel) const
 {
-    _meshes.push_back(mesh);
+    size_t vstart=0;
+    for(size_t i=0; i<_meshes.size(); ++i) {
+        const Mesh& m(mesh(i));
+        m.position_vertices(skeleton, vertices, vstart, kernel);
 
+        vstart += m.vertex_count();
+    }
+}
+
+void Model::copy_lods(boost::shared_array<Vertex> vertices, RenderableBuffers& buffers) const
+{
+    for(size_t i=0; i<lod_count(); ++i) {
+        size_t vstart=0, tstart=lod_start(i);
+        for(size_t j=0; j<_meshes.size(); ++j) {
+            const Mesh& m(mesh(j));
+            m.copy_triangles(i, vertices, vstart, buffers, tstart);
+
+            vstart += m.vertex_count();
+            tstart += m.triangle_count(i);
+        }
+    }
+}
+
+void Model::copy_adjacency(uint32_t* const indices) const
+{
+    for(size_t i=0; i<lod_count(); ++i) {
+        size_t tstart=0;
+        for(size_t j=0; j<_meshes.size(); ++j) {
+            const Mesh& m(mesh(j));
+            m.copy_adjacency(i, indices + ((lod_start(i) + tstart) * 6), tstart);
+
+            tstart += m.triangle_count(i);
+        }
+    }
+}
+
+bool Model::has_influences() const
+{
+    if(_meshes.empty()) {
+        return false;
+    }
+
+    for(size_t i=0; i<_meshes.size(); ++i) {
+        if(!mesh(i).skinning().has_influences()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Model::build_palette(const Skeleton& skeleton, float* const palette) const
+{
+    // every mesh shares the same bind pose
+    if(!_meshes.empty()) {
+        mesh(0).skinning().build_palette(skeleton, palette);
+    }
+}
+
+void Model::add_mesh(boost::shared_ptr<Mesh> mesh, bool has_normals, bool has_edges)
+{
     mesh->pose(_skeleton);
     mesh->weld_vertices();
 
@@ -97,11 +251,27 @@ void Model::add_mesh(boost::shared_ptr<Mesh> mesh, bool has_normals, bool has_ed
         mesh->compute_edges();
     }
 
+    add_processed_mesh(mesh);
+}
+
+void Model::add_processed_mesh(boost::shared_ptr<Mesh> mesh)
+{
+    mesh->prepare_skinning(_skeleton);
+    mesh->generate_lods(_lods, _lod_reduction);
+    _meshes.push_back(mesh);
+
     // update some model-wide properties
     _vcount += mesh->vertex_count();
     _tcount += mesh->triangle_count();
     _ecount += mesh->edge_count();
     _bounds.update(mesh->bounds());
+
+    _lod_tcount.resize(mesh->lod_count(), 0);
+    _lod_ecount.resize(mesh->lod_count(), 0);
+    for(size_t i=0; i<mesh->lod_count(); ++i) {
+        _lod_tcount[i] += mesh->triangle_count(i);
+        _lod_ecount[i] += mesh->edge_count(i);
+    }
 }
 
 bool Model::on_load(const boost::filesystem::path& path)
@@ -3,6 +3,7 @@
 
 #include "AABB.h"
 #include "Quaternion.h"
+#include "Skinning.h"
 #include "Vector.h"
 
 class Lexer;
@@ -11,9 +12,17 @@ class RenderableBuffers;
 struct Triangle;
 struct Vertex;
 
+// a pose of a set of joints
+// the joint names and parents are shared by every pose allocated from the same skeleton
+// and the joints themselves are kept flat in one aligned array so they can be
+// interpolated in place and skinned from directly without allocating
 class Skeleton
 {
 public:
+    // each joint is (qx, qy, qz, qw, px, py, pz, pw)
+    static const size_t JOINT_STRIDE = 8;
+
+    // for building skeletons at load time
     struct Joint
     {
         std::string name;
@@ -22,25 +31,58 @@ public:
         Quaternion orientation;
     };
 
+private:
+    struct Hierarchy
+    {
+        Hierarchy() : nonroot_joint_count(0) {}
+
+        std::vector<std::string> names;
+        std::vector<int> parents;
+        size_t nonroot_joint_count;
+    };
+
 public:
     Skeleton();
     virtual ~Skeleton() throw();
 
 public:
-    size_t joint_count() const { return _joints.size(); }
-    size_t nonroot_joint_count() const { return _nonroot_joint_count; }
+    size_t joint_count() const { return _joint_count; }
+    size_t nonroot_joint_count() const { return _hierarchy ? _hierarchy->nonroot_joint_count : 0; }
 
-    Joint& joint(size_t idx) { return _joints[idx]; }
-    const Joint& joint(size_t idx) const { return _joints[idx]; }
+    const std::string& name(size_t idx) const { return _hierarchy->names[idx]; }
+    int parent(size_t idx) const { return _hierarchy->parents[idx]; }
 
+    Position position(size_t idx) const { return Position(_joints + (idx * JOINT_STRIDE) + 4); }
+    void position(size_t idx, const Position& position) { std::memcpy(_joints + (idx * JOINT_STRIDE) + 4, position.array(), sizeof(float) * 4); }
+
+    Quaternion orientation(size_t idx) const { return Quaternion(_joints + (idx * JOINT_STRIDE)); }
+    void orientation(size_t idx, const Quaternion& orientation);
+
+    const float* joints() const { return _joints; }
+    float* joints() { return _joints; }
+
+    // NOTE: this copies the name so it's for load time, not every frame
+    Joint joint(size_t idx) const;
+
+    // copies the hierarchy first if it's shared
     void add_joint(const Joint& joint);
 
+    // shares skeleton's hierarchy and makes room for its joints
+    // this doesn't allocate if it's already allocated from it
+    // NOTE: the joints aren't copied
+    void allocate(const Skeleton& skeleton);
+
     void reset();
 
 private:
-    std::vector<Joint> _joints;
+    void reserve(size_t count);
 
-    size_t _nonroot_joint_count;
+private:
+    boost::shared_ptr<Hierarchy> _hierarchy;
+
+    // 16-byte aligned, JOINT_STRIDE floats per joint
+    float* _joints;
+    size_t _joint_count, _capacity;
 
 private:
     DISALLOW_COPY_AND_ASSIGN(Skeleton);
@@ -51,9 +93,18 @@ class Model
 public:
     static std::string extension() { return ".mdl"; }
 
+    // simplified levels generated for every model loaded afterwards (see MeshSimplifier)
+    // count includes the full mesh, so 1 doesn't generate any
+    // each level has about reduction times the triangles of the one before it
+    static size_t lods() { return _lods; }
+    static void lods(size_t count, float reduction);
+
 private:
     static Logger& logger;
 
+    static size_t _lods;
+    static float _lod_reduction;
+
 public:
     explicit Model(const std::string& name);
     virtual ~Model() throw();
@@ -62,7 +113,7 @@ public:
     const std::string& name() const { return _name; }
 
     size_t joint_count() const { return _skeleton.joint_count(); }
-    const Skeleton::Joint& joint(size_t idx) const { return _skeleton.joint(idx); }
+    Skeleton::Joint joint(size_t idx) const { return _skeleton.joint(idx); }
 
     Skeleton& skeleton() { return _skeleton; }
     const Skeleton& skeleton() const { return _skeleton; }
@@ -74,6 +125,16 @@ public:
     size_t triangle_count() const { return _tcount; }
     size_t edge_count() const { return _ecount; }
 
+    // every mesh has the same levels, level 0 is the full model
+    size_t lod_count() const { return _lod_tcount.size(); }
+    size_t triangle_count(size_t lod) const { return _lod_tcount[lod]; }
+    size_t edge_count(size_t lod) const { return _lod_ecount[lod]; }
+    size_t max_edge_count() const;
+
+    // the triangle index of the level when every level is copied by copy_lods()
+    size_t lod_start(size_t lod) const;
+    size_t lod_triangle_count() const { return lod_start(lod_count()); }
+
     // pose-position bounds
     const AABB& bounds() const { return _bounds; }
 
@@ -82,11 +143,34 @@ public:
     bool load_textures(const boost::filesystem::path& path);
     void unload() throw();
 
-    void calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, RenderableBuffers& buffers) const;
+    // every vertex is positioned, only the triangles for the lod are copied
+    void calculate_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, RenderableBuffers& buffers, Skinning::Kernel kernel=Skinning::kernel(), size_t lod=0) const;
+
+    // just positions every vertex, no triangles are copied
+    void skin_vertices(const Skeleton& skeleton, boost::shared_array<Vertex> vertices, Skinning::Kernel kernel=Skinning::kernel()) const;
+
+    // copies every level back to back from vertices that are already positioned
+    // buffers must hold lod_triangle_count() triangles
+    void copy_lods(boost::shared_array<Vertex> vertices, RenderableBuffers& buffers) const;
+
+    // the GL_TRIANGLES_ADJACENCY indices of every level back to back, 6 per triangle
+    // each level indexes from the start of its own triangles so it can be drawn
+    // from the full set of levels or from just the one calculate_vertices() copied
+    void copy_adjacency(uint32_t* const indices) const;
+
+    // true if every mesh can be skinned from a joint palette
+    bool has_influences() const;
+
+    // builds the joint matrix * inverse bind matrix for each joint
+    // palette must hold joint_count() * Skinning::PALETTE_STRIDE floats
+    void build_palette(const Skeleton& skeleton, float* const palette) const;
 
 protected:
     void add_mesh(boost::shared_ptr<Mesh> mesh, bool has_normals, bool has_edges);
 
+    // adds a mesh that has already been posed, welded, etc
+    void add_processed_mesh(boost::shared_ptr<Mesh> mesh);
+
     virtual bool on_load(const boost::filesystem::path& path);
     virtual void on_unload() throw() {}
 
@@ -104,6 +188,7 @@ private:
     Skeleton _skeleton;
 
     size_t _vcount, _tcount, _ecount;
+    std::vector<size_t> _lod_tcount, _lod_ecount;
 
     // pose-position bounds
     AABB _bounds;
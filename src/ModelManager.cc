@@ -1,6 +1,7 @@
 #include "pch.h"
 #include <iostream>
 #include "common.h"
+#include "util.h"
 #include "Animation.h"
 #include "MD5Animation.h"
 #include "MD5Model.h"
@@ -27,12 +28,21 @@ ModelManager::~ModelManager() throw()
 {
 }
 
+void ModelManager::log_load_time(const std::string& type, const boost::filesystem::path& filename, double start) const
+{
+    const double elapsed = get_time() - start;
+    const double mb = boost::filesystem::file_size(filename) / (1024.0 * 1024.0);
+    LOG_INFO("Loaded " << type << " '" << filename << "' in " << (elapsed * 1000.0) << "ms ("
+        << (elapsed > 0.0 ? mb / elapsed : 0.0) << " MB/s)" << std::endl);
+}
+
 bool ModelManager::load_animation(const boost::filesystem::path& path, const std::string& model, const std::string& name)
 {
     boost::shared_ptr<Animation> animation;
-    if(boost::filesystem::exists(model_dir() / path / (name + MD5Animation::extension()))) {
+    boost::filesystem::path filename;
+    if(boost::filesystem::exists(filename = model_dir() / path / (name + MD5Animation::extension()))) {
         animation.reset(new MD5Animation(name));
-    } else if(boost::filesystem::exists(model_dir() / path / (name + Animation::extension()))) {
+    } else if(boost::filesystem::exists(filename = model_dir() / path / (name + Animation::extension()))) {
         animation.reset(new Animation(name));
     }
 
@@ -41,11 +51,12 @@ bool ModelManager::load_animation(const boost::filesystem::path& path, const std
         return false;
     }
 
+    const double start = get_time();
     if(!animation->load(path)) {
         LOG_ERROR("Error loading animation '" << name << "'!" << std::endl);
         return false;
     }
-    animation->build_skeletons();
+    log_load_time("animation", filename, start);
 
     _animations[model + "_" + name] = animation;
     return true;
@@ -64,9 +75,10 @@ boost::shared_ptr<Animation> ModelManager::animation(const std::string& model, c
 bool ModelManager::load_model(const boost::filesystem::path& path, const std::string& name)
 {
     boost::shared_ptr<Model> model;
-    if(boost::filesystem::exists(model_dir() / path / (name + MD5Model::extension()))) {
+    boost::filesystem::path filename;
+    if(boost::filesystem::exists(filename = model_dir() / path / (name + MD5Model::extension()))) {
         model.reset(new MD5Model(name));
-    } else if(boost::filesystem::exists(model_dir() / path / (name + Model::extension()))) {
+    } else if(boost::filesystem::exists(filename = model_dir() / path / (name + Model::extension()))) {
         model.reset(new Model(name));
     }
 
@@ -75,10 +87,12 @@ bool ModelManager::load_model(const boost::filesystem::path& path, const std::st
         return false;
     }
 
+    const double start = get_time();
     if(!model->load(path)) {
         LOG_ERROR("Error loading model '" << name << "'!" << std::endl);
         return false;
     }
+    log_load_time("model", filename, start);
 
     if(!model->load_textures(path)) {
         LOG_ERROR("Error loading model textures!" << std::endl);
@@ -25,6 +25,10 @@ public:
     bool load_model(const boost::filesystem::path& path, const std::string& name);
     boost::shared_ptr<Model> model(const std::string& name) const;
 
+private:
+    // logs the load time and throughput of a model or animation file
+    void log_load_time(const std::string& type, const boost::filesystem::path& filename, double start) const;
+
 private:
     AnimationMap _animations;
     ModelMap _models;
@@ -4,12 +4,12 @@
 #include "Physical.h"
 
 Physical::Physical()
-    : _scale(1.0f)
+    : _scale(1.0f), _transform_version(0)
 {
 }
 
 Physical::Physical(const Position& position, float scale)
-    : _position(position), _scale(scale)
+    : _position(position), _scale(scale), _transform_version(0)
 {
 }
 
@@ -21,6 +21,7 @@ void Physical::rotate(float angle, const Vector3& around)
 {
     Quaternion q(Quaternion::new_axis(angle, around));
     _orientation = q * _orientation;
+    _transform_version++;
 }
 
 void Physical::pitch(float angle)
@@ -28,6 +29,7 @@ void Physical::pitch(float angle)
     // need to pitch against our local x-axis
     Quaternion q(Quaternion::new_axis(angle, Vector3(1.0f, 0.0f, 0.0f)));
     _orientation = _orientation * q;
+    _transform_version++;
 }
 
 void Physical::yaw(float angle)
@@ -57,7 +59,10 @@ void Physical::think(double dt)
     _velocity += _acceleration * dt;
 
     // apply the velocity to our position
-    _position += _velocity * dt;
+    if(_velocity.length_squared() > 0.0f) {
+        _position += _velocity * dt;
+        _transform_version++;
+    }
 }
 
 std::string Physical::str() const
@@ -14,11 +14,11 @@ public:
 
 public:
     const Position& position() const { return _position; }
-    void position(const Position& position) { _position = position; }
+    void position(const Position& position) { _position = position; _transform_version++; }
 
     const Quaternion& orientation() const { return _orientation; }
-    void orientation(const Quaternion& orientation) { _orientation = orientation; }
-    void lookat(const Position& position) { _orientation = Quaternion::new_axis(0.0f, position); }
+    void orientation(const Quaternion& orientation) { _orientation = orientation; _transform_version++; }
+    void lookat(const Position& position) { _orientation = Quaternion::new_axis(0.0f, position); _transform_version++; }
 
     // rotation is in radians
     void rotate(float angle, const Position& around);
@@ -27,7 +27,10 @@ public:
     void roll(float angle);
 
     float scale() const { return _scale; }
-    void scale(float scale) { _scale = scale; }
+    void scale(float scale) { _scale = scale; _transform_version++; }
+
+    // bumped whenever the position, orientation, or scale changes
+    uint32_t transform_version() const { return _transform_version; }
 
     AABB absolute_bounds() const { return _position + _bounds; }
     const AABB& relative_bounds() const { return _bounds; }
@@ -60,6 +63,7 @@ private:
     Quaternion _orientation;
     Vector3 _velocity, _acceleration;
     AABB _bounds;
+    uint32_t _transform_version;
 };
 
 #endif
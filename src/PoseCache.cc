@@ -0,0 +1,264 @@
+#include "pch.h"
+#include "Animation.h"
+#include "PoseCache.h"
+
+Logger& PoseCache::logger(Logger::instance("md5mv.PoseCache"));
+
+namespace
+{
+    // enough for a crowd without growing, must be a power of two
+    const size_t INITIAL_POSE_SLOTS = 64;
+}
+
+std::size_t hash_value(const CachedPose::Key& key)
+{
+    std::size_t seed = 0;
+    boost::hash_combine(seed, key.model);
+    boost::hash_combine(seed, key.animation);
+    boost::hash_combine(seed, key.frame);
+    boost::hash_combine(seed, key.step);
+    boost::hash_combine(seed, key.lod);
+    return seed;
+}
+
+CachedPose::CachedPose(const Model& model, bool skin)
+    : _frame_percent(0.0f), _skin(skin), _uploaded(false), _last_used(0)
+{
+    ZeroMemory(&_key, sizeof(Key));
+    ZeroMemory(_vbo, sizeof(GLuint) * BufferCount);
+
+    if(_skin) {
+        _vertices.reset(new Vertex[model.vertex_count()]);
+        _buffers.allocate_buffers(model.triangle_count() * 3);
+    }
+}
+
+CachedPose::~CachedPose() throw()
+{
+    if(0 != _vbo[0]) {
+        glDeleteBuffers(BufferCount, _vbo);
+    }
+}
+
+void CachedPose::reset(const Key& key, float frame_percent)
+{
+    _key = key;
+    _frame_percent = frame_percent;
+    _uploaded = false;
+}
+
+void CachedPose::build()
+{
+    const Animation& animation(*_key.animation);
+
+    _skeleton.allocate(_key.model->skeleton());
+    animation.interpolate_skeleton(_key.frame, (_key.frame + 1) % animation.frame_count(), _skeleton, _frame_percent);
+
+    if(_skin) {
+        _key.model->calculate_vertices(_skeleton, _vertices, _buffers, Skinning::kernel(), _key.lod);
+    }
+}
+
+void CachedPose::upload()
+{
+    if(!_skin || _uploaded) {
+        return;
+    }
+
+    if(0 == _vbo[0]) {
+        glGenBuffers(BufferCount, _vbo);
+    }
+
+    Renderable::upload_buffers(_buffers, _vbo, GL_DYNAMIC_DRAW);
+    _uploaded = true;
+}
+
+PoseCache::PoseCache(size_t steps)
+    : _steps(steps > 0 ? steps : 1), _frame(0), _poses(INITIAL_POSE_SLOTS), _pose_count(0), _hits(0), _misses(0)
+{
+    LOG_INFO("Caching " << _steps << " poses per animation frame" << std::endl);
+}
+
+PoseCache::~PoseCache() throw()
+{
+    LOG_INFO("Pose cache hit rate: " << (hit_rate() * 100.0) << "% ("
+        << _hits << " of " << (_hits + _misses) << " lookups)" << std::endl);
+}
+
+double PoseCache::hit_rate() const
+{
+    const uint64_t lookups = _hits + _misses;
+    return lookups > 0 ? static_cast<double>(_hits) / lookups : 0.0;
+}
+
+void PoseCache::begin_frame()
+{
+    _frame++;
+    _pending.clear();
+
+    BOOST_FOREACH(ModelPoses::value_type& stale, _stale) {
+        stale.second.clear();
+    }
+
+    // erasing shifts the slots around so the dropped keys are collected first
+    _evicted.clear();
+    BOOST_FOREACH(const boost::shared_ptr<CachedPose>& pose, _poses) {
+        if(!pose) {
+            continue;
+        }
+
+        if(pose->last_used() + 1 >= _frame) {
+            _stale[pose->key().model].push_back(pose);
+            continue;
+        }
+
+        // an actor that stopped animating may still be holding on to it
+        if(pose.unique()) {
+            _free[pose->key().model].push_back(pose);
+        }
+        _evicted.push_back(pose->key());
+    }
+
+    BOOST_FOREACH(const CachedPose::Key& key, _evicted) {
+        erase_pose(key);
+    }
+}
+
+boost::shared_ptr<CachedPose> PoseCache::pose(const Model& model, const Animation& animation, size_t frame, double frame_percent, bool skin, size_t lod)
+{
+    CachedPose::Key key;
+    key.model = &model;
+    key.animation = &animation;
+    key.frame = frame;
+    key.lod = skin ? lod : 0;
+
+    // the percent can land right on 1.0
+    key.step = std::min(static_cast<size_t>(std::max(frame_percent, 0.0) * _steps), _steps - 1);
+
+    const boost::shared_ptr<CachedPose>& cached(_poses[find_pose(key)]);
+    if(cached) {
+        _hits++;
+        cached->last_used(_frame);
+        return cached;
+    }
+    _misses++;
+
+    boost::shared_ptr<CachedPose> pose(recycle(model, skin));
+    if(!pose) {
+        pose.reset(new CachedPose(model, skin));
+    }
+
+    pose->reset(key, static_cast<float>(key.step) / _steps);
+    pose->last_used(_frame);
+
+    insert_pose(pose);
+    _pending.push_back(pose);
+    return pose;
+}
+
+void PoseCache::keep(const CachedPose::Key& key)
+{
+    const boost::shared_ptr<CachedPose>& cached(_poses[find_pose(key)]);
+    if(cached) {
+        cached->last_used(_frame);
+    }
+}
+
+boost::shared_ptr<CachedPose> PoseCache::recycle(const Model& model, bool skin)
+{
+    std::vector<boost::shared_ptr<CachedPose> >& free(_free[&model]);
+    for(size_t i=0; i<free.size(); ++i) {
+        if(free[i]->skinned() == skin) {
+            boost::shared_ptr<CachedPose> pose(free[i]);
+            free.erase(free.begin() + i);
+            return pose;
+        }
+    }
+
+    std::vector<boost::shared_ptr<CachedPose> >& stale(_stale[&model]);
+    while(!stale.empty()) {
+        boost::shared_ptr<CachedPose> pose(stale.back());
+        stale.pop_back();
+
+        // somebody's already using it this frame
+        if(pose->last_used() >= _frame || pose->skinned() != skin) {
+            continue;
+        }
+
+        erase_pose(pose->key());
+        return pose;
+    }
+
+    return boost::shared_ptr<CachedPose>();
+}
+
+JobSystem::Counter PoseCache::build(JobSystem& jobs)
+{
+    return jobs.parallel_for(_pending.size(), boost::bind(&PoseCache::build_pose, this, _1));
+}
+
+void PoseCache::build_pose(size_t idx)
+{
+    _pending[idx]->build();
+}
+
+size_t PoseCache::find_pose(const CachedPose::Key& key) const
+{
+    const size_t mask = _poses.size() - 1;
+
+    // the table is never full so this always hits an empty slot
+    size_t idx = hash_value(key) & mask;
+    while(_poses[idx] && !(_poses[idx]->key() == key)) {
+        idx = (idx + 1) & mask;
+    }
+    return idx;
+}
+
+void PoseCache::insert_pose(const boost::shared_ptr<CachedPose>& pose)
+{
+    // keep it at most half full so the probes stay short
+    if((_pose_count + 1) * 2 > _poses.size()) {
+        grow_poses();
+    }
+
+    _poses[find_pose(pose->key())] = pose;
+    _pose_count++;
+}
+
+void PoseCache::erase_pose(const CachedPose::Key& key)
+{
+    const size_t mask = _poses.size() - 1;
+
+    size_t hole = find_pose(key);
+    if(!_poses[hole]) {
+        return;
+    }
+    _poses[hole].reset();
+    _pose_count--;
+
+    // shift back the rest of the run into the hole unless that would put
+    // one in front of its home slot, no tombstones to clean up this way
+    size_t idx = (hole + 1) & mask;
+    while(_poses[idx]) {
+        const size_t home = hash_value(_poses[idx]->key()) & mask;
+        if(((idx - home) & mask) >= ((idx - hole) & mask)) {
+            _poses[hole].swap(_poses[idx]);
+            hole = idx;
+        }
+        idx = (idx + 1) & mask;
+    }
+}
+
+void PoseCache::grow_poses()
+{
+    std::vector<boost::shared_ptr<CachedPose> > poses(_poses.size() * 2);
+    _poses.swap(poses);
+
+    BOOST_FOREACH(const boost::shared_ptr<CachedPose>& pose, poses) {
+        if(pose) {
+            _poses[find_pose(pose->key())] = pose;
+        }
+    }
+
+    LOG_DEBUG("Grew the pose table to " << _poses.size() << " slots" << std::endl);
+}
@@ -0,0 +1,163 @@
+#if !defined __POSECACHE_H__
+#define __POSECACHE_H__
+
+#include "JobSystem.h"
+#include "Model.h"
+#include "Renderable.h"
+
+class Animation;
+
+// an interpolated (and optionally skinned) animation frame
+// shared by every actor that lands on it
+class CachedPose
+{
+public:
+    struct Key
+    {
+        const Model* model;
+        const Animation* animation;
+        size_t frame, step;
+
+        // the mesh level that's skinned, always 0 for unskinned poses
+        size_t lod;
+
+        bool operator==(const Key& rhs) const
+        {
+            return model == rhs.model && animation == rhs.animation && frame == rhs.frame && step == rhs.step && lod == rhs.lod;
+        }
+    };
+
+private:
+    // the skinned arrays, the same slots as the Renderable ones
+    enum
+    {
+        BufferCount = Renderable::TextureArray + 1
+    };
+
+public:
+    CachedPose(const Model& model, bool skin);
+    virtual ~CachedPose() throw();
+
+public:
+    const Key& key() const { return _key; }
+    bool skinned() const { return _skin; }
+
+    const Skeleton& skeleton() const { return _skeleton; }
+
+    // NOTE: these are only filled in when the pose is skinned
+    boost::shared_array<Vertex> vertices() const { return _vertices; }
+    const RenderableBuffers& buffers() const { return _buffers; }
+    GLuint vbo(Renderable::RenderableVBO idx) const { return static_cast<int>(idx) < BufferCount ? _vbo[idx] : 0; }
+
+    // only the actors sharing this pose use it
+    uint64_t last_used() const { return _last_used; }
+    void last_used(uint64_t frame) { _last_used = frame; }
+
+    void reset(const Key& key, float frame_percent);
+
+    // interpolates and skins the pose, safe to call from a worker
+    void build();
+
+    // uploads the skinned arrays once per build
+    // NOTE: this has to be called from the render thread
+    void upload();
+
+private:
+    Key _key;
+    float _frame_percent;
+    bool _skin;
+
+    Skeleton _skeleton;
+
+    boost::shared_array<Vertex> _vertices;
+    RenderableBuffers _buffers;
+    GLuint _vbo[BufferCount];
+    bool _uploaded;
+
+    uint64_t _last_used;
+
+private:
+    CachedPose();
+    DISALLOW_COPY_AND_ASSIGN(CachedPose);
+};
+
+std::size_t hash_value(const CachedPose::Key& key);
+
+// poses keyed by (model, animation, frame, quantized frame percent, mesh level)
+// NOTE: every actor has to get its pose for the frame before any are built
+// because the ones nobody has asked for yet get rebuilt for the misses
+class PoseCache
+{
+private:
+    static Logger& logger;
+
+public:
+    // steps is the number of poses per animation frame
+    explicit PoseCache(size_t steps);
+    virtual ~PoseCache() throw();
+
+public:
+    size_t steps() const { return _steps; }
+
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+    double hit_rate() const;
+
+    // drops the poses nobody used last frame
+    void begin_frame();
+
+    // returns the pose for the frame, queueing it to be built if it's new
+    boost::shared_ptr<CachedPose> pose(const Model& model, const Animation& animation, size_t frame, double frame_percent, bool skin, size_t lod);
+
+    // keeps a pose from an earlier frame from being recycled this frame
+    // NOTE: this has to be called before any pose() misses
+    void keep(const CachedPose::Key& key);
+
+    // builds every pose queued since begin_frame() on the workers
+    JobSystem::Counter build(JobSystem& jobs);
+
+private:
+    // a free pose, or one from last frame nobody has used this frame
+    boost::shared_ptr<CachedPose> recycle(const Model& model, bool skin);
+
+    void build_pose(size_t idx);
+
+    // the slot holding the key, or the empty one it would go in
+    size_t find_pose(const CachedPose::Key& key) const;
+    void insert_pose(const boost::shared_ptr<CachedPose>& pose);
+    void erase_pose(const CachedPose::Key& key);
+
+    // doubles the table and reinserts everything
+    void grow_poses();
+
+private:
+    size_t _steps;
+    uint64_t _frame;
+
+    // an open-addressed (linear probing) table keyed by the pose keys
+    // so hits, misses and evictions never allocate nodes once it's grown,
+    // empty slots are null and the size is always a power of two
+    std::vector<boost::shared_ptr<CachedPose> > _poses;
+    size_t _pose_count;
+
+    // the keys begin_frame() drops, kept around for the capacity
+    std::vector<CachedPose::Key> _evicted;
+
+    // evicted poses, reused rather than reallocating their arrays
+    typedef boost::unordered_map<const Model*, std::vector<boost::shared_ptr<CachedPose> > > ModelPoses;
+    ModelPoses _free;
+
+    // last frame's poses, rebuilt for misses before allocating more
+    // so a frame of all misses doesn't keep two frames worth of vertices around
+    ModelPoses _stale;
+
+    std::vector<boost::shared_ptr<CachedPose> > _pending;
+
+    uint64_t _hits, _misses;
+
+private:
+    PoseCache();
+    DISALLOW_COPY_AND_ASSIGN(PoseCache);
+};
+
+#endif
@@ -227,6 +227,9 @@ public:
     virtual void render(const Camera& camera, Shader& shader) const;
     virtual void render(const Camera& camera, Shader& shader, const Light& light) const;
     virtual void render_normals(const Camera& camera) const;
+    virtual bool light_origin(const std::string& name, Position& origin) const { return false; }
+    virtual void link_light(const std::string& name, const Light& light) {}
+    virtual bool render_shadow(Shader& shader, const Light& light) const { return false; }
 
 private:
     void visible_faces(const Camera& camera, std::vector<int>& faces) const;
@@ -28,6 +28,12 @@ public:
 
     explicit Quaternion(const Matrix4& matrix);
 
+    // NOTE: q is (x, y, z, w)
+    explicit Quaternion(const float* const q)
+        : _scalar(q[3]), _vector(q[0], q[1], q[2])
+    {
+    }
+
     virtual ~Quaternion() throw() {}
 
 public:
@@ -1,10 +1,13 @@
 #include "pch.h"
+#include <algorithm>
 #include "common.h"
 #include "Camera.h"
+#include "ClientConfiguration.h"
 #include "Light.h"
 #include "Mesh.h"
 #include "Model.h"
 #include "Plane.h"
+#include "PoseCache.h"
 #include "Renderer.h"
 #include "Shader.h"
 #include "State.h"
@@ -143,23 +146,7 @@ void RenderableBuffers::copy_triangles(const Triangle* const triangles, size_t t
         allocate_buffers(triangle_count, vertex_count);
     }
 
-    // fill the normal/tangent line buffers (for debugging)
-    float *nlb = _normal_line_buffer.get(), *tnlb = _tangent_line_buffer.get();
-    for(size_t i=0; i<vertex_count; ++i) {
-        const Vertex& vertex(vertices[i]);
-
-        const size_t idx = (start * 2 * 3) + i * 2 * 3;
-        const Position& p(vertex.position);
-        const Vector3 &n(vertex.normal), &t(vertex.tangent);
-
-        *(nlb + idx + 0) = p.x(); *(nlb + idx + 3) = p.x() + n.x();
-        *(nlb + idx + 1) = p.y(); *(nlb + idx + 4) = p.y() + n.y();
-        *(nlb + idx + 2) = p.z(); *(nlb + idx + 5) = p.z() + n.z();
-
-        *(tnlb + idx + 0) = p.x(); *(tnlb + idx + 3) = p.x() + t.x();
-        *(tnlb + idx + 1) = p.y(); *(tnlb + idx + 4) = p.y() + t.y();
-        *(tnlb + idx + 2) = p.z(); *(tnlb + idx + 5) = p.z() + t.z();
-    }
+    copy_normal_lines(vertices, vertex_count, start);
 
     // fill the vertex buffers
     float *vb = _vertex_buffer.get(), *nb = _normal_buffer.get(), *tnb = _tangent_buffer.get(), *tb = _texture_buffer.get();
@@ -219,6 +206,82 @@ void RenderableBuffers::copy_triangles(const Triangle* const triangles, size_t t
     }
 }
 
+void RenderableBuffers::copy_normal_lines(const Vertex* const vertices, size_t vertex_count, size_t start)
+{
+    float *nlb = _normal_line_buffer.get(), *tnlb = _tangent_line_buffer.get();
+    for(size_t i=0; i<vertex_count; ++i) {
+        const Vertex& vertex(vertices[i]);
+
+        const size_t idx = (start * 2 * 3) + i * 2 * 3;
+        const Position& p(vertex.position);
+        const Vector3 &n(vertex.normal), &t(vertex.tangent);
+
+        *(nlb + idx + 0) = p.x(); *(nlb + idx + 3) = p.x() + n.x();
+        *(nlb + idx + 1) = p.y(); *(nlb + idx + 4) = p.y() + n.y();
+        *(nlb + idx + 2) = p.z(); *(nlb + idx + 5) = p.z() + n.z();
+
+        *(tnlb + idx + 0) = p.x(); *(tnlb + idx + 3) = p.x() + t.x();
+        *(tnlb + idx + 1) = p.y(); *(tnlb + idx + 4) = p.y() + t.y();
+        *(tnlb + idx + 2) = p.z(); *(tnlb + idx + 5) = p.z() + t.z();
+    }
+}
+
+namespace
+{
+    // the static levels haven't had their planes computed yet
+    const size_t NO_PLANES = static_cast<size_t>(-1);
+
+    // the triangle planes are stored a component per row
+    // so that the facing test can run on four triangles at once
+    enum PlaneRow
+    {
+        PlaneX, PlaneY, PlaneZ, PlaneD,
+        PlaneRowCount
+    };
+
+    // sets a bit for each plane facing the light, count has to be a multiple of 4
+    void compute_facing(const float* const planes, size_t count, const Vector4& light, uint32_t* const facing)
+    {
+        std::fill(facing, facing + ((count + 31) / 32), 0);
+
+#if defined USE_SSE
+        const __m128 lx = _mm_set1_ps(light.x()), ly = _mm_set1_ps(light.y()), lz = _mm_set1_ps(light.z()), lw = _mm_set1_ps(light.w());
+        const __m128 zero = _mm_setzero_ps();
+        for(size_t i=0; i<count; i+=4) {
+            const __m128 x = _mm_loadu_ps(planes + (PlaneX * count) + i);
+            const __m128 y = _mm_loadu_ps(planes + (PlaneY * count) + i);
+            const __m128 z = _mm_loadu_ps(planes + (PlaneZ * count) + i);
+            const __m128 d = _mm_loadu_ps(planes + (PlaneD * count) + i);
+
+            // summed in the same order as Vector::operator*() so the bits match Plane::operator*()
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, lx), _mm_mul_ps(y, ly)), _mm_add_ps(_mm_mul_ps(z, lz), _mm_mul_ps(d, lw)));
+            facing[i >> 5] |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpgt_ps(distance, zero))) << (i & 31);
+        }
+#else
+        for(size_t i=0; i<count; ++i) {
+            const float distance = (*(planes + (PlaneX * count) + i) * light.x())
+                + (*(planes + (PlaneY * count) + i) * light.y())
+                + (*(planes + (PlaneZ * count) + i) * light.z())
+                + (*(planes + (PlaneD * count) + i) * light.w());
+            facing[i >> 5] |= static_cast<uint32_t>(distance > 0.0f) << (i & 31);
+        }
+#endif
+    }
+
+    inline uint32_t faces_light(const uint32_t* const facing, int t)
+    {
+        return (facing[t >> 5] >> (t & 31)) & 1;
+    }
+
+    // two-winged edges are silhouette edges if one triangle faces towards the light and the other way
+    // one-winged edges are only a silhouette edge if the *first* triangle faces the light
+    // the missing triangle never faces the light so that's the same test
+    inline uint32_t is_silhouette_edge(uint32_t faces_light1, uint32_t faces_light2)
+    {
+        return faces_light1 ^ faces_light2;
+    }
+}
+
 uint32_t Renderable::pick_ids = 0;
 
 uint32_t Renderable::next_pick_id()
@@ -227,17 +290,22 @@ uint32_t Renderable::next_pick_id()
 }
 
 Renderable::Renderable(const std::string& name)
-    : Physical(), _name(name), _pick_id(0)
+    : Physical(), _name(name), _shadow_index_slots(0), _shadow_vertices_dirty(false), _vertex_version(0), _plane_count(0), _planes_lod(NO_PLANES), _upload_pending(false),
+        _lod(0), _selected_lod(0), _all_lods(false),
+        _gpu_skinning(false), _vertices_dirty(false), _palette_texture(0), _pick_id(0)
 {
     ZeroMemory(_vbo, sizeof(GLuint) * VBOCount);
     glGenBuffers(VBOCount, _vbo);
 
     ZeroMemory(_shadow_vbo, sizeof(GLuint) * ShadowVBOCount);
     glGenBuffers(ShadowVBOCount, _shadow_vbo);
+
+    glGenTextures(1, &_palette_texture);
 }
 
 Renderable::~Renderable() throw()
 {
+    glDeleteTextures(1, &_palette_texture);
     glDeleteBuffers(ShadowVBOCount, _shadow_vbo);
     glDeleteBuffers(VBOCount, _vbo);
 }
@@ -259,10 +327,80 @@ void Renderable::init()
 void Renderable::model(boost::shared_ptr<Model> model)
 {
     _model = model;
-    _buffers.allocate_buffers(_model->triangle_count() * 3);
+
+    // the bind pose only gets uploaded once when the shaders do the skinning
+    _gpu_skinning = ClientConfiguration::instance().render_skinning_gpu() && !is_static() && _model->has_influences();
+    _vertices_dirty = false;
+    _upload_pending = false;
+
+    // so every level goes up with it
+    _all_lods = is_static() || _gpu_skinning;
+    _lod = _selected_lod = 0;
+
+    // actors pick theirs up each think, statics never move off the bind pose
+    if(is_static()) {
+        bounds(_model->bounds());
+    }
+    _buffers.allocate_buffers((_all_lods ? _model->lod_triangle_count() : _model->triangle_count()) * 3);
 
     _vertices.reset(new Vertex[model->vertex_count()]);
-    calculate_vertices(_model->skeleton());
+    _silhouettes.clear();
+    _shadow_index_slots = 0;
+    vertices_changed();
+    _planes_lod = NO_PLANES;
+    _cached_pose.reset();
+
+    _model->calculate_vertices(_model->skeleton(), _vertices, _buffers);
+    if(_all_lods && _model->lod_count() > 1) {
+        _model->copy_lods(_vertices, _buffers);
+    }
+    upload_buffers();
+    upload_adjacency();
+
+    if(_gpu_skinning) {
+        _palette.resize(_model->joint_count() * Skinning::PALETTE_STRIDE);
+        upload_influences();
+
+        _model->build_palette(_model->skeleton(), &_palette[0]);
+        upload_palette();
+    }
+}
+
+void Renderable::select_lod(const Camera& camera)
+{
+    if(!has_model() || _model->lod_count() < 2) {
+        return;
+    }
+
+    const ClientConfiguration& config(ClientConfiguration::instance());
+
+    const AABB bounds(absolute_bounds());
+    const float distance = bounds.center().distance(camera.position());
+
+    size_t lod = 0;
+    if(distance > bounds.radius()) {
+        const float screen = bounds.radius() / (distance * std::tan(DEG_RAD(config.game_fov()) * 0.5f));
+
+        // each level is used below half the screen size of the one before it
+        // and going back up has to clear the threshold by the hysteresis
+        // so that something sitting right on it doesn't flicker between them
+        float threshold = config.render_lod_screen_size();
+        while(lod + 1 < _model->lod_count()) {
+            const float scale = lod < _selected_lod ? 1.0f + config.render_lod_hysteresis() : 1.0f;
+            if(screen >= threshold * scale) {
+                break;
+            }
+
+            lod++;
+            threshold *= 0.5f;
+        }
+    }
+    _selected_lod = lod;
+
+    // the CPU-skinned levels change when they're skinned
+    if(_all_lods) {
+        _lod = _selected_lod;
+    }
 }
 
 bool Renderable::load_material()
@@ -273,148 +411,294 @@ bool Renderable::load_material()
     return true;
 }
 
-size_t Renderable::compute_silhouette(const Light& light)
+void Renderable::compute_silhouettes(const Lights& lights, const LightMask& light_mask)
 {
+    update_vertices();
+
     Matrix4 matrix;
     transform(matrix);
 
-    // allocate enough space for every edge
-    const size_t vsize = model().edge_count() * 4 * 4;
-    boost::shared_array<float> varray(new float[vsize]);
+    const size_t lod = shadow_lod();
+    bool planes = false;
 
-    size_t vcount = 0;
-    if(typeid(light) == typeid(DirectionalLight)) {
-        const DirectionalLight& directional(dynamic_cast<const DirectionalLight&>(light));
-        vcount = compute_silhouette_directional(-matrix * directional.direction(), varray);
-    } else if(typeid(light) == typeid(PositionalLight) || typeid(light) == typeid(SpotLight)) {
-        const PositionalLight& positional(dynamic_cast<const PositionalLight&>(light));
-        vcount = compute_silhouette_positional(-matrix * positional.position().homogeneous_position(), varray);
+    _silhouettes.resize(lights.size());
+    for(size_t i=0; i<lights.size(); ++i) {
+        const Light& light(*lights[i]);
+
+        Silhouette& silhouette(_silhouettes[i]);
+        if(!light.enabled()) {
+            silhouette.icount = 0;
+            silhouette.light = NULL;
+            silhouette.cached = false;
+            continue;
+        }
+
+        // the light can't see our shadow
+        if(!light_mask.test(i)) {
+            continue;
+        }
+
+        // nothing it was found with has changed since the last time
+        silhouette.cached = silhouette.light == &light && silhouette.lod == lod
+            && silhouette.transform_version == transform_version()
+            && silhouette.light_version == light.transform_version()
+            && silhouette.vertex_version == _vertex_version;
+        if(silhouette.cached) {
+            continue;
+        }
+
+        silhouette.light = &light;
+        silhouette.lod = lod;
+        silhouette.transform_version = transform_version();
+        silhouette.light_version = light.transform_version();
+        silhouette.vertex_version = _vertex_version;
+        silhouette.uploaded = false;
+
+        if(!planes) {
+            compute_triangle_planes(lod);
+            if(_shadow_vertices_dirty) {
+                compute_shadow_vertices();
+            }
+            planes = true;
+        }
+
+        // allocate enough space for every edge of any level
+        // the sweep writes every edge so this has to hold all of them
+        if(!silhouette.indices) {
+            silhouette.indices.reset(new uint32_t[model().max_edge_count() * 6]);
+        }
+
+        if(typeid(light) == typeid(DirectionalLight)) {
+            const DirectionalLight& directional(dynamic_cast<const DirectionalLight&>(light));
+            compute_facing(&_triangle_planes[0], _plane_count, -matrix * directional.direction(), &_facing[0]);
+            silhouette.icount = short_shadow_indices()
+                ? compute_silhouette_directional(lod, reinterpret_cast<uint16_t*>(silhouette.indices.get()))
+                : compute_silhouette_directional(lod, silhouette.indices.get());
+        } else if(typeid(light) == typeid(PositionalLight) || typeid(light) == typeid(SpotLight)) {
+            const PositionalLight& positional(dynamic_cast<const PositionalLight&>(light));
+            compute_facing(&_triangle_planes[0], _plane_count, -matrix * positional.position().homogeneous_position(), &_facing[0]);
+            silhouette.icount = short_shadow_indices()
+                ? compute_silhouette_positional(lod, reinterpret_cast<uint16_t*>(silhouette.indices.get()))
+                : compute_silhouette_positional(lod, silhouette.indices.get());
+        }
     }
+}
+
+bool Renderable::silhouette_cached(size_t idx) const
+{
+    return idx < _silhouettes.size() && _silhouettes[idx].cached;
+}
+
+const void* Renderable::silhouette_indices(size_t idx) const
+{
+    return idx < _silhouettes.size() ? _silhouettes[idx].indices.get() : NULL;
+}
+
+size_t Renderable::silhouette_index_count(size_t idx) const
+{
+    return idx < _silhouettes.size() ? _silhouettes[idx].icount : 0;
+}
 
-    if(0 == vcount) {
+size_t Renderable::upload_silhouette(size_t idx)
+{
+    if(idx >= _silhouettes.size() || 0 == _silhouettes[idx].icount) {
         return 0;
     }
+    Silhouette& silhouette(_silhouettes[idx]);
 
-    // setup the vertex array
-    glBindBuffer(GL_ARRAY_BUFFER, _shadow_vbo[ShadowVertexArray]);
-    glBufferData(GL_ARRAY_BUFFER, vcount * 4 * sizeof(float), varray.get(), GL_DYNAMIC_DRAW);
+    // setup the vertex array, this only changes when we're skinned
+    if(_shadow_vertices_dirty) {
+        glBindBuffer(GL_ARRAY_BUFFER, _shadow_vbo[ShadowVertexArray]);
+        glBufferData(GL_ARRAY_BUFFER, _shadow_vertices.size() * sizeof(float), &_shadow_vertices[0], is_static() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+        _shadow_vertices_dirty = false;
+    }
+
+    // each light gets its own slot in the index array
+    // resizing it loses what was in the others
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _shadow_vbo[ShadowIndexArray]);
+    if(_shadow_index_slots != _silhouettes.size()) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, _silhouettes.size() * shadow_index_stride(), NULL, GL_DYNAMIC_DRAW);
+        _shadow_index_slots = _silhouettes.size();
+
+        for(size_t i=0; i<_silhouettes.size(); ++i) {
+            _silhouettes[i].uploaded = false;
+        }
+    }
+
+    // cached silhouettes are still in their slot
+    if(!silhouette.uploaded) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, idx * shadow_index_stride(),
+            silhouette.icount * (short_shadow_indices() ? sizeof(uint16_t) : sizeof(uint32_t)), silhouette.indices.get());
+        silhouette.uploaded = true;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    return vcount;
+    return silhouette.icount;
 }
 
-bool Renderable::is_silhouette_edge(const Mesh& mesh, const Edge& edge, const Vector4& light_position, size_t vstart, bool& faces_light1) const
+size_t Renderable::shadow_index_stride() const
 {
-    Plane p1;
-    if(edge.t1 >= 0) {
-        const Triangle& t(mesh.triangle(edge.t1));
-        p1 = Plane(vertex(vstart + t.v1).position, vertex(vstart + t.v2).position, vertex(vstart + t.v3).position);
+    return model().max_edge_count() * 6 * (short_shadow_indices() ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+void Renderable::vertices_changed()
+{
+    _shadow_vertices_dirty = true;
+    _vertex_version++;
+}
+
+bool Renderable::short_shadow_indices() const
+{
+    return _model->vertex_count() * 2 <= 0x10000;
+}
+
+void Renderable::compute_shadow_vertices()
+{
+    const size_t vcount = _model->vertex_count();
+    _shadow_vertices.resize(vcount * 2 * 4);
+
+    float* const v = &_shadow_vertices[0];
+    for(size_t i=0; i<vcount; ++i) {
+        const Position& p(vertex(i).position);
+
+        const size_t idx = i * 4;
+        *(v + idx + 0) = p.x();
+        *(v + idx + 1) = p.y();
+        *(v + idx + 2) = p.z();
+        *(v + idx + 3) = 1.0f;
+
+        // the copy at infinity
+        const size_t iidx = (vcount + i) * 4;
+        *(v + iidx + 0) = p.x();
+        *(v + iidx + 1) = p.y();
+        *(v + iidx + 2) = p.z();
+        *(v + iidx + 3) = 0.0f;
     }
+}
 
-    Plane p2;
-    if(edge.t2 >= 0) {
-        const Triangle& t(mesh.triangle(edge.t2));
-        p2 = Plane(vertex(vstart + t.v1).position, vertex(vstart + t.v2).position, vertex(vstart + t.v3).position);
+void Renderable::compute_triangle_planes(size_t lod)
+{
+    // static levels never move so their planes only need computing once
+    if(is_static() && lod == _planes_lod) {
+        return;
     }
+    _planes_lod = lod;
 
-    // sort out which of the edges, if any, are facing the light
-    faces_light1 = p1 * light_position > 0.0f;
-    const bool faces_light2 = p2 * light_position > 0.0f;
+    // padded out to whole SSE registers
+    const size_t tcount = _model->triangle_count(lod);
+    _plane_count = (tcount + 1 + 3) & ~static_cast<size_t>(3);
+    _triangle_planes.resize(_plane_count * PlaneRowCount);
+    _facing.resize((_plane_count + 31) / 32);
 
-    // two-winged edges are silhouette edges if one triangle faces towards the light and the other way
-    return ((edge.t1 >= 0 && edge.t2 >= 0 && ((faces_light1 && !faces_light2) || (!faces_light1 && faces_light2)))
-        // one-winged edges are only a silhouette edge if the *first* triangle faces the light
-        || ((edge.t1 < 0 || edge.t2 < 0) && faces_light1));
+    float* const planes = &_triangle_planes[0];
+    size_t vstart = 0, t = 0;
+    for(size_t i=0; i<model().mesh_count(); ++i) {
+        const Mesh& mesh(model().mesh(i));
+
+        for(int j=0; j<mesh.triangle_count(lod); ++j, ++t) {
+            const Triangle& triangle(mesh.triangle(lod, j));
+            const Plane plane(vertex(vstart + triangle.v1).position, vertex(vstart + triangle.v2).position, vertex(vstart + triangle.v3).position);
+
+            const Vector3 normal(plane.normal());
+            *(planes + (PlaneX * _plane_count) + t) = normal.x();
+            *(planes + (PlaneY * _plane_count) + t) = normal.y();
+            *(planes + (PlaneZ * _plane_count) + t) = normal.z();
+            *(planes + (PlaneD * _plane_count) + t) = plane.distance();
+        }
+        vstart += mesh.vertex_count();
+    }
+
+    // the padding never faces the light
+    for(size_t i=0; i<PlaneRowCount; ++i) {
+        std::fill(planes + (i * _plane_count) + tcount, planes + ((i + 1) * _plane_count), 0.0f);
+    }
 }
 
-size_t Renderable::compute_silhouette_directional(const Direction& light_direction, boost::shared_array<float> varray)
+template<typename Index>
+size_t Renderable::compute_silhouette_directional(size_t lod, Index* const indices) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3
+    const uint32_t* const facing = &_facing[0];
+    const int missing = static_cast<int>(_model->triangle_count(lod));
+    const size_t infinity = _model->vertex_count();
+
     size_t vstart = 0, ecount = 0;
-    float *v = varray.get();
+    int tstart = 0;
     for(size_t i=0; i<model().mesh_count(); ++i) {
         const Mesh& mesh(model().mesh(i));
 
-        for(size_t j=0; j<mesh.edge_count(); ++j) {
-            const Edge& edge(mesh.edge(j));
+        for(size_t j=0; j<mesh.edge_count(lod); ++j) {
+            const Edge& edge(mesh.edge(lod, j));
 
-            bool faces_light1;
-            if(is_silhouette_edge(mesh, edge, light_direction, vstart, faces_light1)) {
-                const Vertex& v1(vertex(vstart + (faces_light1 ? edge.v2 : edge.v1)));
-                const Vertex& v2(vertex(vstart + (faces_light1 ? edge.v1 : edge.v2)));
+            // the first triangle is always there, it's the one that added the edge
+            const uint32_t faces_light1 = faces_light(facing, tstart + edge.t1);
+            const uint32_t faces_light2 = faces_light(facing, edge.t2 >= 0 ? tstart + edge.t2 : missing);
 
-                const size_t idx = ecount * 3 * 4;
+            const int ends[2] = { edge.v1, edge.v2 };
+            const size_t v1 = vstart + ends[faces_light1];
+            const size_t v2 = vstart + ends[faces_light1 ^ 1];
 
-                *(v + idx + 0) = v1.position.x();
-                *(v + idx + 1) = v1.position.y();
-                *(v + idx + 2) = v1.position.z();
-                *(v + idx + 3) = 1.0f;
+            // every edge gets written but only the silhouette edges are kept
+            Index* const idx = indices + (ecount * 3);
 
-                *(v + idx + 4) = v2.position.x();
-                *(v + idx + 5) = v2.position.y();
-                *(v + idx + 6) = v2.position.z();
-                *(v + idx + 7) = 1.0f;
+            *(idx + 0) = static_cast<Index>(v1);
+            *(idx + 1) = static_cast<Index>(v2);
 
-                // third vertex is at infinity
-                *(v + idx + 8) = 0.0f;
-                *(v + idx + 9) = 0.0f;
-                *(v + idx + 10) = 0.0f;
-                *(v + idx + 11) = 0.0f;
+            // third vertex is at infinity
+            *(idx + 2) = static_cast<Index>(v1 + infinity);
 
-                ecount++;
-            }
+            ecount += is_silhouette_edge(faces_light1, faces_light2);
         }
         vstart += mesh.vertex_count();
+        tstart += mesh.triangle_count(lod);
     }
 
     return ecount * 3;
 }
 
-size_t Renderable::compute_silhouette_positional(const Position& light_position, boost::shared_array<float> varray)
+template<typename Index>
+size_t Renderable::compute_silhouette_positional(size_t lod, Index* const indices) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3
+    const uint32_t* const facing = &_facing[0];
+    const int missing = static_cast<int>(_model->triangle_count(lod));
+    const size_t infinity = _model->vertex_count();
+
     size_t vstart = 0, ecount = 0;
-    float *v = varray.get();
+    int tstart = 0;
     for(size_t i=0; i<model().mesh_count(); ++i) {
         const Mesh& mesh(model().mesh(i));
 
-        for(size_t j=0; j<mesh.edge_count(); ++j) {
-            const Edge& edge(mesh.edge(j));
+        for(size_t j=0; j<mesh.edge_count(lod); ++j) {
+            const Edge& edge(mesh.edge(lod, j));
 
-            bool faces_light1;
-            if(is_silhouette_edge(mesh, edge, light_position, vstart, faces_light1)) {
-                const Vertex& v1(vertex(vstart + (faces_light1 ? edge.v2 : edge.v1)));
-                const Vertex& v2(vertex(vstart + (faces_light1 ? edge.v1 : edge.v2)));
+            // the first triangle is always there, it's the one that added the edge
+            const uint32_t faces_light1 = faces_light(facing, tstart + edge.t1);
+            const uint32_t faces_light2 = faces_light(facing, edge.t2 >= 0 ? tstart + edge.t2 : missing);
 
-                const size_t idx = ecount * 4 * 4;
+            const int ends[2] = { edge.v1, edge.v2 };
+            const size_t v1 = vstart + ends[faces_light1];
+            const size_t v2 = vstart + ends[faces_light1 ^ 1];
 
-                *(v + idx + 0) = v1.position.x();
-                *(v + idx + 1) = v1.position.y();
-                *(v + idx + 2) = v1.position.z();
-                *(v + idx + 3) = 1.0f;
+            // every edge gets written but only the silhouette edges are kept
+            Index* const idx = indices + (ecount * 6);
 
-                *(v + idx + 4) = v2.position.x();
-                *(v + idx + 5) = v2.position.y();
-                *(v + idx + 6) = v2.position.z();
-                *(v + idx + 7) = 1.0f;
+            // the quad (v1, v2, v2 at infinity, v1 at infinity) as two triangles
+            *(idx + 0) = static_cast<Index>(v1);
+            *(idx + 1) = static_cast<Index>(v2);
+            *(idx + 2) = static_cast<Index>(v2 + infinity);
 
-                // last two vertices are at infinity
-                *(v + idx + 8) = v2.position.x();
-                *(v + idx + 9) = v2.position.y();
-                *(v + idx + 10) = v2.position.z();
-                *(v + idx + 11) = 0.0f;
+            *(idx + 3) = static_cast<Index>(v1);
+            *(idx + 4) = static_cast<Index>(v2 + infinity);
+            *(idx + 5) = static_cast<Index>(v1 + infinity);
 
-                *(v + idx + 12) = v1.position.x();
-                *(v + idx + 13) = v1.position.y();
-                *(v + idx + 14) = v1.position.z();
-                *(v + idx + 15) = 0.0f;
-
-                ecount++;
-            }
+            ecount += is_silhouette_edge(faces_light1, faces_light2);
         }
         vstart += mesh.vertex_count();
+        tstart += mesh.triangle_count(lod);
     }
 
-    return ecount * 4;
+    return ecount * 6;
 }
 
 void Renderable::render(Shader& shader) const
@@ -428,11 +712,11 @@ void Renderable::render(Shader& shader) const
     Renderer::instance().init_shader_matrices(shader);
 
     // render the meshes
-    size_t tcount = 0;
+    size_t tcount = lod_start();
     for(size_t i=0; i<model().mesh_count(); ++i) {
         const Mesh& mesh(model().mesh(i));
-        render_mesh(mesh, tcount, shader);
-        tcount += mesh.triangle_count();
+        render_mesh(mesh, tcount, mesh.triangle_count(_lod), shader);
+        tcount += mesh.triangle_count(_lod);
     }
 
     Renderer::instance().pop_model_matrix();
@@ -450,17 +734,17 @@ void Renderable::render(Shader& shader, const Light& light, const Camera& camera
     Renderer::instance().init_shader_light(shader, material(), light, camera);
 
     // render the meshes
-    size_t tcount = 0;
+    size_t tcount = lod_start();
     for(size_t i=0; i<model().mesh_count(); ++i) {
         const Mesh& mesh(model().mesh(i));
-        render_mesh(mesh, tcount, shader);
-        tcount += mesh.triangle_count();
+        render_mesh(mesh, tcount, mesh.triangle_count(_lod), shader);
+        tcount += mesh.triangle_count(_lod);
     }
 
     Renderer::instance().pop_model_matrix();
 }
 
-void Renderable::render_shadow(Shader& shader, const Light& light, const Camera& camera, size_t vcount, bool cap) const
+void Renderable::render_shadow(Shader& shader, const Light& light, const Camera& camera, size_t idx, bool cap) const
 {
     Matrix4 matrix;
     transform(matrix);
@@ -474,11 +758,64 @@ void Renderable::render_shadow(Shader& shader, const Light& light, const Camera&
     Renderer::instance().init_shader_light(shader, Material(), light, camera);
 
     if(typeid(light) == typeid(DirectionalLight)) {
-        render_shadow_directional(shader, dynamic_cast<const DirectionalLight&>(light), vcount);
+        render_shadow_directional(shader, dynamic_cast<const DirectionalLight&>(light), idx);
+    } else if(typeid(light) == typeid(PositionalLight) || typeid(light) == typeid(SpotLight)) {
+        render_shadow_positional(shader, dynamic_cast<const PositionalLight&>(light), idx, cap);
+    }
+
+    shader.end();
+
+    Renderer::instance().pop_model_matrix();
+}
+
+void Renderable::render_shadow_volume(Shader& shader, const Light& light, bool cap) const
+{
+    Matrix4 matrix;
+    transform(matrix);
+
+    Renderer::instance().push_model_matrix();
+    Renderer::instance().multiply_model_matrix(matrix);
+
+    shader.begin();
+
+    Renderer::instance().init_shader_matrices(shader);
+    shader.uniform1i("cap", cap);
+
+    // the same object-space light the silhouettes are found with
+    if(typeid(light) == typeid(DirectionalLight)) {
+        const DirectionalLight& directional(dynamic_cast<const DirectionalLight&>(light));
+        shader.uniform4f("object_light", -matrix * directional.direction());
     } else if(typeid(light) == typeid(PositionalLight) || typeid(light) == typeid(SpotLight)) {
-        render_shadow_positional(shader, dynamic_cast<const PositionalLight&>(light), vcount, cap);
+        const PositionalLight& positional(dynamic_cast<const PositionalLight&>(light));
+        shader.uniform4f("object_light", -matrix * positional.position().homogeneous_position());
     }
 
+    // the CPU-skinned buffers only hold the level that was skinned
+    const size_t lod = _all_lods ? shadow_lod() : _lod;
+    const size_t base = _all_lods ? _model->lod_start(lod) : 0;
+
+    // get the attribute locations
+    GLint vloc = shader.attrib_location("vertex");
+
+    // render the volume
+    glEnableVertexAttribArray(vloc);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo(VertexArray));
+        glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        if(_gpu_skinning) {
+            enable_skinning(shader);
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _shadow_vbo[ShadowAdjacencyArray]);
+        glDrawElementsBaseVertex(GL_TRIANGLES_ADJACENCY, _model->triangle_count(lod) * 6, GL_UNSIGNED_INT,
+            BUFFER_OFFSET(_model->lod_start(lod) * 6 * sizeof(uint32_t)), base * 3);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        if(_gpu_skinning) {
+            disable_skinning(shader);
+        }
+    glDisableVertexAttribArray(vloc);
+
     shader.end();
 
     Renderer::instance().pop_model_matrix();
@@ -493,6 +830,7 @@ void Renderable::render_unlit(const Camera& camera)
     Renderer::instance().multiply_model_matrix(matrix);
 
     if(State::instance().render_normals()) {
+        update_vertices();
         render_normals();
     }
 
@@ -505,7 +843,7 @@ void Renderable::render_unlit(const Camera& camera)
     on_render_unlit(camera);
 }
 
-void Renderable::render_shadow_directional(Shader& shader, const DirectionalLight& light, size_t vcount) const
+void Renderable::render_shadow_directional(Shader& shader, const DirectionalLight& light, size_t idx) const
 {
     // get the attribute locations
     GLint vloc = shader.attrib_location("vertex");
@@ -515,11 +853,14 @@ void Renderable::render_shadow_directional(Shader& shader, const DirectionalLigh
         glBindBuffer(GL_ARRAY_BUFFER, _shadow_vbo[ShadowVertexArray]);
         glVertexAttribPointer(vloc, 4, GL_FLOAT, GL_FALSE, 0, 0);
 
-        glDrawArrays(GL_TRIANGLES, 0, vcount);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _shadow_vbo[ShadowIndexArray]);
+        glDrawElements(GL_TRIANGLES, _silhouettes[idx].icount, short_shadow_indices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+            BUFFER_OFFSET(idx * shadow_index_stride()));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glDisableVertexAttribArray(vloc);
 }
 
-void Renderable::render_shadow_positional(Shader& shader, const PositionalLight& light, size_t vcount, bool cap) const
+void Renderable::render_shadow_positional(Shader& shader, const PositionalLight& light, size_t idx, bool cap) const
 {
     shader.uniform1i("cap", cap);
 
@@ -531,11 +872,14 @@ void Renderable::render_shadow_positional(Shader& shader, const PositionalLight&
         glBindBuffer(GL_ARRAY_BUFFER, _shadow_vbo[ShadowVertexArray]);
         glVertexAttribPointer(vloc, 4, GL_FLOAT, GL_FALSE, 0, 0);
 
-        glDrawArrays(GL_QUADS, 0, vcount);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _shadow_vbo[ShadowIndexArray]);
+        glDrawElements(GL_TRIANGLES, _silhouettes[idx].icount, short_shadow_indices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+            BUFFER_OFFSET(idx * shadow_index_stride()));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glDisableVertexAttribArray(vloc);
 }
 
-void Renderable::render_mesh(const Mesh& mesh, size_t start, Shader& shader) const
+void Renderable::render_mesh(const Mesh& mesh, size_t start, size_t count, Shader& shader) const
 {
     // setup the detail texture
     glActiveTexture(GL_TEXTURE0);
@@ -568,19 +912,23 @@ void Renderable::render_mesh(const Mesh& mesh, size_t start, Shader& shader) con
     glEnableVertexAttribArray(nloc);
     glEnableVertexAttribArray(tnloc);
     glEnableVertexAttribArray(tloc);
-        glBindBuffer(GL_ARRAY_BUFFER, _vbo[TextureArray]);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo(TextureArray));
         glVertexAttribPointer(tloc, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, _vbo[NormalArray]);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo(NormalArray));
         glVertexAttribPointer(nloc, 3, GL_FLOAT, GL_TRUE, 0, 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, _vbo[TangentArray]);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo(TangentArray));
         glVertexAttribPointer(tnloc, 4, GL_FLOAT, GL_TRUE, 0, 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, _vbo[VertexArray]);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo(VertexArray));
         glVertexAttribPointer(vloc, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-        glDrawArrays(GL_TRIANGLES, start * 3, mesh.triangle_count() * 3);
+        if(_gpu_skinning) {
+            render_skinned(shader, start * 3, count * 3);
+        } else {
+            glDrawArrays(GL_TRIANGLES, start * 3, count * 3);
+        }
     glDisableVertexAttribArray(tloc);
     glDisableVertexAttribArray(tnloc);
     glDisableVertexAttribArray(nloc);
@@ -605,12 +953,12 @@ void Renderable::render_normals(const Mesh& mesh, size_t start) const
     // setup the normal line array
     glBindBuffer(GL_ARRAY_BUFFER, _vbo[NormalLineArray]);
     glBufferData(GL_ARRAY_BUFFER, mesh.vertex_count() * 2 * 3 * sizeof(float),
-        _buffers.normal_line_buffer().get() + vstart, GL_DYNAMIC_DRAW);
+        buffers().normal_line_buffer().get() + vstart, GL_DYNAMIC_DRAW);
 
     // setup the tangent line array
     glBindBuffer(GL_ARRAY_BUFFER, _vbo[TangentLineArray]);
     glBufferData(GL_ARRAY_BUFFER, mesh.vertex_count() * 2 * 3 * sizeof(float),
-        _buffers.tangent_line_buffer().get() + vstart, GL_DYNAMIC_DRAW);
+        buffers().tangent_line_buffer().get() + vstart, GL_DYNAMIC_DRAW);
 
     // render the normals
     Shader& rshader(State::instance().red_shader());
@@ -649,27 +997,229 @@ void Renderable::render_normals(const Mesh& mesh, size_t start) const
     gshader.end();
 }
 
+void Renderable::render_skinned(Shader& shader, size_t start, size_t count) const
+{
+    enable_skinning(shader);
+        glDrawArrays(GL_TRIANGLES, start, count);
+    disable_skinning(shader);
+}
+
+void Renderable::enable_skinning(Shader& shader) const
+{
+    // setup the palette
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_BUFFER, _palette_texture);
+    shader.uniform1i("palette", 4);
+
+    // get the attribute locations
+    GLint jloc = shader.attrib_location("joints");
+    GLint wloc = shader.attrib_location("weights");
+
+    glEnableVertexAttribArray(jloc);
+    glEnableVertexAttribArray(wloc);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo[JointArray]);
+    glVertexAttribIPointer(jloc, Skinning::MAX_INFLUENCES, GL_UNSIGNED_BYTE, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo[WeightArray]);
+    glVertexAttribPointer(wloc, Skinning::MAX_INFLUENCES, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+void Renderable::disable_skinning(Shader& shader) const
+{
+    glDisableVertexAttribArray(shader.attrib_location("weights"));
+    glDisableVertexAttribArray(shader.attrib_location("joints"));
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Renderable::commit_vertices()
+{
+    if(!_upload_pending) {
+        return;
+    }
+
+    if(_cached_pose) {
+        if(_gpu_skinning) {
+            // the palette is cheap enough to build here
+            _model->build_palette(_cached_pose->skeleton(), &_palette[0]);
+            _vertices_dirty = true;
+            upload_palette();
+        } else {
+            // only the first actor on the pose actually uploads
+            _cached_pose->upload();
+        }
+    } else if(_gpu_skinning) {
+        upload_palette();
+    } else {
+        upload_buffers();
+    }
+    _upload_pending = false;
+}
+
+void Renderable::share_pose(boost::shared_ptr<CachedPose> pose)
+{
+    _cached_pose = pose;
+    if(!_gpu_skinning) {
+        _vertices = pose->vertices();
+        _lod = pose->key().lod;
+        vertices_changed();
+    }
+    _upload_pending = true;
+}
+
 void Renderable::calculate_vertices(const Skeleton& skeleton)
 {
-    _model->calculate_vertices(skeleton, _vertices, _buffers);
+    // back to our own vertices
+    if(_cached_pose) {
+        if(!_gpu_skinning) {
+            _vertices.reset(new Vertex[_model->vertex_count()]);
+        }
+        _cached_pose.reset();
+    }
+
+    if(_gpu_skinning) {
+        _model->build_palette(skeleton, &_palette[0]);
+        _vertices_dirty = true;
+    } else {
+        _lod = _selected_lod;
+        _model->calculate_vertices(skeleton, _vertices, _buffers, Skinning::kernel(), _lod);
+        vertices_changed();
+    }
+    _upload_pending = true;
+}
+
+const Skeleton& Renderable::pose() const
+{
+    return _model->skeleton();
+}
+
+size_t Renderable::lod_start() const
+{
+    return _all_lods ? _model->lod_start(_lod) : 0;
+}
+
+size_t Renderable::shadow_lod() const
+{
+    const size_t bias = static_cast<size_t>(ClientConfiguration::instance().render_shadow_lod_bias());
+    return std::min(_lod + bias, _model->lod_count() - 1);
+}
+
+void Renderable::upload_buffers()
+{
+    upload_buffers(_buffers, _vbo, is_static() || _gpu_skinning ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+}
 
+void Renderable::upload_buffers(const RenderableBuffers& buffers, const GLuint* const vbo, GLenum usage)
+{
     // setup the vertex array
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo[VertexArray]);
-    glBufferData(GL_ARRAY_BUFFER, _buffers.vertex_buffer_size() * sizeof(float),
-        _buffers.vertex_buffer().get(), is_static() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[VertexArray]);
+    glBufferData(GL_ARRAY_BUFFER, buffers.vertex_buffer_size() * sizeof(float),
+        buffers.vertex_buffer().get(), usage);
 
     // setup the normal array
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo[NormalArray]);
-    glBufferData(GL_ARRAY_BUFFER, _buffers.normal_buffer_size() * sizeof(float),
-        _buffers.normal_buffer().get(), is_static() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[NormalArray]);
+    glBufferData(GL_ARRAY_BUFFER, buffers.normal_buffer_size() * sizeof(float),
+        buffers.normal_buffer().get(), usage);
 
     // setup the tangent array
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo[TangentArray]);
-    glBufferData(GL_ARRAY_BUFFER, _buffers.tangent_buffer_size() * sizeof(float),
-        _buffers.tangent_buffer().get(), is_static() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[TangentArray]);
+    glBufferData(GL_ARRAY_BUFFER, buffers.tangent_buffer_size() * sizeof(float),
+        buffers.tangent_buffer().get(), usage);
 
     // setup the texture array
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo[TextureArray]);
-    glBufferData(GL_ARRAY_BUFFER, _buffers.texture_buffer_size() * sizeof(float),
-        _buffers.texture_buffer().get(), is_static() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[TextureArray]);
+    glBufferData(GL_ARRAY_BUFFER, buffers.texture_buffer_size() * sizeof(float),
+        buffers.texture_buffer().get(), usage);
+}
+
+GLuint Renderable::vbo(RenderableVBO idx) const
+{
+    if(_cached_pose && _cached_pose->skinned()) {
+        const GLuint shared = _cached_pose->vbo(idx);
+        if(0 != shared) {
+            return shared;
+        }
+    }
+    return _vbo[idx];
+}
+
+const RenderableBuffers& Renderable::buffers() const
+{
+    return _cached_pose && _cached_pose->skinned() ? _cached_pose->buffers() : _buffers;
+}
+
+void Renderable::upload_influences()
+{
+    // expand the influences the same way the triangles are, every level back to back
+    const size_t vcount = _model->lod_triangle_count() * 3;
+    boost::scoped_array<uint8_t> joints(new uint8_t[vcount * Skinning::MAX_INFLUENCES]);
+    boost::scoped_array<float> weights(new float[vcount * Skinning::MAX_INFLUENCES]);
+
+    size_t idx = 0;
+    for(size_t lod=0; lod<_model->lod_count(); ++lod) {
+        for(size_t i=0; i<_model->mesh_count(); ++i) {
+            const Mesh& mesh(_model->mesh(i));
+            const Skinning& skinning(mesh.skinning());
+
+            for(int j=0; j<mesh.triangle_count(lod); ++j) {
+                const Triangle& triangle(mesh.triangle(lod, j));
+
+                const int v[3] = { triangle.v1, triangle.v2, triangle.v3 };
+                for(int k=0; k<3; ++k, ++idx) {
+                    const Skinning::Influence& influence(skinning.influence(v[k]));
+                    std::memcpy(joints.get() + (idx * Skinning::MAX_INFLUENCES), influence.joint, sizeof(influence.joint));
+                    std::memcpy(weights.get() + (idx * Skinning::MAX_INFLUENCES), influence.weight, sizeof(influence.weight));
+                }
+            }
+        }
+    }
+
+    // setup the joint array
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo[JointArray]);
+    glBufferData(GL_ARRAY_BUFFER, vcount * Skinning::MAX_INFLUENCES * sizeof(uint8_t), joints.get(), GL_STATIC_DRAW);
+
+    // setup the weight array
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo[WeightArray]);
+    glBufferData(GL_ARRAY_BUFFER, vcount * Skinning::MAX_INFLUENCES * sizeof(float), weights.get(), GL_STATIC_DRAW);
+
+    // the palette texture reads straight from its buffer
+    glBindBuffer(GL_TEXTURE_BUFFER, _vbo[PaletteArray]);
+    glBufferData(GL_TEXTURE_BUFFER, _palette.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+
+    glBindTexture(GL_TEXTURE_BUFFER, _palette_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _vbo[PaletteArray]);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderable::upload_adjacency()
+{
+    // every level, the CPU-skinned draws rebase it to the one that was skinned
+    const size_t icount = _model->lod_triangle_count() * 6;
+    boost::scoped_array<uint32_t> indices(new uint32_t[icount]);
+    _model->copy_adjacency(indices.get());
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _shadow_vbo[ShadowAdjacencyArray]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, icount * sizeof(uint32_t), indices.get(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Renderable::upload_palette()
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, _vbo[PaletteArray]);
+    glBufferData(GL_TEXTURE_BUFFER, _palette.size() * sizeof(float), &_palette[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderable::update_vertices()
+{
+    if(!_vertices_dirty) {
+        return;
+    }
+
+    // use the same approximation the shaders do so shadows match the surface
+    // the buffers hold the bind pose the shaders skin so they're left alone
+    _model->skin_vertices(pose(), _vertices, Skinning::PaletteKernel);
+    _vertices_dirty = false;
+    vertices_changed();
 }
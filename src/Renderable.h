@@ -1,10 +1,12 @@
 #if !defined __RENDERABLE_H__
 #define __RENDERABLE_H__
 
+#include "Map.h"
 #include "Material.h"
 #include "Mesh.h"
 #include "Physical.h"
 
+class CachedPose;
 class Camera;
 class Light;
 class DirectionalLight;
@@ -51,6 +53,9 @@ public:
     void copy_vertices(const Vertex* const vertices, size_t vertex_count, size_t start=0, bool allocate=false);
     void copy_triangles(const Triangle* const triangles, size_t triangle_count, const Vertex* const vertices, size_t vertex_count, size_t start=0, bool allocate=false);
 
+    // fills the normal/tangent line buffers (for debugging)
+    void copy_normal_lines(const Vertex* const vertices, size_t vertex_count, size_t start=0);
+
 private:
     size_t _vcount;
 
@@ -79,6 +84,8 @@ public:
     enum RenderableShadowVBO
     {
         ShadowVertexArray,
+        ShadowIndexArray,
+        ShadowAdjacencyArray,
         ShadowVBOCount
     };
 
@@ -90,6 +97,9 @@ public:
         TangentArray,
         TangentLineArray,
         TextureArray,
+        JointArray,
+        WeightArray,
+        PaletteArray,
         VBOCount
     };
 
@@ -99,6 +109,10 @@ private:
 private:
     static uint32_t next_pick_id();
 
+public:
+    // uploads the vertex, normal, tangent and texture arrays
+    static void upload_buffers(const RenderableBuffers& buffers, const GLuint* const vbo, GLenum usage);
+
 public:
     explicit Renderable(const std::string& name);
     virtual ~Renderable() throw();
@@ -119,12 +133,51 @@ public:
 
     const Vertex& vertex(size_t idx) const { return _vertices[idx]; }
 
-    // returns the number of vertices in the silhouette
-    size_t compute_silhouette(const Light& light);
+    // true if the vertices are skinned by the skinned shader variants
+    // NOTE: the CPU vertices are only updated when something needs them
+    bool gpu_skinning() const { return _gpu_skinning; }
+
+    // the mesh level being drawn and the one picked for the next skin
+    // static and GPU-skinned renderables hold every level so they switch right away
+    size_t lod() const { return _lod; }
+    size_t selected_lod() const { return _selected_lod; }
+
+    // picks the mesh level from how much of the screen the bounds cover
+    void select_lod(const Camera& camera);
+
+    // finds the silhouette for each of the enabled lights with its bit set in light_mask
+    // the others keep whatever they had so it's still cached if they come back
+    // NOTE: this doesn't touch GL so it can run on a worker
+    void compute_silhouettes(const Lights& lights, const LightMask& light_mask);
+
+    // true if the silhouette for lights[idx] was reused by compute_silhouettes()
+    // because neither we nor the light have moved or been skinned since it was found
+    bool silhouette_cached(size_t idx) const;
+
+    // the indices into the shadow vertices compute_silhouettes() found for lights[idx]
+    // they're 16-bit when short_shadow_indices() is set
+    const void* silhouette_indices(size_t idx) const;
+    size_t silhouette_index_count(size_t idx) const;
+
+    // the doubled shadow vertices fit in 16-bit indices
+    bool short_shadow_indices() const;
+
+    // shadows use a coarser level than the one being drawn
+    size_t shadow_lod() const;
+
+    // uploads the silhouette for lights[idx] from compute_silhouettes()
+    // and the shadow vertices if they've been skinned since the last upload
+    // cached silhouettes are already uploaded
+    // returns the number of indices in the silhouette
+    size_t upload_silhouette(size_t idx);
 
     void render(Shader& shader) const;
     void render(Shader& shader, const Light& light, const Camera& camera) const;
-    void render_shadow(Shader& shader, const Light& light, const Camera& camera, size_t vcount, bool cap) const;
+    // idx is the light the silhouette was uploaded for
+    void render_shadow(Shader& shader, const Light& light, const Camera& camera, size_t idx, bool cap) const;
+
+    // extrudes the shadow volume on the GPU, this doesn't need compute_silhouettes()
+    void render_shadow_volume(Shader& shader, const Light& light, bool cap) const;
     void render_unlit(const Camera& camera);
 
     // NOTE: these are only meaningful when is_pickable() is true
@@ -137,26 +190,71 @@ public:
     virtual bool is_static() const = 0;
     virtual bool has_shadow() const { return false; }
 
+    // CPU side of animation, safe to call from a worker thread
     virtual void animate() {}
 
+    // uploads whatever the last animate() calculated
+    // NOTE: this has to be called from the render thread
+    void commit_vertices();
+
+    // uses a PoseCache pose instead of skinning our own vertices
+    // NOTE: the pose has to be built before commit_vertices()
+    void share_pose(boost::shared_ptr<CachedPose> pose);
+
 protected:
+    // NOTE: this doesn't touch GL, commit_vertices() does the upload
     void calculate_vertices(const Skeleton& skeleton);
 
+    const CachedPose* cached_pose() const { return _cached_pose.get(); }
+
+    // the skeleton the vertices were last calculated from
+    virtual const Skeleton& pose() const;
+
     virtual void on_render_unlit(const Camera& camera) const {}
 
 private:
-    GLuint vbo(RenderableVBO idx) const { return _vbo[idx]; }
+    // the skinned arrays come from the shared pose if there is one
+    GLuint vbo(RenderableVBO idx) const;
+    const RenderableBuffers& buffers() const;
     GLuint shadow_vbo(RenderableShadowVBO idx) const { return _shadow_vbo[idx]; }
 
-    void render_mesh(const Mesh& mesh, size_t start, Shader& shader) const;
-    void render_shadow_directional(Shader& shader, const DirectionalLight& light, size_t vcount) const;
-    void render_shadow_positional(Shader& shader, const PositionalLight& light, size_t vcount, bool cap) const;
+    // the first triangle of the level being drawn
+    size_t lod_start() const;
+
+    void upload_buffers();
+    void upload_influences();
+    void upload_adjacency();
+    void upload_palette();
+
+    // brings the CPU vertices up to date with the GPU-skinned pose
+    void update_vertices();
+
+    void render_mesh(const Mesh& mesh, size_t start, size_t count, Shader& shader) const;
+    void render_skinned(Shader& shader, size_t start, size_t count) const;
+    void enable_skinning(Shader& shader) const;
+    void disable_skinning(Shader& shader) const;
+    void render_shadow_directional(Shader& shader, const DirectionalLight& light, size_t idx) const;
+    void render_shadow_positional(Shader& shader, const PositionalLight& light, size_t idx, bool cap) const;
     void render_normals() const;
     void render_normals(const Mesh& mesh, size_t start) const;
 
-    bool is_silhouette_edge(const Mesh& mesh, const Edge& edge, const Vector4& light_position, size_t vstart, bool& faces_light1) const;
-    size_t compute_silhouette_directional(const Direction& light_direction, boost::shared_array<float> varray);
-    size_t compute_silhouette_positional(const Position& light_position, boost::shared_array<float> varray);
+    // the planes of every triangle in the level, shared by all of the lights
+    void compute_triangle_planes(size_t lod);
+
+    // every vertex at w=1 followed by every vertex again at w=0
+    // the shadow shaders extrude the w=0 copies away from the light
+    void compute_shadow_vertices();
+
+    // the bytes each light's silhouette gets in the index array
+    size_t shadow_index_stride() const;
+
+    // marks the shadow vertices dirty and invalidates the cached silhouettes
+    void vertices_changed();
+
+    // these sweep the edges using the facing bits from the last light
+    // and return the number of indices into the shadow vertices
+    template<typename Index> size_t compute_silhouette_directional(size_t lod, Index* const indices) const;
+    template<typename Index> size_t compute_silhouette_positional(size_t lod, Index* const indices) const;
 
 private:
     std::string _name;
@@ -170,6 +268,63 @@ private:
     GLuint _vbo[VBOCount];
     GLuint _shadow_vbo[ShadowVBOCount];
 
+    // one per light
+    struct Silhouette
+    {
+        Silhouette()
+            : icount(0), light(NULL), lod(0), transform_version(0), light_version(0), vertex_version(0),
+                cached(false), uploaded(false)
+        {
+        }
+
+        // sized for 32-bit indices, 16-bit ones only use the front of it
+        boost::shared_array<uint32_t> indices;
+        size_t icount;
+
+        // what the silhouette was found with, it's kept until any of these change
+        const Light* light;
+        size_t lod;
+        uint32_t transform_version, light_version, vertex_version;
+
+        // cached is set when compute_silhouettes() reused it
+        // uploaded is set while it's in its slot in the index array
+        bool cached, uploaded;
+    };
+    std::vector<Silhouette> _silhouettes;
+
+    // the number of silhouettes the index array has room for
+    size_t _shadow_index_slots;
+
+    // set whenever the CPU vertices change until the shadow vertices are uploaded
+    std::vector<float> _shadow_vertices;
+    bool _shadow_vertices_dirty;
+
+    // bumped whenever the CPU vertices change
+    uint32_t _vertex_version;
+
+    // the triangle planes of the shadow level one component per row
+    // with a zero plane at the end standing in for missing triangles
+    // and a bit per triangle set when it faces the light
+    std::vector<float> _triangle_planes;
+    std::vector<uint32_t> _facing;
+    size_t _plane_count, _planes_lod;
+
+    // set by calculate_vertices() until commit_vertices()
+    bool _upload_pending;
+
+    // the skinned pose from the PoseCache, if we're sharing one
+    boost::shared_ptr<CachedPose> _cached_pose;
+
+    // mesh level of detail
+    // every level is in the buffers back to back when _all_lods is set
+    size_t _lod, _selected_lod;
+    bool _all_lods;
+
+    // GPU skinning
+    bool _gpu_skinning, _vertices_dirty;
+    std::vector<float> _palette;
+    GLuint _palette_texture;
+
     uint32_t _pick_id;
     Color _pick_color;
 
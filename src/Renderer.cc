@@ -1,4 +1,5 @@
 #include "pch.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include "gl_defs.h"
@@ -7,6 +8,7 @@
 #include "Actor.h"
 #include "Camera.h"
 #include "ClientConfiguration.h"
+#include "Engine.h"
 #include "Light.h"
 #include "Map.h"
 #include "Mesh.h"
@@ -24,6 +26,24 @@
 
 Logger& Renderer::logger(Logger::instance("md5mv.Renderer"));
 
+namespace
+{
+    // the uniform names too long for the short string buffer, set for every
+    // renderable and light so they're built once instead of every call
+    const std::string GLOBAL_AMBIENT_COLOR("global_ambient_color");
+    const std::string MATERIAL_EMISSIVE("material_emissive");
+    const std::string LIGHT_CONSTANT_ATTENUATION("light_constant_attenuation");
+    const std::string LIGHT_LINEAR_ATTENUATION("light_linear_attenuation");
+    const std::string LIGHT_QUADRATIC_ATTENUATION("light_quadratic_attenuation");
+    const std::string LIGHT_SPOTLIGHT_DIRECTION("light_spotlight_direction");
+    const std::string LIGHT_SPOTLIGHT_CUTOFF("light_spotlight_cutoff");
+    const std::string LIGHT_SPOTLIGHT_EXPONENT("light_spotlight_exponent");
+    const std::string MATERIAL_AMBIENT("material_ambient");
+    const std::string MATERIAL_DIFFUSE("material_diffuse");
+    const std::string MATERIAL_SPECULAR("material_specular");
+    const std::string MATERIAL_SHININESS("material_shininess");
+}
+
 Renderer& Renderer::instance()
 {
     static boost::shared_ptr<Renderer> renderer;
@@ -34,7 +54,8 @@ Renderer& Renderer::instance()
 }
 
 Renderer::Renderer()
-    : _window(NULL), _near_plane(0.0f), _far_plane(0.0f), _aspect_ratio(0.0f), _fov(0.0f)
+    : _window(NULL), _near_plane(0.0f), _far_plane(0.0f), _aspect_ratio(0.0f), _fov(0.0f),
+        _silhouette_lights(NULL), _shadow_casters(0), _shadow_cache_hits(0), _shadow_cache_misses(0), _depth_bounds_test(false)
 {
     ZeroMemory(_fbo, BufferCount * sizeof(GLuint));
     ZeroMemory(_rbo, BufferCount * sizeof(GLuint));
@@ -44,6 +65,9 @@ Renderer::Renderer()
 
 Renderer::~Renderer() throw()
 {
+    LOG_INFO("Shadow volume cache hit rate: " << (shadow_cache_hit_rate() * 100.0) << "% ("
+        << _shadow_cache_hits << " of " << (_shadow_cache_hits + _shadow_cache_misses) << " lookups)" << std::endl);
+
     glDeleteFramebuffers(BufferCount, _fbo);
     glDeleteRenderbuffers(BufferCount, _rbo);
     glDeleteTextures(BufferCount, _tbo);
@@ -209,7 +233,7 @@ void Renderer::render(const Camera& camera)
 void Renderer::render(const Camera& camera, Map& map)
 {
     // sort the renderables for "efficient" rendering (lol)
-    _visible_renderables.sort(CompareRenderablesOpaque(camera.position()));
+    std::sort(_visible_renderables.begin(), _visible_renderables.end(), CompareRenderablesOpaque(camera.position()));
     BOOST_FOREACH(boost::shared_ptr<Light> light, map.lights()) {
         if(typeid(*light) == typeid(DirectionalLight)) {
             boost::shared_ptr<DirectionalLight> directional(boost::dynamic_pointer_cast<DirectionalLight, Light>(light));
@@ -217,36 +241,68 @@ void Renderer::render(const Camera& camera, Map& map)
             //_light_renderables.sort(CompareRenderablesOpaque()));
         } else if(typeid(*light) == typeid(PositionalLight)) {
             boost::shared_ptr<PositionalLight> positional(boost::dynamic_pointer_cast<PositionalLight, Light>(light));
-            _light_renderables.sort(CompareRenderablesOpaque(positional->position()));
+            std::sort(_light_renderables.begin(), _light_renderables.end(), CompareRenderablesOpaque(positional->position()));
         } else if(typeid(*light) == typeid(SpotLight)) {
             boost::shared_ptr<SpotLight> spot(boost::dynamic_pointer_cast<SpotLight, Light>(light));
-            _light_renderables.sort(CompareRenderablesOpaque(spot->position()));
+            std::sort(_light_renderables.begin(), _light_renderables.end(), CompareRenderablesOpaque(spot->position()));
         }
     }
 
+    // the silhouettes only need the CPU vertices
+    // so the workers can find them while the ambient renders
+    // (the GPU volumes don't need them at all)
+    const ClientConfiguration& config(ClientConfiguration::instance());
+    const bool shadows = Light::lighting_enabled() && config.render_shadows();
+
+    JobSystem::Counter silhouettes;
+    if(shadows && !config.render_shadow_volumes_gpu()) {
+        silhouettes = compute_silhouettes(camera, map);
+    }
+
     // render the ambient (filling the depth buffer)
     glBindFramebuffer(GL_FRAMEBUFFER, _fbo[AmbientBuffer]);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         render_ambient(camera, map);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    Engine::instance().jobs().wait(silhouettes);
+
     // render the detail
     glBindFramebuffer(GL_FRAMEBUFFER, _fbo[DetailBuffer]);
     glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     glEnable(GL_STENCIL_TEST);
 
-    const ClientConfiguration& config(ClientConfiguration::instance());
-    BOOST_FOREACH(boost::shared_ptr<Light> light, map.lights()) {
+    _shadow_caster_stats.clear();
+    for(size_t i=0; i<map.lights().size(); ++i) {
+        const boost::shared_ptr<Light> light(map.lights()[i]);
         if(!light->enabled()) {
             continue;
         }
 
+        // keep the stencil clear, the shadows, and the lighting
+        // to the part of the screen the light can reach
+        LightBounds bounds;
+        const bool bounded = light_bounds(*light, bounds);
+        if(bounded) {
+            if(bounds.width <= 0 || bounds.height <= 0) {
+                continue;
+            }
+
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(bounds.x, bounds.y, bounds.width, bounds.height);
+
+            if(_depth_bounds_test) {
+                glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
+                glDepthBoundsEXT(bounds.zmin, bounds.zmax);
+            }
+        }
+
         glClear(GL_STENCIL_BUFFER_BIT);
 
         // fill the stencil buffer with shadows
-        if(Light::lighting_enabled() && config.render_shadows()) {
-            render_shadows(*light, camera);
+        if(shadows) {
+            render_shadows(map, *light, i, camera);
         }
 
         // only render where the stencil is 0 and the depth is equal (only modify the color buffer)
@@ -259,6 +315,13 @@ void Renderer::render(const Camera& camera, Map& map)
         glDisable(GL_BLEND);
         glStencilFunc(GL_ALWAYS, 0, ~0);
         glDepthFunc(GL_LEQUAL);
+
+        if(bounded) {
+            if(_depth_bounds_test) {
+                glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+            }
+            glDisable(GL_SCISSOR_TEST);
+        }
     }
 
     glDisable(GL_STENCIL_TEST);
@@ -280,9 +343,11 @@ void Renderer::render(const Camera& camera, Map& map)
     // transparency last
     render_transparent();
 
-    // cleanup
+    // cleanup, the vectors keep their capacity for the next frame
     _visible_renderables.clear();
+    _pickable_renderables.clear();
     _light_renderables.clear();
+    _shadow_renderables.clear();
 }
 
 void Renderer::render_triangle() const
@@ -550,6 +615,12 @@ void Renderer::render_fullscreen_quad(Shader& shader)
     glDisableVertexAttribArray(vloc);
 }
 
+double Renderer::shadow_cache_hit_rate() const
+{
+    const uint64_t lookups = _shadow_cache_hits + _shadow_cache_misses;
+    return lookups > 0 ? static_cast<double>(_shadow_cache_hits) / lookups : 0.0;
+}
+
 bool Renderer::init()
 {
     GLenum err = glewInit();
@@ -944,11 +1015,11 @@ void Renderer::init_shader_matrices(Shader& shader) const
 void Renderer::init_shader_ambient(Shader& shader, const Material& material) const
 {
     Color global_ambient_color(Light::lighting_enabled() ? Light::global_ambient_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
-    shader.uniform4f("global_ambient_color", global_ambient_color);
+    shader.uniform4f(GLOBAL_AMBIENT_COLOR, global_ambient_color);
 
     // pass in the material parameters
-    shader.uniform4f("material_ambient", Light::lighting_enabled() ? material.ambient_color() : Color(1.0f, 1.0f, 1.0f, 1.0f));
-    shader.uniform4f("material_emissive", Light::lighting_enabled() ? material.emissive_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
+    shader.uniform4f(MATERIAL_AMBIENT, Light::lighting_enabled() ? material.ambient_color() : Color(1.0f, 1.0f, 1.0f, 1.0f));
+    shader.uniform4f(MATERIAL_EMISSIVE, Light::lighting_enabled() ? material.emissive_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
 }
 
 void Renderer::init_shader_light(Shader& shader, const Material& material, const Light& light, const Camera& camera) const
@@ -997,18 +1068,18 @@ void Renderer::init_shader_light(Shader& shader, const Material& material, const
     shader.uniform4f("light_diffuse", light_diffuse);
     shader.uniform4f("light_specular", light_specular);
     shader.uniform4f("light_position", light_position);
-    shader.uniform1f("light_constant_attenuation", light_constant_attenuation);
-    shader.uniform1f("light_linear_attenuation", light_linear_attenuation);
-    shader.uniform1f("light_quadratic_attenuation", light_quadratic_attenuation);
-    shader.uniform4f("light_spotlight_direction", light_spotlight_direction);
-    shader.uniform1f("light_spotlight_cutoff", light_spotlight_cutoff);
-    shader.uniform1f("light_spotlight_exponent", light_spotlight_exponent);
+    shader.uniform1f(LIGHT_CONSTANT_ATTENUATION, light_constant_attenuation);
+    shader.uniform1f(LIGHT_LINEAR_ATTENUATION, light_linear_attenuation);
+    shader.uniform1f(LIGHT_QUADRATIC_ATTENUATION, light_quadratic_attenuation);
+    shader.uniform4f(LIGHT_SPOTLIGHT_DIRECTION, light_spotlight_direction);
+    shader.uniform1f(LIGHT_SPOTLIGHT_CUTOFF, light_spotlight_cutoff);
+    shader.uniform1f(LIGHT_SPOTLIGHT_EXPONENT, light_spotlight_exponent);
 
     // pass in the material parameters
-    shader.uniform4f("material_ambient", Light::lighting_enabled() ? material.ambient_color() : Color(1.0f, 1.0f, 1.0f, 1.0f));
-    shader.uniform4f("material_diffuse", Light::lighting_enabled() ? material.diffuse_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
-    shader.uniform4f("material_specular",Light::lighting_enabled() ? material.specular_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
-    shader.uniform1f("material_shininess", Light::lighting_enabled() ? material.shininess() : 0.0f);
+    shader.uniform4f(MATERIAL_AMBIENT, Light::lighting_enabled() ? material.ambient_color() : Color(1.0f, 1.0f, 1.0f, 1.0f));
+    shader.uniform4f(MATERIAL_DIFFUSE, Light::lighting_enabled() ? material.diffuse_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
+    shader.uniform4f(MATERIAL_SPECULAR, Light::lighting_enabled() ? material.specular_color() : Color(0.0f, 0.0f, 0.0f, 1.0f));
+    shader.uniform1f(MATERIAL_SHININESS, Light::lighting_enabled() ? material.shininess() : 0.0f);
 }
 
 bool Renderer::save_png(const boost::filesystem::path& filename, size_t width, size_t height, size_t Bpp, size_t pitch, const void* const pixels) const
@@ -1122,6 +1193,12 @@ bool Renderer::check_extensions()
     // nvidia depth clamp
     glEnable(GL_DEPTH_CLAMP);
 
+    // lets the lights skip pixels outside of their depth range
+    _depth_bounds_test = glewIsSupported("GL_EXT_depth_bounds_test");
+    if(_depth_bounds_test) {
+        LOG_INFO("Using EXT_depth_bounds_test" << std::endl);
+    }
+
     return true;
 }
 
@@ -1129,10 +1206,11 @@ void Renderer::render_ambient(const Camera& camera, Map& map) const
 {
     Shader& shader(State::instance().ambient_shader());
     BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _visible_renderables) {
-        shader.begin();
-        init_shader_ambient(shader, renderable->material());
-        renderable->render(shader);
-        shader.end();
+        Shader& rshader(renderable->gpu_skinning() ? State::instance().skinned_ambient_shader() : shader);
+        rshader.begin();
+        init_shader_ambient(rshader, renderable->material());
+        renderable->render(rshader);
+        rshader.end();
     }
 
     shader.begin();
@@ -1147,7 +1225,111 @@ State::instance().scene()->_bsp->render(camera, bspshader);
 bspshader.end();*/
 }
 
-void Renderer::render_shadows(const Light& light, const Camera& camera)
+JobSystem::Counter Renderer::compute_silhouettes(const Camera& camera, const Map& map)
+{
+    const Lights& lights(map.lights());
+    _shadow_casters = 0;
+    BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _light_renderables) {
+        if(!renderable->has_shadow()) {
+            continue;
+        }
+        _shadow_casters++;
+
+        // reuse the next mask, it only allocates the first time it grows
+        const size_t idx = _shadow_renderables.size();
+        if(idx >= _shadow_light_masks.size()) {
+            _shadow_light_masks.resize(idx + 1);
+        }
+
+        LightMask& mask(_shadow_light_masks[idx]);
+        mask.resize(lights.size());
+        mask.reset();
+        for(size_t i=0; i<lights.size(); ++i) {
+            if(lights[i]->enabled() && casts_shadow(*renderable, *lights[i], camera)) {
+                mask.set(i);
+            }
+        }
+
+        if(mask.any()) {
+            _shadow_renderables.push_back(renderable);
+        }
+    }
+
+    // binding just this keeps the job small enough not to allocate
+    _silhouette_lights = &lights;
+    return Engine::instance().jobs().parallel_for(_shadow_renderables.size(),
+        boost::bind(&Renderer::compute_silhouette, this, _1));
+}
+
+void Renderer::compute_silhouette(size_t idx)
+{
+    _shadow_renderables[idx]->compute_silhouettes(*_silhouette_lights, _shadow_light_masks[idx]);
+}
+
+bool Renderer::casts_shadow(const Renderable& renderable, const Light& light, const Camera& camera) const
+{
+    const AABB bounds(renderable.absolute_bounds());
+    if(typeid(light) == typeid(PositionalLight) || typeid(light) == typeid(SpotLight)) {
+        const PositionalLight& positional(dynamic_cast<const PositionalLight&>(light));
+        if(bounds.distance(positional.position()) > positional.radius()) {
+            return false;
+        }
+    }
+
+    // the caster has to be inside the hull of the light and the view frustum
+    return camera.shadow_visible(bounds, light.homogeneous_position());
+}
+
+bool Renderer::light_bounds(const Light& light, LightBounds& bounds) const
+{
+    if(typeid(light) != typeid(PositionalLight) && typeid(light) != typeid(SpotLight)) {
+        return false;
+    }
+
+    const PositionalLight& positional(dynamic_cast<const PositionalLight&>(light));
+    if(positional.radius() >= FLT_MAX) {
+        return false;
+    }
+
+    // project the corners of the box around the sphere
+    // anything behind the near plane could cover the whole screen
+    const Matrix4 clipping(clipping_matrix());
+    const Position& center(positional.position());
+    const float radius = positional.radius();
+
+    float xmin = 1.0f, ymin = 1.0f, zmin = 1.0f;
+    float xmax = -1.0f, ymax = -1.0f, zmax = -1.0f;
+    for(int i=0; i<8; ++i) {
+        const Vector4 corner(clipping * Position(center.x() + (i & 1 ? radius : -radius),
+            center.y() + (i & 2 ? radius : -radius),
+            center.z() + (i & 4 ? radius : -radius), 1.0f));
+        if(corner.z() < -corner.w()) {
+            return false;
+        }
+
+        const float x = corner.x() / corner.w(), y = corner.y() / corner.w(), z = corner.z() / corner.w();
+        xmin = std::min(xmin, x); xmax = std::max(xmax, x);
+        ymin = std::min(ymin, y); ymax = std::max(ymax, y);
+        zmin = std::min(zmin, z); zmax = std::max(zmax, z);
+    }
+
+    // normalized device coordinates to window coordinates
+    const int width = window_width(), height = window_height();
+    const GLint left = static_cast<GLint>(std::floor((std::max(xmin, -1.0f) + 1.0f) * 0.5f * width));
+    const GLint right = static_cast<GLint>(std::ceil((std::min(xmax, 1.0f) + 1.0f) * 0.5f * width));
+    const GLint bottom = static_cast<GLint>(std::floor((std::max(ymin, -1.0f) + 1.0f) * 0.5f * height));
+    const GLint top = static_cast<GLint>(std::ceil((std::min(ymax, 1.0f) + 1.0f) * 0.5f * height));
+
+    bounds.x = left;
+    bounds.y = bottom;
+    bounds.width = right - left;
+    bounds.height = top - bottom;
+    bounds.zmin = (std::max(zmin, -1.0f) + 1.0f) * 0.5f;
+    bounds.zmax = (std::min(zmax, 1.0f) + 1.0f) * 0.5f;
+    return true;
+}
+
+void Renderer::render_shadows(const Map& map, const Light& light, size_t lidx, const Camera& camera)
 {
     /*if(typeid(light) == typeid(DirectionalLight)) {
         push_projection_matrix();
@@ -1167,14 +1349,47 @@ void Renderer::render_shadows(const Light& light, const Camera& camera)
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(1.0f, 1);
 
-    BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _light_renderables) {
-        if(renderable->has_shadow()) {
-            size_t vcount = renderable->compute_silhouette(light);
-            if(vcount > 0) {
-                render_shadow(*renderable, light, camera, vcount);
+    // the world only shadows from the lights dmap built volumes for
+    render_map_shadow(map, light);
+
+    ShadowCasterStats stats;
+    stats.light = lidx;
+    stats.considered = stats.drawn = 0;
+
+    if(ClientConfiguration::instance().render_shadow_volumes_gpu()) {
+        BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _light_renderables) {
+            if(!renderable->has_shadow()) {
+                continue;
+            }
+
+            stats.considered++;
+            if(casts_shadow(*renderable, light, camera)) {
+                render_shadow_volume(*renderable, light);
+                stats.drawn++;
+            }
+        }
+    } else {
+        // compute_silhouettes() already culled the casters against every light
+        stats.considered = _shadow_casters;
+        for(size_t i=0; i<_shadow_renderables.size(); ++i) {
+            if(!_shadow_light_masks[i].test(lidx)) {
+                continue;
+            }
+
+            Renderable& renderable(*_shadow_renderables[i]);
+            if(renderable.silhouette_cached(lidx)) {
+                _shadow_cache_hits++;
+            } else {
+                _shadow_cache_misses++;
+            }
+
+            if(renderable.upload_silhouette(lidx) > 0) {
+                render_shadow(renderable, light, camera, lidx);
+                stats.drawn++;
             }
         }
     }
+    _shadow_caster_stats.push_back(stats);
 
     glDisable(GL_POLYGON_OFFSET_FILL);
 
@@ -1191,7 +1406,7 @@ void Renderer::render_shadows(const Light& light, const Camera& camera)
     }*/
 }
 
-void Renderer::render_shadow(const Renderable& renderable, const Light& light, const Camera& camera, size_t vcount) const
+void Renderer::render_shadow(const Renderable& renderable, const Light& light, const Camera& camera, size_t lidx) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.6
 
@@ -1205,17 +1420,48 @@ void Renderer::render_shadow(const Renderable& renderable, const Light& light, c
 //std::cout << "cap" << std::endl;
         glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
         glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
-        renderable.render_shadow(shader, light, vcount, true);
+        renderable.render_shadow(shader, light, lidx, true);
     } else {*/
 //std::cout << "no cap " << std::endl;
         glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
         glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
-        renderable.render_shadow(shader, light, camera, vcount, false);
+        renderable.render_shadow(shader, light, camera, lidx, false);
     //}
 
     glEnable(GL_CULL_FACE);
 }
 
+void Renderer::render_map_shadow(const Map& map, const Light& light) const
+{
+    // dmap's volumes are closed and already extruded
+    glDisable(GL_CULL_FACE);
+
+    // same as render_shadow(), these don't cap either
+    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+    map.render_shadow(State::instance().shadow_point_shader(), light);
+
+    glEnable(GL_CULL_FACE);
+}
+
+void Renderer::render_shadow_volume(const Renderable& renderable, const Light& light) const
+{
+    // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.6
+
+    glDisable(GL_CULL_FACE);
+
+    Shader& shader(renderable.gpu_skinning()
+        ? State::instance().skinned_shadow_volume_shader()
+        : State::instance().shadow_volume_shader());
+
+    // same as render_shadow(), these don't cap either
+    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+    renderable.render_shadow_volume(shader, light, false);
+
+    glEnable(GL_CULL_FACE);
+}
+
 bool Renderer::require_shadow_volume_cap(const Renderable& renderable, const Light& light) const
 {
     // Mathematics for 3D Game Programming and Computer Graphics, section 10.3.5
@@ -1321,10 +1567,12 @@ void Renderer::render_detail(const Camera& camera, Map& map, const Light& light)
 {
     const ClientConfiguration& config(ClientConfiguration::instance());
     Shader& shader(config.render_mode_vertex() ? State::instance().vertex_shader() : State::instance().bump_shader());
+    Shader& skinned_shader(config.render_mode_vertex() ? State::instance().skinned_vertex_shader() : State::instance().skinned_bump_shader());
     BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _visible_renderables) {
-        shader.begin();
-        renderable->render(shader, light, camera);
-        shader.end();
+        Shader& rshader(renderable->gpu_skinning() ? skinned_shader : shader);
+        rshader.begin();
+        renderable->render(rshader, light, camera);
+        rshader.end();
     }
 
     shader.begin();
@@ -1346,8 +1594,8 @@ void Renderer::render_unlit(const Camera& camera, const Map& map) const
 
 void Renderer::render_picking() const
 {
-    Shader& shader(State::instance().pick_shader());
     BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _pickable_renderables) {
+        Shader& shader(renderable->gpu_skinning() ? State::instance().skinned_pick_shader() : State::instance().pick_shader());
         shader.begin();
         shader.uniform4f("color", renderable->pick_color());
         renderable->render(shader);
@@ -1,6 +1,7 @@
 #if !defined __RENDERER__
 #define __RENDERER__
 
+#include "JobSystem.h"
 #include "Map.h"
 #include "Matrix4.h"
 
@@ -30,6 +31,13 @@ private:
         VBOCount
     };
 
+    // the part of the screen a light can reach
+    struct LightBounds
+    {
+        GLint x, y, width, height;
+        float zmin, zmax;
+    };
+
 private:
     static Logger& logger;
 
@@ -107,6 +115,19 @@ public:
     // that is, one that uses no matrices in order to render the quad
     void render_fullscreen_quad(Shader& shader);
 
+    // the shadow casters each light that rendered shadows looked at and drew last frame
+    struct ShadowCasterStats
+    {
+        size_t light, considered, drawn;
+    };
+    const std::vector<ShadowCasterStats>& shadow_caster_stats() const { return _shadow_caster_stats; }
+
+    // how often a caster's silhouette for a light was reused
+    // rather than found again and uploaded
+    uint64_t shadow_cache_hits() const { return _shadow_cache_hits; }
+    uint64_t shadow_cache_misses() const { return _shadow_cache_misses; }
+    double shadow_cache_hit_rate() const;
+
 public:
     bool create_window(int width, int height, int bpp, bool fullscreen, const std::string& caption);
     void resize_viewport(int width, int height);
@@ -133,9 +154,24 @@ private:
     void print_info();
     bool check_extensions();
 
+    // finds the silhouettes of the shadow casters on the workers
+    JobSystem::Counter compute_silhouettes(const Camera& camera, const Map& map);
+    void compute_silhouette(size_t idx);
+
+    // false if the caster is out of the light's reach
+    // or its shadow can't reach the view frustum
+    bool casts_shadow(const Renderable& renderable, const Light& light, const Camera& camera) const;
+
+    // projects a positional light's sphere to a scissor rectangle and window depth range
+    // the rectangle is empty if the light is off screen
+    // false if it can't be bounded and the light needs the whole screen
+    bool light_bounds(const Light& light, LightBounds& bounds) const;
+
     void render_ambient(const Camera& camera, Map& map) const;
-    void render_shadows(const Light& light, const Camera& camera);
-    void render_shadow(const Renderable& renderable, const Light& light, const Camera& camera, size_t vcount) const;
+    void render_shadows(const Map& map, const Light& light, size_t lidx, const Camera& camera);
+    void render_map_shadow(const Map& map, const Light& light) const;
+    void render_shadow(const Renderable& renderable, const Light& light, const Camera& camera, size_t lidx) const;
+    void render_shadow_volume(const Renderable& renderable, const Light& light) const;
     bool require_shadow_volume_cap(const Renderable& renderable, const Light& light) const;
     void render_detail(const Camera& camera, Map& map, const Light& light) const;
     void render_unlit(const Camera& camera, const Map& map) const;
@@ -161,17 +197,33 @@ private:
     std::stack<Matrix4> _model_stack;
 
     // scene graph wrt the camera
-    std::list<boost::shared_ptr<Renderable> > _visible_renderables;
+    std::vector<boost::shared_ptr<Renderable> > _visible_renderables;
 
     // scene graph wrt each light
     // TODO: we need a list for *each* light in the scene
-    std::list<boost::shared_ptr<Renderable> > _light_renderables;
+    std::vector<boost::shared_ptr<Renderable> > _light_renderables;
+
+    // the shadow casters for compute_silhouettes()
+    // and a bit for each of the lights they cast a shadow from
+    // out of however many renderables with shadows it considered
+    // (the masks outlive the frame so their bits don't get reallocated)
+    std::vector<boost::shared_ptr<Renderable> > _shadow_renderables;
+    std::vector<LightMask> _shadow_light_masks;
+    const Lights* _silhouette_lights;
+    size_t _shadow_casters;
+
+    std::vector<ShadowCasterStats> _shadow_caster_stats;
 
     // pickable objects
-    std::list<boost::shared_ptr<Renderable> > _pickable_renderables;
+    std::vector<boost::shared_ptr<Renderable> > _pickable_renderables;
 
     GLuint _fbo[BufferCount], _rbo[BufferCount], _tbo[BufferCount], _vbo[VBOCount];
 
+    uint64_t _shadow_cache_hits, _shadow_cache_misses;
+
+    // GL_EXT_depth_bounds_test
+    bool _depth_bounds_test;
+
 private:
     Renderer();
     DISALLOW_COPY_AND_ASSIGN(Renderer);
@@ -5,10 +5,14 @@
 #include "math_util.h"
 #include "Actor.h"
 #include "Camera.h"
+#include "ClientConfiguration.h"
 #include "D3Map.h"
+#include "Engine.h"
+#include "JobSystem.h"
 #include "Lexer.h"
 #include "Light.h"
 #include "ModelManager.h"
+#include "PoseCache.h"
 #include "Player.h"
 #include "Renderer.h"
 #include "State.h"
@@ -17,10 +21,17 @@
 
 //#include "Q3BSP.h"
 
+namespace
+{
+    // the most time an actor catches up on in one think,
+    // so a hitch doesn't throw the ones that think less often
+    const double MAX_PENDING_DT = 0.25;
+}
+
 Logger& Scene::logger(Logger::instance("md5mv.Scene"));
 
 Scene::Scene()
-    : _loaded(false), _camera(new Camera())
+    : _loaded(false), _camera(new Camera()), _update_count(0)
 {
 }
 
@@ -92,6 +103,11 @@ if(!_bsp->load_material(material_dir(), "scene")) {
         return false;
     }
 
+    const int pose_steps = ClientConfiguration::instance().game_pose_steps();
+    if(pose_steps > 0) {
+        _pose_cache.reset(new PoseCache(pose_steps));
+    }
+
     _loaded = true;
     return true;
 }
@@ -103,16 +119,65 @@ void Scene::unload()
     _map.reset();
 //_bsp.reset();
 
+    _skinned.clear();
+    _updates.clear();
+    _actors.clear();
     _renderables.clear();
+
+    // after the actors so it can log its final hit rate
+    _pose_cache.reset();
 }
 
 void Scene::update(double dt)
 {
     State::instance().player()->think(dt);
-    BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _renderables) {
-        if(!renderable->is_static()) {
-            renderable->think(dt);
+
+    // the actors are the only renderables that think
+    // the ones further away think less often, staggered by their index
+    // so about the same number think every frame and an actor keeps its
+    // phase when the others change interval
+    const float tan_half_fov = std::tan(DEG_RAD(ClientConfiguration::instance().game_fov()) * 0.5f);
+
+    _update_count++;
+    for(size_t i=0; i<_actors.size(); ++i) {
+        ActorUpdate& update(_updates[i]);
+        update_lod(*_actors[i], tan_half_fov, update);
+
+        update.pending_dt = std::min(update.pending_dt + dt, MAX_PENDING_DT);
+        if(0 != (_update_count + i) % update.interval) {
+            continue;
         }
+
+        _actors[i]->think(update.pending_dt);
+        update.pending_dt = 0.0;
+        update.stale = true;
+    }
+}
+
+void Scene::update_lod(const Actor& actor, float tan_half_fov, ActorUpdate& update) const
+{
+    update.interval = 1;
+    update.frozen = false;
+
+    const ClientConfiguration& config(ClientConfiguration::instance());
+    if(!config.animation_update_lod()) {
+        return;
+    }
+
+    const AABB bounds(actor.absolute_bounds());
+    const float distance = bounds.center().distance(_camera->position());
+    if(distance <= bounds.radius()) {
+        return;
+    }
+
+    const float screen = bounds.radius() / (distance * tan_half_fov);
+    if(screen < config.animation_lod_frozen()) {
+        update.interval = MAX_UPDATE_INTERVAL;
+        update.frozen = true;
+    } else if(screen < config.animation_lod_quarter_rate()) {
+        update.interval = MAX_UPDATE_INTERVAL;
+    } else if(screen < config.animation_lod_half_rate()) {
+        update.interval = 2;
     }
 }
 
@@ -124,14 +189,58 @@ void Scene::render()
         return;
     }
 
-    // TODO: we should call map->render() here and let it decide which actors to register
+    const bool shadows = Light::lighting_enabled() && ClientConfiguration::instance().render_shadows();
+
+    // the held poses have to be kept before any new ones are built
+    if(_pose_cache) {
+        _pose_cache->begin_frame();
+    }
+
+    // the skinned levels have to be picked before anything is skinned
     BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _renderables) {
-        if(!renderable->is_static()) {
-            boost::dynamic_pointer_cast<Actor, Renderable>(renderable)->animate();
+        renderable->select_lod(*_camera);
+    }
+
+    // actors that haven't thought since they were skinned hold their pose
+    // and the ones that weren't relevant last frame may have lost theirs
+    _skinned.clear();
+    for(size_t i=0; i<_actors.size(); ++i) {
+        ActorUpdate& update(_updates[i]);
+        const bool relevant = needs_skinning(*_actors[i], shadows);
+        if(relevant && (!update.relevant || (update.stale && !update.frozen))) {
+            _skinned.push_back(_actors[i]);
+            update.stale = false;
+        } else if(relevant && _pose_cache) {
+            _actors[i]->hold_pose(*_pose_cache);
         }
+        update.relevant = relevant;
+    }
+
+    // the actors are independent until they hit GL so they animate on the workers
+    JobSystem& jobs(Engine::instance().jobs());
+    JobSystem::Counter animated;
+    if(_pose_cache) {
+        // actors on the same pose share it so only the new ones get built
+        BOOST_FOREACH(boost::shared_ptr<Actor> actor, _skinned) {
+            actor->animate(*_pose_cache);
+        }
+        animated = _pose_cache->build(jobs);
+    } else {
+        animated = jobs.parallel_for(_skinned.size(), boost::bind(&Scene::animate_actor, this, _1));
+    }
+
+    // culling only needs the bounds from update() so it doesn't have to wait
+    // TODO: we should call map->render() here and let it decide which actors to register
+    BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _renderables) {
         Renderer::instance().register_renderable(*_camera, renderable);
     }
 
+    // the uploads do
+    jobs.wait(animated);
+    BOOST_FOREACH(boost::shared_ptr<Renderable> renderable, _renderables) {
+        renderable->commit_vertices();
+    }
+
     // TODO: same for the lights
     /*if(State::instance().render_lights()) {
         BOOST_FOREACH(boost::shared_ptr<Light> light, _map->lights()) {
@@ -145,6 +254,30 @@ void Scene::render()
     Renderer::instance().render(*_camera, *_map);
 }
 
+bool Scene::needs_skinning(const Actor& actor, bool shadows) const
+{
+    const AABB& bounds(actor.absolute_bounds());
+    if(_camera->visible(bounds)) {
+        return true;
+    }
+
+    if(!shadows || !actor.has_shadow()) {
+        return false;
+    }
+
+    BOOST_FOREACH(boost::shared_ptr<Light> light, _map->lights()) {
+        if(light->enabled() && _camera->shadow_visible(bounds, light->homogeneous_position())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scene::animate_actor(size_t idx)
+{
+    _skinned[idx]->animate();
+}
+
 bool Scene::scan_map(Lexer& lexer)
 {
     if(!lexer.match(MAP)) {
@@ -392,6 +525,8 @@ bool Scene::scan_actor(Lexer& lexer, const std::string& type)
 
     LOG_INFO("Pick id=" << actor->pick_id() << ", color=" << actor->pick_color().str() << std::endl);
     _renderables.push_back(actor);
+    _actors.push_back(actor);
+    _updates.push_back(ActorUpdate());
     return true;
 }
 
@@ -411,19 +546,34 @@ bool Scene::scan_lights(Lexer& lexer)
             return false;
         }
 
-        float x;
-        if(!lexer.float_literal(x)) {
-            return false;
-        }
+        // map lights are positional lights at one of the map's own lights
+        float x, y, z;
+        std::string map_light;
+        if(type == "map") {
+            if(!lexer.string_literal(map_light)) {
+                return false;
+            }
 
-        float y;
-        if(!lexer.float_literal(y)) {
-            return false;
-        }
+            Position origin;
+            if(!_map->light_origin(map_light, origin)) {
+                LOG_ERROR("Invalid map light '" << map_light << "'" << std::endl);
+                return false;
+            }
+            x = origin.x();
+            y = origin.y();
+            z = origin.z();
+        } else {
+            if(!lexer.float_literal(x)) {
+                return false;
+            }
 
-        float z;
-        if(!lexer.float_literal(z)) {
-            return false;
+            if(!lexer.float_literal(y)) {
+                return false;
+            }
+
+            if(!lexer.float_literal(z)) {
+                return false;
+            }
         }
 
         std::string colordef;
@@ -437,7 +587,7 @@ bool Scene::scan_lights(Lexer& lexer)
             directional->direction(Direction(x, y, z));
 
             light = directional;
-        } else if(type == "positional") {
+        } else if(type == "positional" || type == "map") {
             boost::shared_ptr<PositionalLight> positional(new PositionalLight());
             positional->position(Position(x, y, z));
 
@@ -464,6 +614,10 @@ bool Scene::scan_lights(Lexer& lexer)
 
         light->enable();
         _map->add_light(light);
+
+        if(!map_light.empty()) {
+            _map->link_light(map_light, *light);
+        }
     }
 
     if(_map->light_count() > Map::MAX_LIGHTS) {
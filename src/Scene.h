@@ -1,10 +1,12 @@
 #if !defined __SCENE_H__
 #define __SCENE_H__
 
+class Actor;
 class Camera;
 class Lexer;
 class Map;
 class Renderable;
+class PoseCache;
 class PositionalLight;
 class SpotLight;
 
@@ -12,6 +14,31 @@ class SpotLight;
 
 class Scene
 {
+private:
+    enum
+    {
+        MAX_UPDATE_INTERVAL = 4
+    };
+
+    // update level of detail, one per actor
+    struct ActorUpdate
+    {
+        ActorUpdate() : interval(1), frozen(false), pending_dt(0.0), stale(true), relevant(false) {}
+
+        // thinks every interval frames, frozen actors think but hold their pose
+        size_t interval;
+        bool frozen;
+
+        // time since the actor last thought
+        double pending_dt;
+
+        // thought since it was last skinned
+        bool stale;
+
+        // skinned or holding its pose last frame
+        bool relevant;
+    };
+
 private:
     static Logger& logger;
 
@@ -35,7 +62,22 @@ public:
 
     const Map& map() const { return *_map; }
 
+    // actors skinned last frame out of all of them
+    size_t skinned_actor_count() const { return _skinned.size(); }
+    size_t actor_count() const { return _actors.size(); }
+
+    // NULL when pose caching is off
+    const PoseCache* pose_cache() const { return _pose_cache.get(); }
+
 private:
+    // actors that can be seen, or whose shadows can be, need their vertices
+    // the rest only advance their frame in update() until they're relevant again
+    bool needs_skinning(const Actor& actor, bool shadows) const;
+
+    // picks the update rate from how much of the screen height the actor covers
+    void update_lod(const Actor& actor, float tan_half_fov, ActorUpdate& update) const;
+    void animate_actor(size_t idx);
+
     bool scan_map(Lexer& lexer);
     bool scan_global_ambient_color(Lexer& lexer);
     bool scan_models(Lexer& lexer);
@@ -52,6 +94,18 @@ private:
     boost::shared_ptr<Map> _map;
     std::vector<boost::shared_ptr<Renderable> > _renderables;
 
+    // the non-static renderables, animated in parallel
+    std::vector<boost::shared_ptr<Actor> > _actors;
+
+    std::vector<ActorUpdate> _updates;
+    uint64_t _update_count;
+
+    // the actors being skinned this frame
+    std::vector<boost::shared_ptr<Actor> > _skinned;
+
+    // NULL when disabled
+    boost::shared_ptr<PoseCache> _pose_cache;
+
 /*public:
 boost::shared_ptr<Q3BSP> _bsp;*/
 
@@ -0,0 +1,599 @@
+#include "pch.h"
+#include <algorithm>
+#include "Geometry.h"
+#include "Model.h"
+#include "Skinning.h"
+
+#if defined USE_SSE && defined __GNUC__
+    #define USE_AVX2
+    #include <immintrin.h>
+
+    // the helpers shared with the AVX2 kernel have to be inlined into it
+    // otherwise mixing them with 256-bit code stalls on every SSE instruction
+    #define SKINNING_INLINE inline __attribute__((always_inline))
+#else
+    #define SKINNING_INLINE inline
+#endif
+
+namespace
+{
+    // vertices per batch, enough for the widest kernel
+    const size_t MAX_LANES = 8;
+
+    // each joint is (qx, qy, qz, qw, px, py, pz, pw), pw is ignored
+    const size_t JOINT_STRIDE = Skeleton::JOINT_STRIDE;
+
+    // influences pack their joints into bytes
+    const size_t MAX_PALETTE_JOINTS = 256;
+
+    // attribute rows accumulated by the kernels, one lane per vertex
+    enum Attribute
+    {
+        PositionX, PositionY, PositionZ,
+        NormalX, NormalY, NormalZ,
+        TangentX, TangentY, TangentZ,
+        BitangentX, BitangentY, BitangentZ,
+        AttributeCount
+    };
+
+    // sorts vertices by how many weights they have
+    struct WeightCountLess
+    {
+        explicit WeightCountLess(const Vertex* const vertices) : _vertices(vertices) {}
+
+        bool operator()(int lhs, int rhs) const { return _vertices[lhs].weight_count < _vertices[rhs].weight_count; }
+
+        const Vertex* _vertices;
+    };
+
+#if defined USE_SSE
+    // q * (0, v) * ~q, in the same order of operations as Quaternion::operator*(const Vector3&)
+    SKINNING_INLINE void rotate(__m128 qx, __m128 qy, __m128 qz, __m128 qw, __m128 vx, __m128 vy, __m128 vz, __m128& rx, __m128& ry, __m128& rz)
+    {
+        // t = q * (0, v)
+        const __m128 ts = _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, vx), _mm_mul_ps(qy, vy)), _mm_mul_ps(qz, vz)));
+        const __m128 tx = _mm_add_ps(_mm_mul_ps(qw, vx), _mm_sub_ps(_mm_mul_ps(qy, vz), _mm_mul_ps(qz, vy)));
+        const __m128 ty = _mm_add_ps(_mm_mul_ps(qw, vy), _mm_sub_ps(_mm_mul_ps(qz, vx), _mm_mul_ps(qx, vz)));
+        const __m128 tz = _mm_add_ps(_mm_mul_ps(qw, vz), _mm_sub_ps(_mm_mul_ps(qx, vy), _mm_mul_ps(qy, vx)));
+
+        // r = t * ~q
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 nx = _mm_sub_ps(zero, qx), ny = _mm_sub_ps(zero, qy), nz = _mm_sub_ps(zero, qz);
+        rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ts, nx), _mm_mul_ps(qw, tx)), _mm_sub_ps(_mm_mul_ps(ty, nz), _mm_mul_ps(tz, ny)));
+        ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ts, ny), _mm_mul_ps(qw, ty)), _mm_sub_ps(_mm_mul_ps(tz, nx), _mm_mul_ps(tx, nz)));
+        rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ts, nz), _mm_mul_ps(qw, tz)), _mm_sub_ps(_mm_mul_ps(tx, ny), _mm_mul_ps(ty, nx)));
+    }
+
+    // the same operations as Vector::normalized(), for 4 vectors at once
+    SKINNING_INLINE void normalize(__m128& x, __m128& y, __m128& z)
+    {
+        const __m128 S = _mm_rsqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        x = _mm_mul_ps(x, S);
+        y = _mm_mul_ps(y, S);
+        z = _mm_mul_ps(z, S);
+    }
+
+    // finishes a batch of 4 skinned vertices and writes them out
+    // attributes are (x, y, z) rows with one vertex per lane
+    SKINNING_INLINE void store(const int* const lanes, __m128* const attributes, const Vertex* const source, Vertex* const vertices)
+    {
+        normalize(attributes[NormalX], attributes[NormalY], attributes[NormalZ]);
+        normalize(attributes[TangentX], attributes[TangentY], attributes[TangentZ]);
+        normalize(attributes[BitangentX], attributes[BitangentY], attributes[BitangentZ]);
+
+        // transpose back to one (x, y, z, 0) vector per lane
+        __m128 values[AttributeCount / 3][4];
+        for(int i=0; i<AttributeCount / 3; ++i) {
+            __m128* const v = values[i];
+            v[0] = attributes[i * 3];
+            v[1] = attributes[(i * 3) + 1];
+            v[2] = attributes[(i * 3) + 2];
+            v[3] = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+        }
+
+        for(int i=0; i<4; ++i) {
+            if(lanes[i] < 0) {
+                continue;
+            }
+
+            const Vertex& meshvertex(source[lanes[i]]);
+
+            Vertex& vertex(vertices[lanes[i]]);
+            vertex.index = meshvertex.index;
+            _mm_storeu_ps(&vertex.position[0], values[0][i]);
+            _mm_storeu_ps(&vertex.normal[0], values[1][i]);
+            _mm_storeu_ps(&vertex.tangent[0], values[2][i]);
+            _mm_storeu_ps(&vertex.bitangent[0], values[3][i]);
+            vertex.texture_coords = meshvertex.texture_coords;
+        }
+    }
+#endif
+
+#if defined USE_AVX2
+    __attribute__((target("avx2")))
+    inline void rotate(__m256 qx, __m256 qy, __m256 qz, __m256 qw, __m256 vx, __m256 vy, __m256 vz, __m256& rx, __m256& ry, __m256& rz)
+    {
+        const __m256 ts = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(qx, vx), _mm256_mul_ps(qy, vy)), _mm256_mul_ps(qz, vz)));
+        const __m256 tx = _mm256_add_ps(_mm256_mul_ps(qw, vx), _mm256_sub_ps(_mm256_mul_ps(qy, vz), _mm256_mul_ps(qz, vy)));
+        const __m256 ty = _mm256_add_ps(_mm256_mul_ps(qw, vy), _mm256_sub_ps(_mm256_mul_ps(qz, vx), _mm256_mul_ps(qx, vz)));
+        const __m256 tz = _mm256_add_ps(_mm256_mul_ps(qw, vz), _mm256_sub_ps(_mm256_mul_ps(qx, vy), _mm256_mul_ps(qy, vx)));
+
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 nx = _mm256_sub_ps(zero, qx), ny = _mm256_sub_ps(zero, qy), nz = _mm256_sub_ps(zero, qz);
+        rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ts, nx), _mm256_mul_ps(qw, tx)), _mm256_sub_ps(_mm256_mul_ps(ty, nz), _mm256_mul_ps(tz, ny)));
+        ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ts, ny), _mm256_mul_ps(qw, ty)), _mm256_sub_ps(_mm256_mul_ps(tz, nx), _mm256_mul_ps(tx, nz)));
+        rz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ts, nz), _mm256_mul_ps(qw, tz)), _mm256_sub_ps(_mm256_mul_ps(tx, ny), _mm256_mul_ps(ty, nx)));
+    }
+#endif
+}
+
+Logger& Skinning::logger(Logger::instance("md5mv.Skinning"));
+Skinning::Kernel Skinning::_kernel(Skinning::best_kernel());
+
+Skinning::Kernel Skinning::best_kernel()
+{
+#if defined USE_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return AVX2Kernel;
+    }
+#endif
+
+#if defined USE_SSE
+    return SSEKernel;
+#else
+    return ScalarKernel;
+#endif
+}
+
+const char* Skinning::kernel_name(Kernel kernel)
+{
+    switch(kernel)
+    {
+    case ScalarKernel:
+        return "scalar";
+    case SSEKernel:
+        return "SSE3";
+    case AVX2Kernel:
+        return "AVX2";
+    case PaletteKernel:
+        return "4-influence matrix palette";
+    }
+    return "unknown";
+}
+
+Skinning::Skinning()
+{
+}
+
+Skinning::~Skinning() throw()
+{
+}
+
+void Skinning::build(const Skeleton& skeleton, const Vertex* const vertices, size_t vertex_count, const Weight* const weights)
+{
+    // batch vertices with the same number of weights together to keep the padding down
+    std::vector<int> order(vertex_count);
+    for(size_t i=0; i<vertex_count; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), WeightCountLess(vertices));
+
+    _batches.clear();
+
+    size_t slots = 0;
+    for(size_t i=0; i<vertex_count; i+=MAX_LANES) {
+        Batch batch;
+        batch.start = slots;
+        batch.count = 0;
+        for(size_t j=i; j<vertex_count && j<i+MAX_LANES; ++j) {
+            batch.count = MAX(batch.count, static_cast<size_t>(vertices[order[j]].weight_count));
+        }
+
+        _batches.push_back(batch);
+        slots += batch.count;
+    }
+
+    // padding weights have no influence
+    _vertex.assign(_batches.size() * MAX_LANES, -1);
+    _joint.assign(slots * MAX_LANES, 0);
+    _weight.assign(slots * MAX_LANES, 0.0f);
+    for(int i=0; i<3; ++i) {
+        _position[i].assign(slots * MAX_LANES, 0.0f);
+        _normal[i].assign(slots * MAX_LANES, 0.0f);
+        _tangent[i].assign(slots * MAX_LANES, 0.0f);
+        _bitangent[i].assign(slots * MAX_LANES, 0.0f);
+    }
+
+    // each vertex keeps its weights in order so that
+    // they're summed the same way the scalar path sums them
+    for(size_t i=0; i<vertex_count; ++i) {
+        const size_t b = i / MAX_LANES, lane = i % MAX_LANES;
+        const Vertex& vertex(vertices[order[i]]);
+
+        _vertex[i] = order[i];
+        for(int j=0; j<vertex.weight_count; ++j) {
+            const Weight& weight(weights[vertex.weight_start + j]);
+            const size_t w = ((_batches[b].start + j) * MAX_LANES) + lane;
+
+            _joint[w] = weight.joint;
+            _weight[w] = weight.weight;
+            for(int k=0; k<3; ++k) {
+                _position[k][w] = weight.position[k];
+                _normal[k][w] = weight.normal[k];
+                _tangent[k][w] = weight.tangent[k];
+                _bitangent[k][w] = weight.bitangent[k];
+            }
+        }
+    }
+
+    build_influences(skeleton, vertices, vertex_count, weights);
+}
+
+void Skinning::build_palette(const Skeleton& skeleton, float* const palette) const
+{
+    for(size_t i=0; i<skeleton.joint_count(); ++i) {
+        const Quaternion orientation(skeleton.orientation(i));
+        const Vector3 x(orientation * Vector3(1.0f, 0.0f, 0.0f)),
+            y(orientation * Vector3(0.0f, 1.0f, 0.0f)),
+            z(orientation * Vector3(0.0f, 0.0f, 1.0f));
+
+        const float* const inverse = &_inverse_bind[i * PALETTE_STRIDE];
+        float* const m = palette + (i * PALETTE_STRIDE);
+        for(int j=0; j<4; ++j) {
+            const float* const column = inverse + (j * 4);
+
+            Vector3 v((x * column[0]) + (y * column[1]) + (z * column[2]));
+            if(3 == j) {
+                v += skeleton.position(i);
+            }
+
+            m[(j * 4) + 0] = v.x();
+            m[(j * 4) + 1] = v.y();
+            m[(j * 4) + 2] = v.z();
+            m[(j * 4) + 3] = 0.0f;
+        }
+    }
+}
+
+bool Skinning::supports(Kernel kernel) const
+{
+    switch(kernel)
+    {
+    case PaletteKernel:
+        // skeletons with too many joints don't get influences
+        return has_influences();
+    case SSEKernel:
+    case AVX2Kernel:
+#if defined USE_SSE
+        return !empty();
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+void Skinning::skin(Kernel kernel, const Skeleton& skeleton, const Vertex* const source, Vertex* const vertices) const
+{
+    assert(supports(kernel));
+
+    if(PaletteKernel == kernel) {
+        // has_influences() means the skeleton fits
+        float palette[MAX_PALETTE_JOINTS * PALETTE_STRIDE];
+        build_palette(skeleton, palette);
+        skin_palette(palette, source, vertices);
+        return;
+    }
+
+#if defined USE_SSE
+    // the skeleton's joints are already laid out the way the kernels gather them
+    const float* const joints = skeleton.joints();
+
+    switch(kernel)
+    {
+    case AVX2Kernel:
+        skin_avx2(joints, source, vertices);
+        break;
+    default:
+        skin_sse(joints, source, vertices);
+        break;
+    }
+#endif
+}
+
+void Skinning::skin_sse(const float* const joints, const Vertex* const source, Vertex* const vertices) const
+{
+#if defined USE_SSE
+    for(size_t i=0; i<_batches.size(); ++i) {
+        const Batch& batch(_batches[i]);
+        for(size_t half=0; half<MAX_LANES; half+=4) {
+            // lanes are filled in order, so this half is empty
+            const int* const lanes = &_vertex[(i * MAX_LANES) + half];
+            if(lanes[0] < 0) {
+                break;
+            }
+
+            __m128 attributes[AttributeCount];
+            for(int j=0; j<AttributeCount; ++j) {
+                attributes[j] = _mm_setzero_ps();
+            }
+
+            for(size_t j=0; j<batch.count; ++j) {
+                const size_t w = ((batch.start + j) * MAX_LANES) + half;
+
+                // gather the joints and transpose them into (x, y, z, w) rows
+                const float *j0 = joints + (_joint[w] * JOINT_STRIDE), *j1 = joints + (_joint[w + 1] * JOINT_STRIDE),
+                    *j2 = joints + (_joint[w + 2] * JOINT_STRIDE), *j3 = joints + (_joint[w + 3] * JOINT_STRIDE);
+
+                __m128 qx = _mm_loadu_ps(j0), qy = _mm_loadu_ps(j1), qz = _mm_loadu_ps(j2), qw = _mm_loadu_ps(j3);
+                _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+                __m128 px = _mm_loadu_ps(j0 + 4), py = _mm_loadu_ps(j1 + 4), pz = _mm_loadu_ps(j2 + 4), pw = _mm_loadu_ps(j3 + 4);
+                _MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+                // position is weighted, the others are normalized when they're stored
+                const __m128 weight = _mm_loadu_ps(&_weight[w]);
+                __m128 rx, ry, rz;
+                rotate(qx, qy, qz, qw, _mm_loadu_ps(&_position[0][w]), _mm_loadu_ps(&_position[1][w]), _mm_loadu_ps(&_position[2][w]), rx, ry, rz);
+                attributes[PositionX] = _mm_add_ps(attributes[PositionX], _mm_mul_ps(_mm_add_ps(rx, px), weight));
+                attributes[PositionY] = _mm_add_ps(attributes[PositionY], _mm_mul_ps(_mm_add_ps(ry, py), weight));
+                attributes[PositionZ] = _mm_add_ps(attributes[PositionZ], _mm_mul_ps(_mm_add_ps(rz, pz), weight));
+
+                rotate(qx, qy, qz, qw, _mm_loadu_ps(&_normal[0][w]), _mm_loadu_ps(&_normal[1][w]), _mm_loadu_ps(&_normal[2][w]), rx, ry, rz);
+                attributes[NormalX] = _mm_add_ps(attributes[NormalX], rx);
+                attributes[NormalY] = _mm_add_ps(attributes[NormalY], ry);
+                attributes[NormalZ] = _mm_add_ps(attributes[NormalZ], rz);
+
+                rotate(qx, qy, qz, qw, _mm_loadu_ps(&_tangent[0][w]), _mm_loadu_ps(&_tangent[1][w]), _mm_loadu_ps(&_tangent[2][w]), rx, ry, rz);
+                attributes[TangentX] = _mm_add_ps(attributes[TangentX], rx);
+                attributes[TangentY] = _mm_add_ps(attributes[TangentY], ry);
+                attributes[TangentZ] = _mm_add_ps(attributes[TangentZ], rz);
+
+                rotate(qx, qy, qz, qw, _mm_loadu_ps(&_bitangent[0][w]), _mm_loadu_ps(&_bitangent[1][w]), _mm_loadu_ps(&_bitangent[2][w]), rx, ry, rz);
+                attributes[BitangentX] = _mm_add_ps(attributes[BitangentX], rx);
+                attributes[BitangentY] = _mm_add_ps(attributes[BitangentY], ry);
+                attributes[BitangentZ] = _mm_add_ps(attributes[BitangentZ], rz);
+            }
+
+            store(lanes, attributes, source, vertices);
+        }
+    }
+#endif
+}
+
+#if defined USE_AVX2
+__attribute__((target("avx2")))
+#endif
+void Skinning::skin_avx2(const float* const joints, const Vertex* const source, Vertex* const vertices) const
+{
+#if defined USE_AVX2
+    for(size_t i=0; i<_batches.size(); ++i) {
+        const Batch& batch(_batches[i]);
+        const int* const lanes = &_vertex[i * MAX_LANES];
+
+        __m256 attributes[AttributeCount];
+        for(int j=0; j<AttributeCount; ++j) {
+            attributes[j] = _mm256_setzero_ps();
+        }
+
+        for(size_t j=0; j<batch.count; ++j) {
+            const size_t w = (batch.start + j) * MAX_LANES;
+
+            // gather the joints straight into (x, y, z, w) rows
+            const __m256i joint = _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&_joint[w])), 3);
+            const __m256 qx = _mm256_i32gather_ps(joints, joint, 4);
+            const __m256 qy = _mm256_i32gather_ps(joints + 1, joint, 4);
+            const __m256 qz = _mm256_i32gather_ps(joints + 2, joint, 4);
+            const __m256 qw = _mm256_i32gather_ps(joints + 3, joint, 4);
+            const __m256 px = _mm256_i32gather_ps(joints + 4, joint, 4);
+            const __m256 py = _mm256_i32gather_ps(joints + 5, joint, 4);
+            const __m256 pz = _mm256_i32gather_ps(joints + 6, joint, 4);
+
+            const __m256 weight = _mm256_loadu_ps(&_weight[w]);
+            __m256 rx, ry, rz;
+            rotate(qx, qy, qz, qw, _mm256_loadu_ps(&_position[0][w]), _mm256_loadu_ps(&_position[1][w]), _mm256_loadu_ps(&_position[2][w]), rx, ry, rz);
+            attributes[PositionX] = _mm256_add_ps(attributes[PositionX], _mm256_mul_ps(_mm256_add_ps(rx, px), weight));
+            attributes[PositionY] = _mm256_add_ps(attributes[PositionY], _mm256_mul_ps(_mm256_add_ps(ry, py), weight));
+            attributes[PositionZ] = _mm256_add_ps(attributes[PositionZ], _mm256_mul_ps(_mm256_add_ps(rz, pz), weight));
+
+            rotate(qx, qy, qz, qw, _mm256_loadu_ps(&_normal[0][w]), _mm256_loadu_ps(&_normal[1][w]), _mm256_loadu_ps(&_normal[2][w]), rx, ry, rz);
+            attributes[NormalX] = _mm256_add_ps(attributes[NormalX], rx);
+            attributes[NormalY] = _mm256_add_ps(attributes[NormalY], ry);
+            attributes[NormalZ] = _mm256_add_ps(attributes[NormalZ], rz);
+
+            rotate(qx, qy, qz, qw, _mm256_loadu_ps(&_tangent[0][w]), _mm256_loadu_ps(&_tangent[1][w]), _mm256_loadu_ps(&_tangent[2][w]), rx, ry, rz);
+            attributes[TangentX] = _mm256_add_ps(attributes[TangentX], rx);
+            attributes[TangentY] = _mm256_add_ps(attributes[TangentY], ry);
+            attributes[TangentZ] = _mm256_add_ps(attributes[TangentZ], rz);
+
+            rotate(qx, qy, qz, qw, _mm256_loadu_ps(&_bitangent[0][w]), _mm256_loadu_ps(&_bitangent[1][w]), _mm256_loadu_ps(&_bitangent[2][w]), rx, ry, rz);
+            attributes[BitangentX] = _mm256_add_ps(attributes[BitangentX], rx);
+            attributes[BitangentY] = _mm256_add_ps(attributes[BitangentY], ry);
+            attributes[BitangentZ] = _mm256_add_ps(attributes[BitangentZ], rz);
+        }
+
+        // finish each half as an SSE batch
+        for(size_t half=0; half<2; ++half) {
+            __m128 values[AttributeCount];
+            for(int j=0; j<AttributeCount; ++j) {
+                values[j] = 0 == half ? _mm256_castps256_ps128(attributes[j]) : _mm256_extractf128_ps(attributes[j], 1);
+            }
+            store(lanes + (half * 4), values, source, vertices);
+        }
+    }
+#else
+    skin_sse(joints, source, vertices);
+#endif
+}
+
+void Skinning::build_influences(const Skeleton& skeleton, const Vertex* const vertices, size_t vertex_count, const Weight* const weights)
+{
+    _influences.clear();
+    _bind.clear();
+    _inverse_bind.clear();
+
+    // joints are packed into bytes
+    if(skeleton.joint_count() > MAX_PALETTE_JOINTS) {
+        LOG_WARNING("Too many joints for palette skinning: " << skeleton.joint_count() << std::endl);
+        return;
+    }
+
+    // the rows of each bind rotation are the columns of its inverse
+    _inverse_bind.resize(skeleton.joint_count() * PALETTE_STRIDE);
+    for(size_t i=0; i<skeleton.joint_count(); ++i) {
+        const Quaternion orientation(skeleton.orientation(i));
+        const Position position(skeleton.position(i));
+        const Vector3 x(orientation * Vector3(1.0f, 0.0f, 0.0f)),
+            y(orientation * Vector3(0.0f, 1.0f, 0.0f)),
+            z(orientation * Vector3(0.0f, 0.0f, 1.0f));
+
+        float* const m = &_inverse_bind[i * PALETTE_STRIDE];
+        for(int j=0; j<3; ++j) {
+            m[(j * 4) + 0] = x[j];
+            m[(j * 4) + 1] = y[j];
+            m[(j * 4) + 2] = z[j];
+            m[(j * 4) + 3] = 0.0f;
+        }
+
+        for(int j=0; j<3; ++j) {
+            m[12 + j] = -((m[j] * position.x()) + (m[4 + j] * position.y()) + (m[8 + j] * position.z()));
+        }
+        m[15] = 0.0f;
+    }
+
+    _influences.resize(vertex_count);
+    _bind.resize(vertex_count * BIND_STRIDE);
+
+    size_t capped = 0;
+    for(size_t i=0; i<vertex_count; ++i) {
+        const Vertex& vertex(vertices[i]);
+
+        // skin the bind pose the same way the reference does
+        Position position;
+        Vector3 normal, tangent, bitangent;
+
+        Influence& influence(_influences[i]);
+        ZeroMemory(&influence, sizeof(Influence));
+
+        int count = 0;
+        for(int j=0; j<vertex.weight_count; ++j) {
+            const Weight& weight(weights[vertex.weight_start + j]);
+            const Quaternion orientation(skeleton.orientation(weight.joint));
+
+            position += (((orientation * weight.position) + skeleton.position(weight.joint)) * weight.weight);
+            normal += (orientation * weight.normal);
+            tangent += (orientation * weight.tangent);
+            bitangent += (orientation * weight.bitangent);
+
+            // keep the strongest influences in order
+            if(count == MAX_INFLUENCES && weight.weight <= influence.weight[MAX_INFLUENCES - 1]) {
+                continue;
+            }
+
+            int k = count < MAX_INFLUENCES ? count++ : MAX_INFLUENCES - 1;
+            for(; k > 0 && influence.weight[k - 1] < weight.weight; --k) {
+                influence.joint[k] = influence.joint[k - 1];
+                influence.weight[k] = influence.weight[k - 1];
+            }
+            influence.joint[k] = weight.joint;
+            influence.weight[k] = weight.weight;
+        }
+
+        if(vertex.weight_count > MAX_INFLUENCES) {
+            capped++;
+        }
+
+        float total = 0.0f;
+        for(int j=0; j<count; ++j) {
+            total += influence.weight[j];
+        }
+
+        if(total > 0.0f) {
+            for(int j=0; j<count; ++j) {
+                influence.weight[j] /= total;
+            }
+        }
+
+        normal.normalize();
+        tangent.normalize();
+        bitangent.normalize();
+
+        float* const bind = &_bind[i * BIND_STRIDE];
+        std::memcpy(bind, position.array(), sizeof(float) * 4);
+        std::memcpy(bind + 4, normal.array(), sizeof(float) * 4);
+        std::memcpy(bind + 8, tangent.array(), sizeof(float) * 4);
+        std::memcpy(bind + 12, bitangent.array(), sizeof(float) * 4);
+    }
+
+    if(capped > 0) {
+        LOG_INFO("Capped " << capped << " of " << vertex_count << " vertices to " << MAX_INFLUENCES << " influences" << std::endl);
+    }
+}
+
+void Skinning::skin_palette(const float* const palette, const Vertex* const source, Vertex* const vertices) const
+{
+    for(size_t i=0; i<_influences.size(); ++i) {
+        const Influence& influence(_influences[i]);
+        const float* const bind = bind_vertex(i);
+        const Vertex& meshvertex(source[i]);
+
+        Vertex& vertex(vertices[i]);
+        vertex.index = meshvertex.index;
+        vertex.texture_coords = meshvertex.texture_coords;
+
+#if defined USE_SSE
+        // blend the matrices, influences are sorted so unused ones are last
+        __m128 c[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+        for(int j=0; j<MAX_INFLUENCES && influence.weight[j] > 0.0f; ++j) {
+            const float* const m = palette + (influence.joint[j] * PALETTE_STRIDE);
+            const __m128 w = _mm_set1_ps(influence.weight[j]);
+            for(int k=0; k<4; ++k) {
+                c[k] = _mm_add_ps(c[k], _mm_mul_ps(_mm_loadu_ps(m + (k * 4)), w));
+            }
+        }
+
+        // and transform the bind-pose vertex
+        __m128 v[4];
+        for(int j=0; j<4; ++j) {
+            const float* const b = bind + (j * 4);
+            v[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(b[0])), _mm_mul_ps(c[1], _mm_set1_ps(b[1]))), _mm_mul_ps(c[2], _mm_set1_ps(b[2])));
+        }
+        v[0] = _mm_add_ps(v[0], c[3]);
+
+        // normalize the normal, tangent and bitangent together
+        __m128 x = v[1], y = v[2], z = v[3], w = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        const __m128 S = _mm_rsqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+
+        _mm_storeu_ps(&vertex.position[0], v[0]);
+        _mm_storeu_ps(&vertex.normal[0], _mm_mul_ps(v[1], _mm_shuffle_ps(S, S, _MM_SHUFFLE(0, 0, 0, 0))));
+        _mm_storeu_ps(&vertex.tangent[0], _mm_mul_ps(v[2], _mm_shuffle_ps(S, S, _MM_SHUFFLE(1, 1, 1, 1))));
+        _mm_storeu_ps(&vertex.bitangent[0], _mm_mul_ps(v[3], _mm_shuffle_ps(S, S, _MM_SHUFFLE(2, 2, 2, 2))));
+#else
+        float c[16];
+        std::memset(c, 0, sizeof(c));
+        for(int j=0; j<MAX_INFLUENCES && influence.weight[j] > 0.0f; ++j) {
+            const float* const m = palette + (influence.joint[j] * PALETTE_STRIDE);
+            for(int k=0; k<16; ++k) {
+                c[k] += m[k] * influence.weight[j];
+            }
+        }
+
+        Vector3* const attributes[4] = { &vertex.position, &vertex.normal, &vertex.tangent, &vertex.bitangent };
+        for(int j=0; j<4; ++j) {
+            const float* const b = bind + (j * 4);
+            for(int k=0; k<3; ++k) {
+                (*attributes[j])[k] = (c[k] * b[0]) + (c[4 + k] * b[1]) + (c[8 + k] * b[2]) + (0 == j ? c[12 + k] : 0.0f);
+            }
+            (*attributes[j])[3] = 0.0f;
+        }
+
+        vertex.normal.normalize();
+        vertex.tangent.normalize();
+        vertex.bitangent.normalize();
+#endif
+    }
+}
@@ -0,0 +1,117 @@
+#if !defined __SKINNING_H__
+#define __SKINNING_H__
+
+class Skeleton;
+struct Vertex;
+struct Weight;
+
+// vectorized CPU skinning
+// the vertices are skinned in batches, one vertex per lane, from a
+// structure-of-arrays copy of the weights (vertices are batched by weight count
+// and each weight slot of a batch is contiguous, padded with empty weights)
+// NOTE: Mesh::position_vertices() is the reference implementation
+//
+// the palette kernel is an approximation that instead blends up to
+// MAX_INFLUENCES (joint matrix * inverse bind matrix) matrices per vertex
+// and applies them to the bind-pose vertex
+class Skinning
+{
+public:
+    enum Kernel
+    {
+        ScalarKernel,
+        SSEKernel,
+        AVX2Kernel,
+        PaletteKernel
+    };
+
+    static const int MAX_INFLUENCES = 4;
+
+    // floats per joint in a palette
+    static const size_t PALETTE_STRIDE = 16;
+
+    // the strongest influences on a vertex, renormalized
+    // unused influences have a weight of 0
+    struct Influence
+    {
+        uint8_t joint[MAX_INFLUENCES];
+        float weight[MAX_INFLUENCES];
+    };
+
+public:
+    // the best kernel supported by this machine
+    static Kernel best_kernel();
+
+    // the kernel that meshes skin with
+    static Kernel kernel() { return _kernel; }
+    static void kernel(Kernel kernel) { _kernel = kernel; }
+
+    static const char* kernel_name(Kernel kernel);
+
+private:
+    static Logger& logger;
+    static Kernel _kernel;
+
+public:
+    Skinning();
+    virtual ~Skinning() throw();
+
+public:
+    bool empty() const { return _batches.empty(); }
+
+    // skeleton is the bind pose
+    void build(const Skeleton& skeleton, const Vertex* const vertices, size_t vertex_count, const Weight* const weights);
+
+    bool has_influences() const { return !_influences.empty(); }
+    const Influence& influence(size_t idx) const { return _influences[idx]; }
+
+    // bind-pose (position, normal, tangent, bitangent) for a vertex
+    const float* bind_vertex(size_t idx) const { return &_bind[idx * BIND_STRIDE]; }
+
+    // builds the joint matrix * inverse bind matrix for each joint
+    // each matrix is 4 (x, y, z, 0) columns, the last being the translation
+    void build_palette(const Skeleton& skeleton, float* const palette) const;
+
+    // false if the kernel can't skin these vertices, Mesh::position_vertices()
+    // falls back to the reference implementation for those
+    bool supports(Kernel kernel) const;
+
+    // skins the vertices using the given kernel, which must be supported
+    // vertices must hold as many vertices as were built from
+    void skin(Kernel kernel, const Skeleton& skeleton, const Vertex* const source, Vertex* const vertices) const;
+
+private:
+    static const size_t BIND_STRIDE = 16;
+
+    struct Batch
+    {
+        // first weight slot and number of slots
+        size_t start, count;
+    };
+
+private:
+    void skin_sse(const float* const joints, const Vertex* const source, Vertex* const vertices) const;
+    void skin_avx2(const float* const joints, const Vertex* const source, Vertex* const vertices) const;
+
+    void build_influences(const Skeleton& skeleton, const Vertex* const vertices, size_t vertex_count, const Weight* const weights);
+    void skin_palette(const float* const palette, const Vertex* const source, Vertex* const vertices) const;
+
+private:
+    std::vector<Batch> _batches;
+
+    // the vertex for each lane of each batch, -1 for padding
+    std::vector<int> _vertex;
+
+    // each weight slot has one entry per lane
+    std::vector<int> _joint;
+    std::vector<float> _weight;
+    std::vector<float> _position[3];
+    std::vector<float> _normal[3], _tangent[3], _bitangent[3];
+
+    // palette skinning data
+    std::vector<Influence> _influences;
+    std::vector<float> _bind;
+    std::vector<float> _inverse_bind;
+};
+
+#endif
@@ -21,7 +21,10 @@ State::State()
     : _scene(new Scene()), _player(new Player()),
         _ambient_shader("ambient"), _vertex_shader("vertex"), _bump_shader("bump"),
         _pick_shader("pick"), _deferred_shader("deferred"),
+        _skinned_ambient_shader("skinned_ambient"), _skinned_vertex_shader("skinned_vertex"),
+        _skinned_bump_shader("skinned_bump"), _skinned_pick_shader("skinned_pick"),
         _shadow_point_shader("shadow_point"), _shadow_infinite_shader("shadow_infinite"),
+        _shadow_volume_shader("shadow_volume"), _skinned_shadow_volume_shader("skinned_shadow_volume"),
         _simple_shader("simple"), _gray_shader("gray"), _red_shader("red"), _green_shader("green"), _blue_shader("blue"),
         _render_wireframe(false), _render_skeleton(false), _render_normals(false), _render_bounds(false), _render_lights(true),
 _rotate_actors(false)
@@ -78,12 +81,53 @@ bool State::load_shaders()
         _shadow_infinite_shader.bind_fragment_data_location(0, "fragment_color");
         _shadow_infinite_shader.link();
 
+        _shadow_volume_shader.create();
+        _shadow_volume_shader.read_shader(shader_dir() / "shadow-volume.vert");
+        _shadow_volume_shader.read_shader(shader_dir() / "shadow-volume.geom");
+        _shadow_volume_shader.read_shader(shader_dir() / "shadow.frag");
+        _shadow_volume_shader.bind_fragment_data_location(0, "fragment_color");
+        _shadow_volume_shader.link();
+
+        _skinned_shadow_volume_shader.create();
+        _skinned_shadow_volume_shader.read_shader(shader_dir() / "skinned-shadow-volume.vert");
+        _skinned_shadow_volume_shader.read_shader(shader_dir() / "shadow-volume.geom");
+        _skinned_shadow_volume_shader.read_shader(shader_dir() / "shadow.frag");
+        _skinned_shadow_volume_shader.bind_fragment_data_location(0, "fragment_color");
+        _skinned_shadow_volume_shader.link();
+
         _pick_shader.create();
         _pick_shader.read_shader(shader_dir() / "no-geom.vert");
         _pick_shader.read_shader(shader_dir() / "pick.frag");
         _pick_shader.bind_fragment_data_location(0, "fragment_color");
         _pick_shader.link();
 
+        _skinned_ambient_shader.create();
+        _skinned_ambient_shader.read_shader(shader_dir() / "skinned.vert");
+        _skinned_ambient_shader.read_shader(shader_dir() / "simple.geom");
+        _skinned_ambient_shader.read_shader(shader_dir() / "ambient.frag");
+        _skinned_ambient_shader.bind_fragment_data_location(0, "fragment_color");
+        _skinned_ambient_shader.link();
+
+        _skinned_vertex_shader.create();
+        _skinned_vertex_shader.read_shader(shader_dir() / "skinned.vert");
+        _skinned_vertex_shader.read_shader(shader_dir() / "vertex.geom");
+        _skinned_vertex_shader.read_shader(shader_dir() / "vertex.frag");
+        _skinned_vertex_shader.bind_fragment_data_location(0, "fragment_color");
+        _skinned_vertex_shader.link();
+
+        _skinned_bump_shader.create();
+        _skinned_bump_shader.read_shader(shader_dir() / "skinned.vert");
+        _skinned_bump_shader.read_shader(shader_dir() / "bump.geom");
+        _skinned_bump_shader.read_shader(shader_dir() / "bump.frag");
+        _skinned_bump_shader.bind_fragment_data_location(0, "fragment_color");
+        _skinned_bump_shader.link();
+
+        _skinned_pick_shader.create();
+        _skinned_pick_shader.read_shader(shader_dir() / "skinned-no-geom.vert");
+        _skinned_pick_shader.read_shader(shader_dir() / "pick.frag");
+        _skinned_pick_shader.bind_fragment_data_location(0, "fragment_color");
+        _skinned_pick_shader.link();
+
         _deferred_shader.create();
         _deferred_shader.read_shader(shader_dir() / "deferred.vert");
         _deferred_shader.read_shader(shader_dir() / "deferred.frag");
@@ -42,11 +42,21 @@ public:
 
     Shader& pick_shader() { return _pick_shader; }
 
+    // variants that skin from a joint palette
+    Shader& skinned_ambient_shader() { return _skinned_ambient_shader; }
+    Shader& skinned_vertex_shader() { return _skinned_vertex_shader; }
+    Shader& skinned_bump_shader() { return _skinned_bump_shader; }
+    Shader& skinned_pick_shader() { return _skinned_pick_shader; }
+
     Shader& deferred_shader() { return _deferred_shader; }
 
     Shader& shadow_point_shader() { return _shadow_point_shader; }
     Shader& shadow_infinite_shader() { return _shadow_infinite_shader; }
 
+    // extrude the shadow volumes from triangles with adjacency
+    Shader& shadow_volume_shader() { return _shadow_volume_shader; }
+    Shader& skinned_shadow_volume_shader() { return _skinned_shadow_volume_shader; }
+
     Shader& simple_shader() { return _simple_shader; }
     Shader& gray_shader() { return _gray_shader; }
     Shader& red_shader() { return _red_shader; }
@@ -82,7 +92,8 @@ private:
     boost::shared_ptr<Player> _player;
 
     Shader _ambient_shader, _vertex_shader, _bump_shader, _pick_shader, _deferred_shader;
-    Shader _shadow_point_shader, _shadow_infinite_shader;
+    Shader _skinned_ambient_shader, _skinned_vertex_shader, _skinned_bump_shader, _skinned_pick_shader;
+    Shader _shadow_point_shader, _shadow_infinite_shader, _shadow_volume_shader, _skinned_shadow_volume_shader;
     Shader _simple_shader, _gray_shader, _red_shader, _green_shader, _blue_shader;
 
     TextFont _font;
@@ -2,8 +2,12 @@
 #include <iostream>
 #include <signal.h>
 #include "common.h"
+#include "math_util.h"
+#include "Animation.h"
 #include "ClientConfiguration.h"
 #include "Engine.h"
+#include "Model.h"
+#include "Skinning.h"
 
 boost::filesystem::path g_configfilename(client_conf());
 
@@ -137,6 +141,29 @@ int main(int argc, char* argv[])
     Logger& logger(Logger::instance("md5mv.main"));
 #if USE_SSE
     LOG_INFO("Using SSE" << std::endl);
+#endif
+    if(config.render_palette_skinning()) {
+        Skinning::kernel(Skinning::PaletteKernel);
+    }
+    if(config.render_skinning_gpu()) {
+        LOG_INFO("Using GPU skinning" << std::endl);
+    } else {
+        LOG_INFO("Using " << Skinning::kernel_name(Skinning::kernel()) << " skinning" << std::endl);
+    }
+    if(config.render_mesh_lods() > 1) {
+        Model::lods(config.render_mesh_lods(), config.render_lod_reduction());
+        LOG_INFO("Generating " << config.render_mesh_lods() << " mesh levels of detail" << std::endl);
+    }
+    if(config.animation_compress()) {
+        // the orientation error is configured in degrees
+        Animation::compression(true, config.animation_position_error(), DEG_RAD(config.animation_orientation_error()));
+        LOG_INFO("Compressing animations" << std::endl);
+    }
+#if USE_SSE
+    if(config.animation_interpolation_batch()) {
+        Animation::batch_interpolation(true, DEG_RAD(config.animation_nlerp_threshold()));
+        LOG_INFO("Using batch joint interpolation" << std::endl);
+    }
 #endif
     config.dump(logger);
 
@@ -61,9 +61,12 @@
 //#include <malloc.h>
 
 #define BOOST_ALL_NO_LIB
+#define BOOST_BIND_GLOBAL_PLACEHOLDERS
 #include <boost/version.hpp>
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/dynamic_bitset.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/path.hpp>
@@ -145,8 +148,11 @@ void operator=(const TypeName&)
     //#define rand rand_r
     #define strtok strtok_r
 
-    // TODO: memalign is obsoleted by posix_memalign
-    #define _aligned_malloc(s, b) memalign(b, s)
+    inline void* _aligned_malloc(size_t size, size_t alignment)
+    {
+        void* p = NULL;
+        return 0 == posix_memalign(&p, alignment, size) ? p : NULL;
+    }
     #define _aligned_free free
 #endif
 
@@ -0,0 +1,175 @@
+#include "pch.h"
+#include <fstream>
+#include <iostream>
+#include <boost/lexical_cast.hpp>
+#include "common.h"
+#include "CookedFile.h"
+#include "MD5Model.h"
+
+// corrupt and truncated cooked models have to be rejected (and the text
+// loaded instead) rather than trusted, run from the top of the tree
+
+namespace
+{
+    const char* const MODEL_PATH = "monsters/lostsoul";
+    const char* const MODEL_NAME = "lostsoul";
+
+    int failures = 0;
+
+    void fail(const std::string& what)
+    {
+        if(failures++ < 20) {
+            std::cerr << what << std::endl;
+        }
+    }
+
+    bool read_file(const boost::filesystem::path& filename, std::vector<char>& data)
+    {
+        std::ifstream file(filename.string().c_str(), std::ios::in | std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return file.good() || file.eof();
+    }
+
+    void write_file(const boost::filesystem::path& filename, const std::vector<char>& data, size_t size)
+    {
+        std::ofstream file(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(data.data(), size);
+    }
+
+    bool in_range(int value, int count)
+    {
+        return value >= 0 && value < count;
+    }
+
+    // everything the cache could index out of bounds with
+    bool valid(const MD5Model& model)
+    {
+        const int jcount = static_cast<int>(model.joint_count());
+        for(size_t i=0; i<model.joint_count(); ++i) {
+            const int parent = model.joint(i).parent;
+            if(parent != -1 && !in_range(parent, jcount)) {
+                return false;
+            }
+        }
+
+        for(size_t i=0; i<model.mesh_count(); ++i) {
+            const Mesh& mesh(model.mesh(i));
+            for(int j=0; j<mesh.vertex_count(); ++j) {
+                const Vertex& vertex(mesh.vertex(j));
+                if(vertex.weight_start < 0 || vertex.weight_count < 0 || vertex.weight_start + vertex.weight_count > mesh.weight_count()) {
+                    return false;
+                }
+            }
+
+            for(int j=0; j<mesh.triangle_count(); ++j) {
+                const Triangle& triangle(mesh.triangle(j));
+                if(!in_range(triangle.v1, mesh.vertex_count()) || !in_range(triangle.v2, mesh.vertex_count()) || !in_range(triangle.v3, mesh.vertex_count())) {
+                    return false;
+                }
+            }
+
+            for(int j=0; j<mesh.weight_count(); ++j) {
+                if(!in_range(mesh.weight(j).joint, jcount)) {
+                    return false;
+                }
+            }
+
+            for(size_t j=0; j<mesh.edge_count(); ++j) {
+                const Edge& edge(mesh.edge(j));
+                if(!in_range(edge.v1, mesh.vertex_count()) || !in_range(edge.v2, mesh.vertex_count())
+                    || !in_range(edge.t1, mesh.triangle_count()) || (edge.t2 != -1 && !in_range(edge.t2, mesh.triangle_count())))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void check_load(const std::string& what)
+    {
+        MD5Model model(MODEL_NAME);
+        if(!model.load(MODEL_PATH)) {
+            fail(what + ": load failed");
+        } else if(!valid(model)) {
+            fail(what + ": out of range index accepted");
+        }
+    }
+
+    // a read can't pass the end of the file, even when
+    // the padding of the last record would take it there
+    void check_padding()
+    {
+        const boost::filesystem::path source(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+        write_file(source, std::vector<char>(1, 'x'), 1);
+
+        {
+            CookedFileWriter writer;
+            writer.open(source, 1, 1);
+            writer.write(std::string("odd"));
+            writer.close();
+        }
+
+        std::vector<char> data;
+        read_file(CookedFile::filename(source), data);
+        write_file(CookedFile::filename(source), data, data.size() - 1);
+
+        CookedFile file;
+        std::string value;
+        if(!file.open(source, 1, 1) || !file.read(value) || "odd" != value) {
+            fail("trailing string wasn't read");
+        } else if(NULL != file.read<char>() || NULL != file.read<uint32_t>()) {
+            fail("read past the end of the file");
+        }
+        file.close();
+
+        boost::filesystem::remove(CookedFile::filename(source));
+        boost::filesystem::remove(source);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Logger::configure(Logger::LoggerTypeNone, Logger::LogLevelCritical, "");
+
+    check_padding();
+
+    // load once to make sure the cache exists
+    check_load("text");
+
+    const boost::filesystem::path cooked(CookedFile::filename(model_dir() / MODEL_PATH / (std::string(MODEL_NAME) + MD5Model::extension())));
+    std::vector<char> data;
+    if(!read_file(cooked, data) || data.empty()) {
+        std::cerr << "No cooked model at " << cooked << std::endl;
+        return 1;
+    }
+    check_load("cooked");
+
+    // truncated anywhere, including in the middle of a record's padding
+    const size_t step = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 7;
+    for(size_t size=0; size<data.size(); size+=step) {
+        write_file(cooked, data, size);
+        check_load("truncated to " + boost::lexical_cast<std::string>(size));
+    }
+
+    // every few words set to values that are out of range for any index
+    static const int32_t bad_values[] = { -2, -1, 0x7fffffff, 0x10000 };
+    for(size_t offset=0; offset + sizeof(int32_t) <= data.size(); offset+=sizeof(int32_t) * step) {
+        for(size_t i=0; i<sizeof(bad_values) / sizeof(bad_values[0]); ++i) {
+            std::vector<char> corrupt(data);
+            std::memcpy(&corrupt[offset], &bad_values[i], sizeof(int32_t));
+            write_file(cooked, corrupt, corrupt.size());
+            check_load("word at " + boost::lexical_cast<std::string>(offset) + " = " + boost::lexical_cast<std::string>(bad_values[i]));
+        }
+    }
+
+    write_file(cooked, data, data.size());
+
+    if(failures > 0) {
+        std::cerr << failures << " cooked model checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "corrupt and truncated cooked models are rejected" << std::endl;
+    return 0;
+}
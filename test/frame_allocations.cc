@@ -0,0 +1,150 @@
+#include "pch.h"
+#include <iostream>
+#include <new>
+#include "Camera.h"
+#include "ClientConfiguration.h"
+#include "Engine.h"
+#include "Font.h"
+#include "JobSystem.h"
+#include "PoseCache.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "State.h"
+#include "TextureManager.h"
+
+// the crowd scene goes through Scene::update() and Scene::render() the way
+// the engine runs a frame: Actor::on_think, the animation jobs (or the pose
+// cache and its jobs), the uploads, the silhouette jobs and the renderer,
+// none of which may touch the heap once it's warm, with the pose cache off
+// and on (where the walking imps land on new poses every frame)
+// NOTE: this needs a GL context
+
+namespace
+{
+    boost::atomic<size_t> allocations(0);
+}
+
+// the counting allocator
+void* operator new(std::size_t size)
+{
+    allocations++;
+    void* const p = std::malloc(size > 0 ? size : 1);
+    if(NULL == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    std::free(p);
+}
+
+namespace
+{
+    const char* const SCENE = "crowd";
+
+    const int WIDTH = 320;
+    const int HEIGHT = 240;
+    const size_t THREADS = 4;
+    const int WARM_FRAMES = 10;
+    const int FRAMES = 100;
+
+    // no pose cache and a few poses per animation frame
+    const int POSE_STEPS[] = { 0, 4 };
+
+    bool init()
+    {
+        if(!Renderer::instance().create_window(WIDTH, HEIGHT, 32, false, "frame_allocations")) {
+            std::cerr << "Unable to create the window!" << std::endl;
+            return false;
+        }
+
+        Engine::instance().init_jobs(THREADS);
+
+        return TextureManager::instance().init()
+            && TextFont::init()
+            && State::instance().load_font("courier", 24, Color(1.0f, 1.0f, 1.0f, 1.0f))
+            && State::instance().load_shaders();
+    }
+
+    bool run(int pose_steps)
+    {
+        ClientConfiguration::instance().set("game", "pose_steps", boost::lexical_cast<std::string>(pose_steps));
+        if(!State::instance().load_scene(SCENE)) {
+            std::cerr << "Could not load the " << SCENE << " scene" << std::endl;
+            return false;
+        }
+
+        Scene& scene(*State::instance().scene());
+        scene.camera().position(Position(150.0f, 80.0f, 400.0f));
+
+        JobSystem& jobs(Engine::instance().jobs());
+        const double dt = 1.0 / 60.0;
+
+        // the first frames grow the buffers, pools and caches
+        for(int i=0; i<WARM_FRAMES; ++i) {
+            scene.update(dt);
+            scene.render();
+        }
+
+        const PoseCache* const cache = scene.pose_cache();
+        const uint64_t misses = cache ? cache->misses() : 0;
+
+        const size_t counters = jobs.counters_allocated();
+        const size_t start = allocations;
+        for(int i=0; i<FRAMES; ++i) {
+            scene.update(dt);
+            scene.render();
+        }
+        const size_t count = allocations - start;
+
+        std::cout << count << " allocations in " << FRAMES << " frames of " << scene.actor_count() << " actors ("
+            << scene.skinned_actor_count() << " skinned) with " << pose_steps << " pose steps on "
+            << THREADS << " threads, " << jobs.counters_allocated() << " job counters" << std::endl;
+        if(count > 0 || jobs.counters_allocated() != counters) {
+            std::cerr << "The frame allocated" << std::endl;
+            return false;
+        }
+
+        // the cache has to have been building (and evicting) poses for it to count
+        if(pose_steps > 0) {
+            if(NULL == cache || cache->misses() == misses) {
+                std::cerr << "The pose cache never missed" << std::endl;
+                return false;
+            }
+            std::cout << (cache->misses() - misses) << " pose cache misses, " << (cache->hit_rate() * 100.0) << "% hit rate" << std::endl;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Logger::configure(Logger::LoggerTypeNone, Logger::LogLevelError, "");
+    if(!init()) {
+        return 1;
+    }
+
+    int result = 0;
+    for(size_t i=0; i<sizeof(POSE_STEPS) / sizeof(POSE_STEPS[0]); ++i) {
+        if(!run(POSE_STEPS[i])) {
+            result = 1;
+        }
+    }
+
+    State::instance().scene()->unload();
+    TextFont::shutdown();
+    SDL_Quit();
+    return result;
+}
@@ -0,0 +1,174 @@
+#include "pch.h"
+#include <iostream>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+#include "JobSystem.h"
+
+// stresses the job system at several thread counts: every parallel_for
+// index runs exactly once, jobs can wait on other jobs, continuations run
+// in order and jobs that throw still finish their counters
+// usage: job_system [iterations]
+
+namespace
+{
+    const size_t THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+
+    int failures = 0;
+
+    void fail(const std::string& what)
+    {
+        if(failures++ < 20) {
+            std::cerr << what << std::endl;
+        }
+    }
+
+    JobSystem* jobs = NULL;
+    boost::atomic<size_t> count(0);
+
+    void add(size_t)
+    {
+        count++;
+    }
+
+    void add_task()
+    {
+        count++;
+    }
+
+    void hit(std::vector<int>* hits, size_t idx)
+    {
+        (*hits)[idx]++;
+    }
+
+    // waits inside a job on jobs of its own
+    void nested(size_t)
+    {
+        jobs->wait(jobs->parallel_for(100, add, 7));
+    }
+
+    // recursive fork/join
+    void tree(int depth)
+    {
+        count++;
+        if(0 == depth) {
+            return;
+        }
+
+        JobSystem::Counter left(jobs->submit(boost::bind(&tree, depth - 1)));
+        JobSystem::Counter right(jobs->submit(boost::bind(&tree, depth - 1)));
+        jobs->wait(left);
+        jobs->wait(right);
+    }
+
+    // only ever runs on one thread at a time, the continuations are a chain
+    void append(std::vector<int>* order, int value)
+    {
+        order->push_back(value);
+    }
+
+    void throw_every_third(size_t idx)
+    {
+        count++;
+        if(0 == idx % 3) {
+            throw std::runtime_error("job " + boost::lexical_cast<std::string>(idx));
+        }
+    }
+
+    void throw_unknown()
+    {
+        throw 1;
+    }
+
+    void check(int iteration, const std::string& name)
+    {
+        // every index exactly once
+        std::vector<int> hits(100003, 0);
+        jobs->wait(jobs->parallel_for(hits.size(), boost::bind(&hit, &hits, _1), 1 + iteration * 13));
+        for(size_t i=0; i<hits.size(); ++i) {
+            if(1 != hits[i]) {
+                fail(name + ": index " + boost::lexical_cast<std::string>(i) + " ran " + boost::lexical_cast<std::string>(hits[i]) + " times");
+                break;
+            }
+        }
+
+        count = 0;
+        jobs->wait(jobs->parallel_for(100, nested));
+        if(100 * 100 != count) {
+            fail(name + ": nested parallel_for ran " + boost::lexical_cast<std::string>(count) + " items");
+        }
+
+        count = 0;
+        jobs->wait(jobs->submit(boost::bind(&tree, 10)));
+        if((1 << 11) - 1 != count) {
+            fail(name + ": fork/join ran " + boost::lexical_cast<std::string>(count) + " tasks");
+        }
+
+        // including continuations added after the counter finished
+        std::vector<int> order;
+        JobSystem::Counter previous(jobs->parallel_for(1000, add));
+        for(int i=0; i<500; ++i) {
+            previous = jobs->then(previous, boost::bind(&append, &order, i));
+        }
+        jobs->wait(previous);
+        for(int i=0; i<500; ++i) {
+            if(order.size() != 500 || order[i] != i) {
+                fail(name + ": continuations ran out of order");
+                break;
+            }
+        }
+
+        // fan-in, several continuations on one counter
+        count = 0;
+        JobSystem::Counter counter(jobs->parallel_for(64, add));
+        std::vector<JobSystem::Counter> continuations;
+        for(int i=0; i<16; ++i) {
+            continuations.push_back(jobs->then(counter, add_task));
+        }
+        for(int i=0; i<16; ++i) {
+            jobs->wait(continuations[i]);
+        }
+        if(64 + 16 != count) {
+            fail(name + ": fan-in ran " + boost::lexical_cast<std::string>(count) + " tasks");
+        }
+
+        if(!JobSystem::finished(jobs->parallel_for(0, add))) {
+            fail(name + ": an empty parallel_for isn't finished");
+        }
+        jobs->wait(jobs->then(jobs->parallel_for(0, add), add_task));
+
+        // waiting on jobs that throw has to return, and so do their continuations
+        const uint64_t failed = jobs->jobs_failed();
+        count = 0;
+        jobs->wait(jobs->then(jobs->parallel_for(99, throw_every_third), add_task));
+        jobs->wait(jobs->submit(throw_unknown));
+        if(99 + 1 != count || jobs->jobs_failed() - failed != 33 + 1) {
+            fail(name + ": jobs that threw didn't finish");
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int iterations = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 20;
+
+    Logger::configure(Logger::LoggerTypeNone, Logger::LogLevelError, "");
+
+    for(size_t i=0; i<sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); ++i) {
+        JobSystem system(THREAD_COUNTS[i]);
+        jobs = &system;
+
+        const std::string name(boost::lexical_cast<std::string>(THREAD_COUNTS[i]) + " threads");
+        for(int j=0; j<iterations; ++j) {
+            check(j, name);
+        }
+        jobs = NULL;
+    }
+
+    if(failures > 0) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All job system checks passed" << std::endl;
+    return 0;
+}
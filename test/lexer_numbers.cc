@@ -0,0 +1,249 @@
+#include "pch.h"
+#include <cerrno>
+#include <cmath>
+#include <iostream>
+#include "Lexer.h"
+
+// differential test of Lexer::parse_float() against strtod()
+// and Lexer::parse_integer() against strtol() with base 0
+// the inputs only use the characters Lexer::number_length() accepts
+
+namespace
+{
+    int failures = 0;
+
+    bool same_bits(double a, double b)
+    {
+        return 0 == std::memcmp(&a, &b, sizeof(double));
+    }
+
+    void check_float(const std::string& literal)
+    {
+        const char* const start = literal.c_str();
+        const char* const end = start + literal.length();
+
+        double expected = 0.0;
+        bool expected_ok = true;
+        if(!literal.empty()) {
+            char* strtod_end;
+            expected = strtod(start, &strtod_end);
+            expected_ok = strtod_end == end;
+        }
+
+        double actual;
+        const bool actual_ok = Lexer::parse_float(start, end, actual);
+        if(actual_ok != expected_ok || (expected_ok && !same_bits(actual, expected))) {
+            if(failures++ < 20) {
+                std::cerr.precision(17);
+                std::cerr << "parse_float(\"" << literal << "\") = " << actual_ok << " " << actual
+                    << ", strtod() = " << expected_ok << " " << expected << std::endl;
+            }
+        }
+    }
+
+    void check_integer(const std::string& literal)
+    {
+        const char* const start = literal.c_str();
+        const char* const end = start + literal.length();
+
+        long expected = 0;
+        bool expected_ok = true;
+        if(!literal.empty()) {
+            char* strtol_end;
+            errno = 0;
+            expected = strtol(start, &strtol_end, 0);
+            expected_ok = strtol_end == end;
+        }
+
+        long actual;
+        const bool actual_ok = Lexer::parse_integer(start, end, actual);
+        if(actual_ok != expected_ok || (expected_ok && actual != expected)) {
+            if(failures++ < 20) {
+                std::cerr << "parse_integer(\"" << literal << "\") = " << actual_ok << " " << actual
+                    << ", strtol() = " << expected_ok << " " << expected << std::endl;
+            }
+        }
+    }
+
+    // xorshift, so every run checks the same literals
+    uint64_t random_state = 88172645463325252ULL;
+    uint64_t next_random()
+    {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        return random_state;
+    }
+
+    std::string digits(size_t count)
+    {
+        std::string value;
+        for(size_t i=0; i<count; ++i) {
+            value += static_cast<char>('0' + (next_random() % 10));
+        }
+        return value;
+    }
+
+    std::string format(const char* const fmt, double value)
+    {
+        char buffer[MAX_BUFFER];
+        snprintf(buffer, MAX_BUFFER, fmt, value);
+        return buffer;
+    }
+
+    // literals around the edges of the exact single multiply or divide path
+    void check_fast_path_boundaries()
+    {
+        static const char* const literals[] =
+        {
+            // mantissas around 2^53
+            "9007199254740991", "9007199254740992", "9007199254740993", "9007199254740994",
+            "9007199254740993e1", "9007199254740993e-1", "900719925474099.3",
+            "18014398509481985", "18014398509481987",
+
+            // powers of 10 around 1e22
+            "1e22", "1e23", "1e-22", "1e-23", "9e22", "9e-22",
+            "4503599627370496e22", "4503599627370496e-22", "123456789e15", "123456789e-15",
+
+            // mantissas with 19 and 20 significant digits
+            "1234567890123456789", "12345678901234567890", "9999999999999999999",
+            "99999999999999999999", "0.1234567890123456789", "0.12345678901234567890",
+            "18446744073709551615", "18446744073709551616",
+
+            // long mantissas and leading or trailing zeros
+            "0.30000000000000000000000000000000000000001",
+            "2.225073858507201136057409796709131975934819546351645648023426109724822222021076945516529523908135087914149158913039621106870086438694594645527657207407820621743379988141063355305e-308",
+            "000000000000000000000000000000000000000001.5", "1.50000000000000000000000000000000000000000",
+            "0.000000000000000000000000000000000000000001", "100000000000000000000000000000000000000000",
+
+            // the classic hard cases
+            "0.1", "0.2", "0.3", "2.2250738585072011e-308", "2.2250738585072012e-308",
+            "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+            "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308",
+            "8.988465674311579e307", "3.14159265358979323846", "2.718281828459045235360",
+
+            // exponent extremes
+            "1e308", "1e309", "1e-324", "1e-400", "1e99999", "1e-99999", "0e99999", "1e000000000000000001",
+
+            // signs and zeros
+            "0", "-0", "0.0", "-0.0", "0e0", "-0e-0", "00", "-00.000",
+
+            // MD5 and proc forms
+            ".5", "-.5", "5.", "-5.", ".5e-3", "5.e3", "1E5", "1e+5", "1E-5", "-1.e+2",
+            "0.0000152588", "-0.9999999404", "-140.1234", "1024", "1.0e-05",
+
+            // things number_length() lets through that aren't numbers
+            "", "-", ".", "-.", "e5", "1e", "1e+", "1e-", "--1", "1-2", "1..2", "1.2.3", "-1-", "1e5e5", "1e-5-"
+        };
+
+        for(size_t i=0; i<sizeof(literals) / sizeof(literals[0]); ++i) {
+            check_float(literals[i]);
+        }
+    }
+
+    void check_random_floats(int count)
+    {
+        for(int i=0; i<count; ++i) {
+            std::string literal;
+            if(next_random() % 2) {
+                literal += '-';
+            }
+
+            // integer part, fraction part or both
+            const int form = next_random() % 3;
+            if(form != 1) {
+                literal += digits(1 + (next_random() % 25));
+            }
+            if(form != 0) {
+                literal += '.';
+                literal += digits(1 + (next_random() % 25));
+            }
+
+            if(next_random() % 2) {
+                literal += (next_random() % 2) ? 'e' : 'E';
+                switch(next_random() % 3)
+                {
+                case 0: literal += '-'; break;
+                case 1: literal += '+'; break;
+                }
+
+                // mostly small exponents, where the fast path applies
+                const int exponent = (next_random() % 4) ? (next_random() % 30) : (next_random() % 400);
+                char buffer[32];
+                snprintf(buffer, 32, "%d", exponent);
+                literal += buffer;
+            }
+            check_float(literal);
+        }
+    }
+
+    void check_round_trips(int count)
+    {
+        static const char* const formats[] = { "%.17g", "%.9g", "%.6f", "%.3e", "%.20e", "%.1f" };
+        for(int i=0; i<count; ++i) {
+            uint64_t bits = next_random();
+            double value;
+            std::memcpy(&value, &bits, sizeof(double));
+            if(std::isnan(value) || std::isinf(value)) {
+                continue;
+            }
+
+            // and values in the range the assets actually use
+            const double scaled = static_cast<double>(static_cast<int64_t>(next_random() % 2000000) - 1000000) / 1024.0;
+
+            for(size_t f=0; f<sizeof(formats) / sizeof(formats[0]); ++f) {
+                check_float(format(formats[f], value));
+                check_float(format(formats[f], scaled));
+            }
+        }
+    }
+
+    void check_integers(int count)
+    {
+        static const char* const literals[] =
+        {
+            "0", "-0", "1", "-1", "7", "8", "9", "10", "01", "07", "08", "017", "-017", "0777", "0778", "00",
+            "2147483647", "2147483648", "-2147483648", "-2147483649",
+            "9223372036854775807", "9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+            "18446744073709551616", "99999999999999999999999", "-99999999999999999999999",
+            "01777777777777777777777", "02000000000000000000000", "-01000000000000000000000", "-01000000000000000000001",
+            "", "-", "--1", "1-", "1-2", "-1-2", "1.5", ".5", "5."
+        };
+
+        for(size_t i=0; i<sizeof(literals) / sizeof(literals[0]); ++i) {
+            check_integer(literals[i]);
+        }
+
+        for(int i=0; i<count; ++i) {
+            std::string literal;
+            if(next_random() % 2) {
+                literal += '-';
+            }
+
+            // leading zeros are octal
+            if(0 == next_random() % 4) {
+                literal += '0';
+            }
+            literal += digits(1 + (next_random() % 21));
+            check_integer(literal);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int count = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    check_fast_path_boundaries();
+    check_random_floats(count);
+    check_round_trips(count / 4);
+    check_integers(count);
+
+    if(failures > 0) {
+        std::cerr << failures << " literals differ" << std::endl;
+        return 1;
+    }
+
+    std::cout << "parse_float() and parse_integer() match strtod() and strtol()" << std::endl;
+    return 0;
+}
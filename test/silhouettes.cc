@@ -0,0 +1,376 @@
+#include "pch.h"
+#include <iostream>
+#include "Animation.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "ModelManager.h"
+#include "Monster.h"
+#include "Plane.h"
+#include "TextureManager.h"
+
+// the silhouettes compute_silhouettes() finds with the facing bits and the
+// branch-free sweep have to be byte for byte what the old edge by edge test
+// (both triangle planes built per edge, per light) finds, for every level of
+// the shipped monsters over a few poses and lights all around them, and the
+// lights left out of the mask (40 of them, so past a word of bits) keep theirs,
+// and the one-winged edges of the open box run along their triangle's winding
+// NOTE: this needs a GL context for the renderables' buffers
+
+namespace
+{
+    struct TestModel
+    {
+        const char* path;
+        const char* name;
+        const char* animation;
+    };
+
+    const TestModel MODELS[] = {
+        { "monsters/imp", "imp", "walk1" },
+        { "monsters/hellknight", "hellknight", "idle2" },
+        { "monsters/pinky", "pinky", "idle1" },
+        { "monsters/lostsoul", "lostsoul", "walk1" },
+    };
+
+    // open meshes, so they have one-winged edges from both edge passes
+    const TestModel OPEN_MODELS[] = {
+        { "simple/box", "box2", NULL },
+    };
+
+    const size_t LODS = 4;
+    const int POSES = 4;
+    const int POSITIONAL_LIGHTS = 32;
+    const int DIRECTIONAL_LIGHTS = 8;
+
+    int failures = 0;
+
+    void fail(const std::string& what)
+    {
+        if(failures++ < 20) {
+            std::cerr << what << std::endl;
+        }
+    }
+
+    float random(float low, float high)
+    {
+        return low + (high - low) * (std::rand() / static_cast<float>(RAND_MAX));
+    }
+
+    // the old test, one-winged edges only count when the triangle that's there faces the light
+    bool is_silhouette_edge(const Renderable& renderable, const Mesh& mesh, size_t lod, const Edge& edge,
+        const Vector4& light_position, size_t vstart, bool& faces_light1)
+    {
+        Plane p1;
+        if(edge.t1 >= 0) {
+            const Triangle& t(mesh.triangle(lod, edge.t1));
+            p1 = Plane(renderable.vertex(vstart + t.v1).position, renderable.vertex(vstart + t.v2).position, renderable.vertex(vstart + t.v3).position);
+        }
+
+        Plane p2;
+        if(edge.t2 >= 0) {
+            const Triangle& t(mesh.triangle(lod, edge.t2));
+            p2 = Plane(renderable.vertex(vstart + t.v1).position, renderable.vertex(vstart + t.v2).position, renderable.vertex(vstart + t.v3).position);
+        }
+
+        faces_light1 = p1 * light_position > 0.0f;
+        const bool faces_light2 = p2 * light_position > 0.0f;
+
+        return ((edge.t1 >= 0 && edge.t2 >= 0 && ((faces_light1 && !faces_light2) || (!faces_light1 && faces_light2)))
+            || ((edge.t1 < 0 || edge.t2 < 0) && faces_light1));
+    }
+
+    // the old sweep writing the indices the new one does
+    template<typename Index>
+    size_t reference_silhouette(const Renderable& renderable, const Vector4& light_position, bool directional, std::vector<Index>& indices)
+    {
+        const Model& model(renderable.model());
+        const size_t lod = renderable.shadow_lod();
+        const size_t infinity = model.vertex_count();
+
+        indices.clear();
+        size_t vstart = 0;
+        for(size_t i=0; i<model.mesh_count(); ++i) {
+            const Mesh& mesh(model.mesh(i));
+
+            for(size_t j=0; j<mesh.edge_count(lod); ++j) {
+                const Edge& edge(mesh.edge(lod, j));
+
+                bool faces_light1;
+                if(!is_silhouette_edge(renderable, mesh, lod, edge, light_position, vstart, faces_light1)) {
+                    continue;
+                }
+
+                const size_t v1 = vstart + (faces_light1 ? edge.v2 : edge.v1);
+                const size_t v2 = vstart + (faces_light1 ? edge.v1 : edge.v2);
+                if(directional) {
+                    indices.push_back(static_cast<Index>(v1));
+                    indices.push_back(static_cast<Index>(v2));
+                    indices.push_back(static_cast<Index>(v1 + infinity));
+                } else {
+                    indices.push_back(static_cast<Index>(v1));
+                    indices.push_back(static_cast<Index>(v2));
+                    indices.push_back(static_cast<Index>(v2 + infinity));
+                    indices.push_back(static_cast<Index>(v1));
+                    indices.push_back(static_cast<Index>(v2 + infinity));
+                    indices.push_back(static_cast<Index>(v1 + infinity));
+                }
+            }
+            vstart += mesh.vertex_count();
+        }
+        return indices.size();
+    }
+
+    template<typename Index>
+    void compare(const Renderable& renderable, const Light& light, size_t idx, bool directional, const std::string& what)
+    {
+        Matrix4 matrix;
+        renderable.transform(matrix);
+
+        const Vector4 light_position(directional
+            ? -matrix * dynamic_cast<const DirectionalLight&>(light).direction()
+            : -matrix * dynamic_cast<const PositionalLight&>(light).position().homogeneous_position());
+
+        std::vector<Index> expected;
+        const size_t count = reference_silhouette(renderable, light_position, directional, expected);
+        if(count != renderable.silhouette_index_count(idx)) {
+            fail(what + ": " + boost::lexical_cast<std::string>(renderable.silhouette_index_count(idx))
+                + " indices, expected " + boost::lexical_cast<std::string>(count));
+            return;
+        }
+
+        if(count > 0 && 0 != std::memcmp(&expected[0], renderable.silhouette_indices(idx), count * sizeof(Index))) {
+            fail(what + ": the indices differ");
+        }
+    }
+
+    // counts the silhouettes checked and the one-winged edges they covered
+    size_t checked = 0, one_winged = 0;
+
+    // new places every time so nothing is cached
+    void move_lights(const Lights& lights, const AABB& bounds)
+    {
+        for(size_t i=0; i<lights.size(); ++i) {
+            const Position offset(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f));
+            if(i < static_cast<size_t>(POSITIONAL_LIGHTS)) {
+                lights[i]->position(bounds.center() + offset * (bounds.radius() * random(1.0f, 4.0f)));
+            } else {
+                dynamic_cast<DirectionalLight&>(*lights[i]).direction(Direction(offset.x(), offset.y(), offset.z()));
+            }
+            lights[i]->enable();
+        }
+    }
+
+    std::string describe(const TestModel& test, const Monster& monster, int pose, size_t idx)
+    {
+        return std::string(test.name) + " shadow lod " + boost::lexical_cast<std::string>(monster.shadow_lod())
+            + " pose " + boost::lexical_cast<std::string>(pose)
+            + (idx >= static_cast<size_t>(POSITIONAL_LIGHTS) ? " directional" : " positional")
+            + " light " + boost::lexical_cast<std::string>(idx);
+    }
+
+    // the silhouette for a moved light has to be found again and match the old test
+    void check(const Monster& monster, const Lights& lights, size_t idx, const std::string& what)
+    {
+        const bool directional = idx >= static_cast<size_t>(POSITIONAL_LIGHTS);
+        if(monster.silhouette_cached(idx)) {
+            fail(what + ": the moved light was cached");
+        } else if(monster.short_shadow_indices()) {
+            compare<uint16_t>(monster, *lights[idx], idx, directional, what);
+        } else {
+            compare<uint32_t>(monster, *lights[idx], idx, directional, what);
+        }
+        checked++;
+    }
+
+    std::vector<char> silhouette_bytes(const Monster& monster, size_t idx)
+    {
+        const char* const indices = static_cast<const char*>(monster.silhouette_indices(idx));
+        const size_t size = monster.silhouette_index_count(idx) * (monster.short_shadow_indices() ? sizeof(uint16_t) : sizeof(uint32_t));
+        return std::vector<char>(indices, indices + size);
+    }
+
+    bool run(const TestModel& test)
+    {
+        if(!ModelManager::instance().load_model(test.path, test.name)
+            || !ModelManager::instance().load_animation(test.path, test.name, test.animation))
+        {
+            std::cerr << "Could not load " << test.path << std::endl;
+            return false;
+        }
+
+        boost::shared_ptr<Animation> animation(ModelManager::instance().animation(test.name, test.animation));
+        Monster monster(test.name);
+        monster.init();
+        monster.model(ModelManager::instance().model(test.name));
+        monster.animation(animation);
+
+        const Model& model(monster.model());
+        for(size_t i=0; i<model.mesh_count(); ++i) {
+            for(size_t lod=0; lod<model.lod_count(); ++lod) {
+                for(size_t j=0; j<model.mesh(i).edge_count(lod); ++j) {
+                    one_winged += model.mesh(i).edge(lod, j).t2 < 0 ? 1 : 0;
+                }
+            }
+        }
+
+        // the monster is at the origin
+        const AABB bounds(model.bounds());
+        const float radius = bounds.radius();
+        Lights lights;
+        for(int i=0; i<POSITIONAL_LIGHTS; ++i) {
+            lights.push_back(boost::shared_ptr<Light>(new PositionalLight()));
+        }
+        for(int i=0; i<DIRECTIONAL_LIGHTS; ++i) {
+            lights.push_back(boost::shared_ptr<Light>(new DirectionalLight()));
+        }
+
+        // every light, and only the ones past the first 32 bits
+        LightMask all(lights.size()), high(lights.size());
+        all.set();
+        for(size_t i=32; i<lights.size(); ++i) {
+            high.set(i);
+        }
+
+        // backing the camera away walks the levels, the shadows stay a bias coarser
+        Camera camera;
+        for(size_t lod=0; lod<model.lod_count(); ++lod) {
+            camera.position(bounds.center() + Position(0.0f, 0.0f, radius * 3.0f * static_cast<float>(1 << lod)));
+
+            for(int pose=0; pose<POSES; ++pose) {
+                // thinking picks up the frame's bounds
+                monster.current_frame((pose * animation->frame_count()) / POSES);
+                monster.think(0.0);
+                monster.select_lod(camera);
+                monster.animate();
+                monster.commit_vertices();
+
+                // new places every time so nothing is cached
+                move_lights(lights, bounds);
+                monster.compute_silhouettes(lights, all);
+                for(size_t i=0; i<lights.size(); ++i) {
+                    check(monster, lights, i, describe(test, monster, pose, i));
+                }
+
+                // the lights without their bit keep the silhouettes they had
+                std::vector<std::vector<char> > kept(lights.size());
+                for(size_t i=0; i<lights.size(); ++i) {
+                    if(!high.test(i)) {
+                        kept[i] = silhouette_bytes(monster, i);
+                    }
+                }
+
+                move_lights(lights, bounds);
+                monster.compute_silhouettes(lights, high);
+                for(size_t i=0; i<lights.size(); ++i) {
+                    const std::string what(describe(test, monster, pose, i) + " masked");
+                    if(high.test(i)) {
+                        check(monster, lights, i, what);
+                    } else if(silhouette_bytes(monster, i) != kept[i]) {
+                        fail(what + ": the light was found again without its bit");
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // whether v1 is followed by v2 going around the triangle
+    bool follows_winding(const Triangle& triangle, int v1, int v2)
+    {
+        return (triangle.v1 == v1 && triangle.v2 == v2)
+            || (triangle.v2 == v1 && triangle.v3 == v2)
+            || (triangle.v3 == v1 && triangle.v1 == v2);
+    }
+
+    // the silhouettes extrude one-winged edges in the order they're stored,
+    // so they have to go the way their only triangle winds
+    size_t winding_checked = 0;
+
+    bool check_winding(const TestModel& test)
+    {
+        if(!ModelManager::instance().load_model(test.path, test.name)) {
+            std::cerr << "Could not load " << test.path << std::endl;
+            return false;
+        }
+
+        size_t count = 0;
+        const Model& model(*ModelManager::instance().model(test.name));
+        for(size_t i=0; i<model.mesh_count(); ++i) {
+            const Mesh& mesh(model.mesh(i));
+            for(size_t lod=0; lod<model.lod_count(); ++lod) {
+                for(size_t j=0; j<mesh.edge_count(lod); ++j) {
+                    const Edge& edge(mesh.edge(lod, j));
+                    if(edge.t2 >= 0) {
+                        continue;
+                    }
+
+                    if(!follows_winding(mesh.triangle(lod, edge.t1), edge.v1, edge.v2)) {
+                        fail(std::string(test.name) + " mesh " + boost::lexical_cast<std::string>(i)
+                            + " lod " + boost::lexical_cast<std::string>(lod)
+                            + " edge " + boost::lexical_cast<std::string>(j) + ": runs against its triangle");
+                    }
+                    count++;
+                }
+            }
+        }
+
+        if(0 == count) {
+            fail(std::string(test.name) + ": no one-winged edges, the mesh is closed");
+        }
+        winding_checked += count;
+        return true;
+    }
+
+    bool create_context()
+    {
+        if(SDL_Init(SDL_INIT_VIDEO) < 0) {
+            std::cerr << "Could not initialize SDL: " << SDL_GetError() << std::endl;
+            return false;
+        }
+
+        if(NULL == SDL_SetVideoMode(64, 64, 0, SDL_OPENGL)) {
+            std::cerr << "Unable to set video mode!" << std::endl;
+            return false;
+        }
+
+        // the boxes fall back on the default textures
+        return GLEW_OK == glewInit() && TextureManager::instance().init();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Logger::configure(Logger::LoggerTypeNone, Logger::LogLevelError, "");
+    if(!create_context()) {
+        return 1;
+    }
+
+    Model::lods(LODS, 0.5f);
+    std::srand(19);
+
+    int result = 0;
+    for(size_t i=0; i<sizeof(OPEN_MODELS) / sizeof(OPEN_MODELS[0]); ++i) {
+        if(!check_winding(OPEN_MODELS[i])) {
+            result = 1;
+        }
+    }
+
+    for(size_t i=0; i<sizeof(MODELS) / sizeof(MODELS[0]); ++i) {
+        if(!run(MODELS[i])) {
+            result = 1;
+            break;
+        }
+    }
+
+    SDL_Quit();
+
+    std::cout << winding_checked << " open mesh one-winged edges checked against their triangle" << std::endl;
+    std::cout << checked << " silhouettes checked over " << one_winged << " one-winged edges, " << failures << " failures" << std::endl;
+    if(failures > 0) {
+        std::cerr << "The edges or the silhouettes are wrong" << std::endl;
+        result = 1;
+    }
+    return result;
+}
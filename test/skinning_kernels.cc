@@ -0,0 +1,303 @@
+#include "pch.h"
+#include <iostream>
+#include "common.h"
+#include "MD5Animation.h"
+#include "MD5Model.h"
+#include "Renderable.h"
+#include "Skinning.h"
+
+// every skinning kernel has to match what it computes done the slow way over
+// every frame of the shipped monsters' animations: the vectorized kernels the
+// scalar reference, the palette its own 4-influence approximation (how far that
+// is from the reference is only reported), and the kernels a mesh can't use
+// have to fall back to the reference, run from the top of the tree
+
+namespace
+{
+    // position errors are relative to the model's bounding radius,
+    // normal (and tangent) errors are in degrees
+    struct Tolerance
+    {
+        float max_position, mean_position;
+        float max_normal, mean_normal;
+    };
+
+    // the kernels only reorder the math of what they're checked against
+    const Tolerance TOLERANCE = { 1e-4f, 1e-5f, 0.1f, 0.01f };
+
+    int failures = 0;
+
+    void fail(const std::string& what)
+    {
+        if(failures++ < 20) {
+            std::cerr << what << std::endl;
+        }
+    }
+
+    // degrees between two directions
+    float angle(const Vector3& a, const Vector3& b)
+    {
+        const float length = a.length() * b.length();
+        if(length <= 0.0f) {
+            return 0.0f;
+        }
+        return std::acos(std::min(std::max((a * b) / length, -1.0f), 1.0f)) * 180.0f / static_cast<float>(M_PI);
+    }
+
+    std::vector<Skinning::Kernel> kernels()
+    {
+        std::vector<Skinning::Kernel> kernels;
+#if defined USE_SSE
+        kernels.push_back(Skinning::SSEKernel);
+        if(Skinning::AVX2Kernel == Skinning::best_kernel()) {
+            kernels.push_back(Skinning::AVX2Kernel);
+        }
+#endif
+        kernels.push_back(Skinning::PaletteKernel);
+        return kernels;
+    }
+
+    struct Error
+    {
+        float max_position, max_normal;
+        double total_position, total_normal;
+        size_t count;
+
+        Error() : max_position(0.0f), max_normal(0.0f), total_position(0.0), total_normal(0.0), count(0) {}
+
+        void add(float position, float normal)
+        {
+            max_position = std::max(max_position, position);
+            max_normal = std::max(max_normal, normal);
+            total_position += position;
+            total_normal += normal;
+            count++;
+        }
+
+        float mean_position() const { return count > 0 ? static_cast<float>(total_position / count) : 0.0f; }
+        float mean_normal() const { return count > 0 ? static_cast<float>(total_normal / count) : 0.0f; }
+
+        bool within(const Tolerance& tolerance) const
+        {
+            return max_position <= tolerance.max_position && mean_position() <= tolerance.mean_position
+                && max_normal <= tolerance.max_normal && mean_normal() <= tolerance.mean_normal;
+        }
+    };
+
+    bool stronger(const Weight* const lhs, const Weight* const rhs)
+    {
+        return lhs->weight > rhs->weight;
+    }
+
+    // the palette's approximation done the slow way: the bind-pose vertex is
+    // moved by the strongest MAX_INFLUENCES joints, renormalized, each taking it
+    // from its bind pose to the frame's, which blends the same as the matrices do
+    void palette_reference(const MD5Model& model, const Skeleton& skeleton, boost::shared_array<Vertex> vertices)
+    {
+        const Skeleton& bind(model.skeleton());
+
+        size_t vstart = 0;
+        for(size_t i=0; i<model.mesh_count(); ++i) {
+            const Mesh& mesh(model.mesh(i));
+            for(int j=0; j<mesh.vertex_count(); ++j) {
+                const Vertex& meshvertex(mesh.vertex(j));
+
+                // the bind pose the reference skins
+                Position bind_position;
+                Vector3 bind_normal, bind_tangent;
+                std::vector<const Weight*> weights;
+                for(int k=0; k<meshvertex.weight_count; ++k) {
+                    const Weight& weight(mesh.weight(meshvertex.weight_start + k));
+                    const Quaternion orientation(bind.orientation(weight.joint));
+
+                    bind_position += (((orientation * weight.position) + bind.position(weight.joint)) * weight.weight);
+                    bind_normal += (orientation * weight.normal);
+                    bind_tangent += (orientation * weight.tangent);
+                    weights.push_back(&weight);
+                }
+
+                // equal weights keep their order like they do building the influences
+                std::stable_sort(weights.begin(), weights.end(), stronger);
+                weights.resize(std::min(weights.size(), static_cast<size_t>(Skinning::MAX_INFLUENCES)));
+
+                float total = 0.0f;
+                for(size_t k=0; k<weights.size(); ++k) {
+                    total += weights[k]->weight;
+                }
+
+                Position position;
+                Vector3 normal, tangent;
+                for(size_t k=0; k<weights.size(); ++k) {
+                    const int joint = weights[k]->joint;
+                    const float weight = weights[k]->weight / total;
+                    const Quaternion orientation(skeleton.orientation(joint)), inverse(bind.orientation(joint).inverse());
+
+                    position += (((orientation * (inverse * (bind_position - bind.position(joint)))) + skeleton.position(joint)) * weight);
+                    normal += ((orientation * (inverse * bind_normal)) * weight);
+                    tangent += ((orientation * (inverse * bind_tangent)) * weight);
+                }
+
+                Vertex& vertex(vertices[vstart + j]);
+                vertex.position = position;
+                vertex.normal = normal.normalized();
+                vertex.tangent = tangent.normalized();
+            }
+            vstart += mesh.vertex_count();
+        }
+    }
+
+    void report(const std::string& name, const std::string& what, const Error& error)
+    {
+        std::cout << "  " << name << " " << what
+            << ": position " << error.max_position << " max " << error.mean_position() << " mean,"
+            << " normal " << error.max_normal << " max " << error.mean_normal() << " mean" << std::endl;
+    }
+
+    void check_animation(const MD5Model& model, const MD5Animation& animation, const std::string& name)
+    {
+        const std::vector<Skinning::Kernel> check(kernels());
+        const float radius = model.bounds().radius();
+
+        boost::shared_array<Vertex> reference(new Vertex[model.vertex_count()]), palette(new Vertex[model.vertex_count()]),
+            actual(new Vertex[model.vertex_count()]);
+        RenderableBuffers buffers(model.triangle_count() * 3);
+
+        // the palette against the reference is only reported
+        std::vector<Error> errors(check.size());
+        Error approximation;
+        for(size_t i=0; i<animation.frame_count(); ++i) {
+            // between frames so the joints aren't just the stored ones
+            Skeleton skeleton;
+            animation.interpolate_skeleton(i, (i + 1) % animation.frame_count(), skeleton, 0.37);
+            model.calculate_vertices(skeleton, reference, buffers, Skinning::ScalarKernel);
+            palette_reference(model, skeleton, palette);
+
+            for(size_t k=0; k<check.size(); ++k) {
+                const bool is_palette = Skinning::PaletteKernel == check[k];
+                const boost::shared_array<Vertex>& expected(is_palette ? palette : reference);
+
+                model.calculate_vertices(skeleton, actual, buffers, check[k]);
+                for(size_t j=0; j<model.vertex_count(); ++j) {
+                    const Vertex &a(expected[j]), &b(actual[j]);
+                    errors[k].add(a.position.distance(b.position) / radius,
+                        std::max(angle(a.normal, b.normal), angle(a.tangent, b.tangent)));
+
+                    if(is_palette) {
+                        const Vertex& r(reference[j]);
+                        approximation.add(r.position.distance(b.position) / radius,
+                            std::max(angle(r.normal, b.normal), angle(r.tangent, b.tangent)));
+                    }
+                }
+            }
+        }
+
+        for(size_t k=0; k<check.size(); ++k) {
+            const bool is_palette = Skinning::PaletteKernel == check[k];
+            report(name, Skinning::kernel_name(check[k]), errors[k]);
+            if(is_palette) {
+                report(name, std::string(Skinning::kernel_name(check[k])) + " vs the reference", approximation);
+            }
+
+            if(!errors[k].within(TOLERANCE)) {
+                fail(name + ": " + Skinning::kernel_name(check[k]) + " is outside the tolerance");
+            }
+        }
+    }
+
+    void check_model(const boost::filesystem::path& directory)
+    {
+        const boost::filesystem::path path(directory.string().substr(model_dir().string().length() + 1));
+
+        MD5Model model(directory.filename().string());
+        if(!model.load(path)) {
+            fail("Could not load " + path.string());
+            return;
+        }
+
+        for(boost::filesystem::directory_iterator it(directory); it != boost::filesystem::directory_iterator(); ++it) {
+            const boost::filesystem::path& filename(it->path());
+            if(MD5Animation::extension() != filename.extension()) {
+                continue;
+            }
+
+            MD5Animation animation(filename.stem().string());
+            if(!animation.load(path)) {
+                fail("Could not load " + filename.string());
+                continue;
+            }
+            check_animation(model, animation, model.name() + "/" + animation.name());
+        }
+    }
+
+    // a skeleton too big for the palette's byte joint indices
+    void check_fallback()
+    {
+        const int JOINTS = 300;
+
+        Skeleton skeleton;
+        for(int i=0; i<JOINTS; ++i) {
+            Skeleton::Joint joint;
+            joint.parent = -1;
+            joint.position = Position(static_cast<float>(i), 0.0f, 0.0f);
+            skeleton.add_joint(joint);
+        }
+
+        boost::shared_array<Vertex> vertices(new Vertex[3]);
+        boost::shared_array<Weight> weights(new Weight[3]);
+        for(int i=0; i<3; ++i) {
+            vertices[i].index = i;
+            vertices[i].weight_start = i;
+            vertices[i].weight_count = 1;
+
+            weights[i].index = i;
+            weights[i].joint = JOINTS - 1 - i;
+            weights[i].weight = 1.0f;
+            weights[i].position = Position(0.0f, static_cast<float>(i % 2), static_cast<float>(i / 2));
+        }
+
+        boost::shared_array<Triangle> triangles(new Triangle[1]);
+        triangles[0].index = 0;
+        triangles[0].v1 = 0; triangles[0].v2 = 1; triangles[0].v3 = 2;
+
+        Mesh mesh(3, vertices, 1, triangles, 3, weights);
+        mesh.pose(skeleton);
+        mesh.compute_normals(skeleton);
+        mesh.prepare_skinning(skeleton);
+
+        if(mesh.skinning().supports(Skinning::PaletteKernel)) {
+            fail("The palette kernel claims to support 300 joints");
+        }
+
+        boost::shared_array<Vertex> expected(new Vertex[3]), actual(new Vertex[3]);
+        RenderableBuffers buffers(3);
+        mesh.calculate_vertices(skeleton, expected, 0, buffers, 0, Skinning::ScalarKernel);
+        mesh.calculate_vertices(skeleton, actual, 0, buffers, 0, Skinning::PaletteKernel);
+        for(int i=0; i<3; ++i) {
+            if(expected[i].position.distance(actual[i].position) > 0.0f) {
+                fail("The palette kernel didn't fall back to the reference for 300 joints");
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Logger::configure(Logger::LoggerTypeNone, Logger::LogLevelError, "");
+
+    const boost::filesystem::path monsters(model_dir() / "monsters");
+    for(boost::filesystem::directory_iterator it(monsters); it != boost::filesystem::directory_iterator(); ++it) {
+        if(boost::filesystem::is_directory(it->path())) {
+            check_model(it->path());
+        }
+    }
+    check_fallback();
+
+    if(failures > 0) {
+        std::cerr << failures << " failures" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All kernels are within tolerance" << std::endl;
+    return 0;
+}